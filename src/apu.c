@@ -5,22 +5,15 @@
 #include <string.h>
 #include <math.h>
 
-#include <SDL3/SDL.h>
-#include <soxr.h>
-
 #include "arena.h"
 #include "apu.h"
+#include "blip.h"
+#include "once.h"
 #include "ppu.h"
 #include "system.h"
-#include "nones.h"
 
 #include "utils.h"
 
-static soxr_t soxr;
-static soxr_error_t error;
-
-//#define APU_FAST_MIXER
-
 static const SequenceStep sequence_table[2][6] =
 {
     // Mode 0: 4-Step Sequence
@@ -105,6 +98,55 @@ bool PollApuIrqs(Apu *apu)
     return apu->status.dmc_irq | (apu->status.frame_irq & ~apu->frame_ctr.ctrl.irq_inhibit);
 }
 
+static bool ApuDmcNeedsDma(Apu *apu)
+{
+    return apu->dmc.empty && apu->dmc.bytes_remaining && apu->status.dmc;
+}
+
+// The dmc asks for a fetch at the start of the next cycle once its buffer is empty,
+// this has to be called whenever anything it depends on changes
+static void ApuScheduleDmcDma(Apu *apu)
+{
+    if (ApuDmcNeedsDma(apu))
+        SystemScheduleEvent(apu->system, SYSTEM_EVENT_DMC_DMA, apu->system->cycles);
+}
+
+void ApuPollDmcDma(Apu *apu)
+{
+    if (ApuDmcNeedsDma(apu))
+    {
+        SystemSignalDmcDma(apu->system);
+    }
+}
+
+// Value of the sequencer timer on the given cycle, it counts 1 -> reload and starts over
+static int ApuFrameCounterTimer(Apu *apu, const uint64_t cycle)
+{
+    if (cycle == apu->frame_ctr.origin)
+        return 0;
+
+    return (cycle - apu->frame_ctr.origin - 1) % apu->frame_ctr.reload + 1;
+}
+
+// Schedule the current step for the first cycle starting at from that the timer reaches it
+static void ApuScheduleFrameCounter(Apu *apu, const uint64_t from)
+{
+    const int step_cycles = sequence_table[apu->frame_ctr.ctrl.seq_mode][apu->frame_ctr.step].cycles;
+
+    // Can happen for a few cycles after switching to the 5 step sequence, until the reset kicks in
+    if (step_cycles > apu->frame_ctr.reload)
+    {
+        SystemCancelEvent(apu->system, SYSTEM_EVENT_FRAME_COUNTER);
+        return;
+    }
+
+    int delta = step_cycles - ApuFrameCounterTimer(apu, from);
+    if (delta < 0)
+        delta += apu->frame_ctr.reload;
+
+    SystemScheduleEvent(apu->system, SYSTEM_EVENT_FRAME_COUNTER, from + delta);
+}
+
 #define FCPU 1789773.0
 
 static void ApuWritePulse1Duty(Apu *apu, const uint8_t data)
@@ -162,6 +204,7 @@ static void ApuResetSample(Apu *apu)
     apu->dmc.bytes_remaining = apu->dmc.sample_length;
     apu->dmc.addr_counter = apu->dmc.sample_addr;
     apu->dmc.restart = false;
+    ApuScheduleDmcDma(apu);
 }
 
 // Writing a zero to any of the channel enable bits (NT21) will silence that channel and halt its length counter.
@@ -189,6 +232,7 @@ static void ApuWriteStatus(Apu *apu, const uint8_t data)
     }
 
     apu->status.dmc_irq = 0;
+    ApuScheduleDmcDma(apu);
 }
 
 static void ApuClockLengthCounters(Apu *apu)
@@ -418,17 +462,19 @@ static void ApuClockDmc(Apu *apu)
                 apu->dmc.empty = true;
                 apu->dmc.silence = false;
                 apu->dmc.shift_reg = apu->dmc.sample_buffer;
+                ApuScheduleDmcDma(apu);
             }
         }
     }
 }
 
-static void ApuResetFrameCounter(Apu *apu)
+// origin is the cycle the timer reads 0 on
+static void ApuResetFrameCounter(Apu *apu, const uint64_t origin)
 {
     apu->frame_ctr.reload = 29830;
     apu->frame_ctr.reset_delay = 2;
     apu->frame_ctr.step = 0;
-    apu->frame_ctr.timer = 0;
+    apu->frame_ctr.origin = origin;
     apu->frame_ctr.reset = false;
 
     if (apu->frame_ctr.ctrl.seq_mode)
@@ -440,6 +486,8 @@ static void ApuResetFrameCounter(Apu *apu)
         ApuClockLengthCounters(apu);
         ApuClockSweeps(apu);
     }
+
+    ApuScheduleFrameCounter(apu, origin + 1);
 }
 
 // If the write occurs during an APU cycle, the effects occur 3 CPU cycles after the $4017 write cycle.;
@@ -450,6 +498,8 @@ static void ApuWriteFrameCounter(Apu *apu, const uint8_t data)
     apu->frame_ctr.ctrl.raw = data;
     apu->frame_ctr.reset = true;
     apu->status.frame_irq &= ~apu->frame_ctr.ctrl.irq_inhibit;
+    // The sequence mode switches right away, only the timer reset is delayed
+    ApuScheduleFrameCounter(apu, apu->system->cycles);
 }
 
 static void ApuWritePulse1Sweep(Apu *apu, const uint8_t data)
@@ -485,7 +535,7 @@ static void ApuDmcWriteSampleAddr(Apu *apu, const uint8_t data)
 // DMC DMA
 void ApuDmcDmaUpdate(Apu *apu)
 {
-    apu->dmc.sample_buffer = BusRead(apu->dmc.addr_counter);
+    apu->dmc.sample_buffer = BusRead(apu->system, apu->dmc.addr_counter);
     apu->dmc.empty = false;
     apu->dmc.addr_counter = MAX(0x8000, (apu->dmc.addr_counter + 1) & 0xFFFF);
 
@@ -672,20 +722,82 @@ static float ApplyFilter(float sample, float prev_sample, float alpha)
     return alpha * sample + (1.0 - alpha) * prev_sample;
 }
 
+static float ApuMixPulse(const int pulse_level)
+{
+    return 95.88 / ((8128.0 / pulse_level) + 100);
+}
+
+static float ApuMixTnd(const int triangle, const int noise, const int dmc)
+{
+    float tnd = 1 / ((triangle / 8227.0) + (noise / 12241.0) + (dmc / 22638.0));
+    return 159.79 / (tnd + 100);
+}
+
+static int ApuTndIndex(const int triangle, const int noise, const int dmc)
+{
+    return (triangle << 11) | (noise << 7) | dmc;
+}
+
+// Shared by every instance, they're only written once by whichever init gets there first
+static float pulse_table[APU_PULSE_TABLE_LEN];
+static float tnd_table[APU_TND_TABLE_LEN];
+static Once mix_tables_once;
+
+// Every combination of levels goes through the same functions the formula mixer calls, so
+// looking them up gives the same floats. The tnd dac isn't a function of 3t + 2n + d like the
+// usual 203 entry table has it (that one is off by up to 0.013), so it's indexed by all three
+// levels. That's 128 KiB, but the levels only move a step at a time so the few lines in use
+// stay cached and it's no slower than the small table
+static void ApuBuildMixTables(void)
+{
+    for (int i = 0; i < APU_PULSE_TABLE_LEN; i++)
+    {
+        pulse_table[i] = ApuMixPulse(i);
+    }
+
+    for (int triangle = 0; triangle < 16; triangle++)
+    {
+        for (int noise = 0; noise < 16; noise++)
+        {
+            for (int dmc = 0; dmc < 128; dmc++)
+            {
+                tnd_table[ApuTndIndex(triangle, noise, dmc)] = ApuMixTnd(triangle, noise, dmc);
+            }
+        }
+    }
+}
+
+static float ApuMixChannels(Apu *apu)
+{
+    const int pulse_level = apu->pulse1.output + apu->pulse2.output;
+    float pulse;
+    float tnd_out;
+
+    switch (apu->mixer.mix)
+    {
+        case APU_MIX_TABLE:
+            pulse = pulse_table[pulse_level];
+            tnd_out = tnd_table[ApuTndIndex(apu->triangle.output, apu->noise.output, apu->dmc.output_level)];
+            break;
+        case APU_MIX_FORMULA:
+            pulse = ApuMixPulse(pulse_level);
+            tnd_out = ApuMixTnd(apu->triangle.output, apu->noise.output, apu->dmc.output_level);
+            break;
+        default:
+            pulse = 0.00752f * pulse_level;
+            tnd_out = 0.00851f * apu->triangle.output + 0.00494f * apu->noise.output + 0.00335f * apu->dmc.output_level;
+            break;
+    }
+
+    return pulse + tnd_out;
+}
+
 static void ApuMixSample(Apu *apu)
 {
-#ifdef APU_FAST_MIXER
-    float pulse = 0.00752f * (apu->pulse1.output + apu->pulse2.output);
-    float tnd_out = 0.00851f * apu->triangle.output + 0.00494f * apu->noise.output + 0.00335f * apu->dmc.output_level;
-#else
-    float pulse = 95.88 / ((8128.0 / (apu->pulse1.output + apu->pulse2.output)) + 100);
-    float tnd = 1 / ((apu->triangle.output / 8227.0) + (apu->noise.output / 12241.0) + (apu->dmc.output_level / 22638.0));
-    float tnd_out = 159.79 / (tnd + 100);
-#endif
-    float raw_sample = pulse + tnd_out + MapperGetMixedAudio();
+    float raw_sample = ApuMixChannels(apu) + MapperGetMixedAudio(apu->system);
     // Apply a HPF to fix the the DC offset without affecting the FR too much
     apu->mixer.hpf_sample = ApplyFilter(raw_sample, apu->mixer.hpf_sample, apu->mixer.hpf_alpha);
-    // Apply a LPF just for the buffer used as the input for soxr, could also just make this lowpass cutoff at 14khz
+    // Apply a LPF just for the buffer used as the input for the resampler, could also just make this lowpass cutoff at 14khz
     apu->mixer.sample = ApplyFilter(raw_sample - apu->mixer.hpf_sample, apu->mixer.sample, apu->mixer.lpf_alpha);
 }
 
@@ -703,16 +815,85 @@ static void ApuGetClock(Apu *apu)
     {
         if (!(--apu->frame_ctr.reset_delay))
         {
-            ApuResetFrameCounter(apu);
+            // The timer reads 1 on the next cycle
+            ApuResetFrameCounter(apu, apu->system->cycles - 1);
+        }
+    }
+}
+
+static void ApuFlushInput(Apu *apu)
+{
+    if (apu->mixer.input_index == apu->mixer.input_len)
+    {
+        apu->mixer.input_index = 0;
+        if (apu->mixer.SampleFn)
+        {
+            apu->mixer.SampleFn(apu->mixer.userdata, apu->mixer.input_buffer, apu->mixer.input_len);
+        }
+    }
+}
+
+// Moves the finished samples of the chunk into the input buffer, they only get the hpf here,
+// the band limiting already took care of what the lpf is for
+static void ApuReadBlip(Apu *apu)
+{
+    int avail = BlipEndChunk(&apu->mixer.blip, APU_BLIP_CHUNK);
+
+    while (avail > 0)
+    {
+        const int count = MIN(avail, apu->mixer.input_len - apu->mixer.input_index);
+        float *out = &apu->mixer.input_buffer[apu->mixer.input_index];
+
+        BlipReadSamples(&apu->mixer.blip, out, count);
+        for (int i = 0; i < count; i++)
+        {
+            apu->mixer.hpf_sample = ApplyFilter(out[i], apu->mixer.hpf_sample, apu->mixer.hpf_alpha);
+            out[i] -= apu->mixer.hpf_sample;
         }
+
+        avail -= count;
+        apu->mixer.input_index += count;
+        ApuFlushInput(apu);
+    }
+}
+
+// Most apu cycles none of the channels change level, the mix is only worked out again
+// when one of them does and the difference is added as a step
+static void ApuSynthBlip(Apu *apu)
+{
+    const uint32_t levels = apu->pulse1.output | apu->pulse2.output << 4 | apu->triangle.output << 8 |
+                            apu->noise.output << 12 | apu->dmc.output_level << 16;
+    const float mapper_level = MapperGetMixedAudio(apu->system);
+
+    if (levels != apu->mixer.levels || mapper_level != apu->mixer.mapper_level)
+    {
+        const float amp = ApuMixChannels(apu) + mapper_level;
+        BlipAddDelta(&apu->mixer.blip, apu->mixer.blip_clock, amp - apu->mixer.amp);
+
+        apu->mixer.levels = levels;
+        apu->mixer.mapper_level = mapper_level;
+        apu->mixer.amp = amp;
+    }
+
+    if (++apu->mixer.blip_clock == APU_BLIP_CHUNK)
+    {
+        apu->mixer.blip_clock = 0;
+        ApuReadBlip(apu);
     }
 }
 
 static void ApuPutClock(Apu *apu)
 {
     ApuClockTimers(apu);
-    MapperClockAudioTimers();
+    MapperClockAudioTimers(apu->system);
     ApuClockDmc(apu);
+
+    if (apu->mixer.synth == APU_SYNTH_BLIP)
+    {
+        ApuSynthBlip(apu);
+        return;
+    }
+
     ApuMixSample(apu);
 
     if (++apu->mixer.accum >= apu->mixer.accum_delta)
@@ -720,58 +901,98 @@ static void ApuPutClock(Apu *apu)
         apu->mixer.accum -= apu->mixer.accum_delta;
 
         apu->mixer.input_buffer[apu->mixer.input_index++] = apu->mixer.sample;
-        if (apu->mixer.input_index == apu->mixer.input_len)
-        {
-            size_t odone;
-            error = soxr_process(
-                soxr,
-                apu->mixer.input_buffer, apu->mixer.input_len,
-                NULL,
-                apu->mixer.output_buffer, apu->mixer.output_len,
-                &odone
-            );
-            apu->mixer.input_index = 0;
-            NonesPutSoundData(apu->mixer.output_buffer, apu->mixer.output_size);
-        }
+        ApuFlushInput(apu);
     }
 }
 
-void APU_Tick(Apu *apu, bool put_cycle)
+// Runs on the cycle the timer reaches the current step, before the rest of the apu is ticked
+void ApuClockFrameCounter(Apu *apu)
 {
     SequenceStep step = sequence_table[apu->frame_ctr.ctrl.seq_mode][apu->frame_ctr.step];
 
-    if (apu->dmc.empty && apu->dmc.bytes_remaining && apu->status.dmc)
+    //printf("Sequencer: Framecounter called on cycle: %d\n", step.cycles);
+    if (step.event == SEQ_CLOCK_QUARTER_FRAME)
+    {
+        ApuClockEnvelopes(apu);
+        ApuClockLinearCounters(apu);
+    }
+    else if (step.event == SEQ_CLOCK_HALF_FRAME)
+    {
+        // Half-frame includes quarter frame stuff
+        ApuClockEnvelopes(apu);
+        ApuClockLinearCounters(apu);
+        ApuClockLengthCounters(apu);
+        ApuClockSweeps(apu);
+    }
+    if (step.frame_interrupt)
+    {
+        apu->status.frame_irq = step.cycles != 29830 ? true : !apu->frame_ctr.ctrl.irq_inhibit;
+        // Don't overwrite the newly set frame irq flag
+        apu->frame_ctr.clear_irq = false;
+    }
+    apu->frame_ctr.step = (apu->frame_ctr.step + 1) % 6;
+
+    ApuScheduleFrameCounter(apu, apu->system->cycles);
+}
+
+// The cycle mixer filters and decimates at the apu rate, blip synthesis works at the output rate
+static void ApuInitMixer(Apu *apu, Arena *arena, const ApuSynth synth)
+{
+    const int samples_per_frame = apu->mixer.sample_rate / 60;
+    apu->mixer.output_len = samples_per_frame;
+    apu->mixer.synth = synth;
+
+    if (synth == APU_SYNTH_CYCLE)
+    {
+        // Oversample the mixer output, the frontend resamples it down to output_len samples per frame
+        apu->mixer.input_len = samples_per_frame * APU_OVERSAMPLE_RATIO;
+        apu->mixer.input_rate = apu->mixer.input_len * APU_FREQ / APU_CYCLES_PER_FRAME;
+        apu->mixer.accum_delta = APU_CYCLES_PER_FRAME / apu->mixer.input_len;
+        // LPF freq cutoff based on sample rate
+        const float lpf_cutoff = apu->mixer.sample_rate * 0.45;
+        apu->mixer.lpf_alpha = ComputeFilterAlpha(APU_FREQ, lpf_cutoff);
+        apu->mixer.hpf_alpha = ComputeFilterAlpha(APU_FREQ, HPF_CUTOFF);
+    }
+    else
     {
-        SystemSignalDmcDma();
+        // Already at the output rate, there's nothing left to resample but clock drift
+        apu->mixer.input_len = samples_per_frame;
+        apu->mixer.input_rate = apu->mixer.sample_rate;
+        apu->mixer.hpf_alpha = ComputeFilterAlpha(apu->mixer.sample_rate, HPF_CUTOFF);
+        BlipInit(&apu->mixer.blip, APU_FREQ, apu->mixer.sample_rate);
     }
 
-    MapperClockAudio();
+    apu->mixer.input_size = apu->mixer.input_len * sizeof(float);
+    apu->mixer.input_buffer = ArenaPush(arena, apu->mixer.input_size);
+}
 
-    if (apu->frame_ctr.timer == step.cycles)
+// Can be switched at any point, between the table and the formula the output doesn't change
+void APU_SetMix(Apu *apu, const ApuMix mix)
+{
+    apu->mixer.mix = mix;
+}
+
+static const char *const mix_names[] = { "table", "formula", "linear" };
+
+// Looks a mix mode up by the name used on the command line, returns false if there's none
+bool APU_ParseMix(const char *name, ApuMix *mix)
+{
+    for (int i = 0; i < (int)ARRAY_SIZE(mix_names); i++)
     {
-        //printf("Sequencer: Framecounter called on cycle: %d cpu cycle: %ld\n", apu->frame_ctr.timer, apu->cycles);
-        if (step.event == SEQ_CLOCK_QUARTER_FRAME)
-        {
-            ApuClockEnvelopes(apu);
-            ApuClockLinearCounters(apu);
-        }
-        else if (step.event == SEQ_CLOCK_HALF_FRAME)
-        {
-            // Half-frame includes quarter frame stuff
-            ApuClockEnvelopes(apu);
-            ApuClockLinearCounters(apu);
-            ApuClockLengthCounters(apu);
-            ApuClockSweeps(apu);
-        }
-        if (step.frame_interrupt)
+        if (!strcmp(name, mix_names[i]))
         {
-            apu->status.frame_irq = apu->frame_ctr.timer != 29830 ? true : !apu->frame_ctr.ctrl.irq_inhibit;
-            // Don't overwrite the newly set frame irq flag
-            apu->frame_ctr.clear_irq = false;
+            *mix = (ApuMix)i;
+            return true;
         }
-        apu->frame_ctr.step = (apu->frame_ctr.step + 1) % 6;
     }
 
+    return false;
+}
+
+void APU_Tick(Apu *apu, bool put_cycle)
+{
+    MapperClockAudio(apu->system);
+
     ApuClockTriangle(apu);
 
     if (!put_cycle)
@@ -782,55 +1003,30 @@ void APU_Tick(Apu *apu, bool put_cycle)
     {
         ApuPutClock(apu);
     }
-
-    apu->frame_ctr.timer %= apu->frame_ctr.reload;
-    ++apu->frame_ctr.timer;
 }
 
-void APU_Init(Apu *apu, Arena *arena, const bool swap_duty_cycles, int sample_rate)
+void APU_Init(Apu *apu, struct System *system, Arena *arena, const bool swap_duty_cycles, int sample_rate,
+              const ApuSynth synth)
 {
     memset(apu, 0, sizeof(*apu));
-    ApuResetFrameCounter(apu);
+    apu->system = system;
+    ApuResetFrameCounter(apu, system->cycles);
 
     apu->mixer.sample_rate = sample_rate;
-    const int samples_per_frame = apu->mixer.sample_rate / 60;
-    // Set the sample ratio to be used by soxr, 
-    const int soxr_sample_ratio = 3;
-    // LPF freq cutoff based on sample rate
-    const float lpf_cutoff = apu->mixer.sample_rate * 0.45;
-    apu->mixer.input_len = samples_per_frame * soxr_sample_ratio;
-    apu->mixer.output_len = samples_per_frame;
-    apu->mixer.accum_delta = APU_CYCLES_PER_FRAME / apu->mixer.input_len;
-    apu->mixer.input_size = apu->mixer.input_len * sizeof(float);
-    apu->mixer.output_size = apu->mixer.output_len * sizeof(int16_t);
-    apu->mixer.input_buffer = ArenaPush(arena, apu->mixer.input_size);
-    apu->mixer.output_buffer = ArenaPush(arena, apu->mixer.output_size);
-    apu->mixer.lpf_alpha = ComputeFilterAlpha(APU_FREQ, lpf_cutoff);
-    apu->mixer.hpf_alpha = ComputeFilterAlpha(APU_FREQ, HPF_CUTOFF);
+    ApuInitMixer(apu, arena, synth);
+    OnceRun(&mix_tables_once, ApuBuildMixTables);
 
     apu->noise.shift_reg.raw = 1;
     apu->dmc.sample_length = 1;
     apu->dmc.empty = true;
     apu->alignment = 0;
     apu->swap_duty_cycles = swap_duty_cycles;
-
-    soxr_quality_spec_t q_spec = soxr_quality_spec(SOXR_HQ, SOXR_VR);
-    soxr_io_spec_t io_spec = soxr_io_spec(SOXR_FLOAT32_I, SOXR_INT16_I);
-
-    soxr = soxr_create(apu->mixer.input_len, apu->mixer.output_len,
-                    1, &error, &io_spec, &q_spec, NULL);
-}
-
-void APU_Shutdown(Apu *apu)
-{
-    UNUSED(apu);
-    soxr_delete(soxr);
 }
 
 void APU_Reset(Apu *apu)
 {
     ApuWriteStatus(apu, 0x0);
-    ApuResetFrameCounter(apu);
+    ApuResetFrameCounter(apu, apu->system->cycles);
     apu->noise.shift_reg.raw = 1;
     apu->dmc.sample_length = 1;
     apu->dmc.empty = true;
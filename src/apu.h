@@ -1,6 +1,8 @@
 #ifndef APU_H
 #define APU_H
 
+#include "blip.h"
+
 typedef struct
 {
     uint16_t counter;
@@ -95,7 +97,8 @@ typedef union
 // Once the last step has executed, the count resets to 0 on the next APU cycle. 
 typedef struct
 {
-    int timer;
+    // Cycle the timer was last reset on (timer 0), the timer itself is worked out from the master clock
+    uint64_t origin;
     int reload;
     int reset_delay;
     int16_t step;
@@ -176,12 +179,45 @@ typedef struct
     uint8_t length_counter_load : 5;
 } ApuPulse;
 
+// Receives every full block of mixed samples, input_len at a time. They come at input_rate
+// samples per second of emulated time and it's up to the caller to resample them to the output rate
+typedef void (*ApuSampleFn)(void *userdata, const float *samples, const int num_samples);
+
+typedef enum
+{
+    // Only changes in the mix are added, as band limited steps straight at the output rate
+    APU_SYNTH_BLIP,
+    // Mixed and filtered every apu cycle, then point sampled at 3x the output rate
+    APU_SYNTH_CYCLE
+} ApuSynth;
+
+// How the channel levels are combined, the first two give the exact same samples
+typedef enum
+{
+    // The nonlinear dac curves looked up from tables built on init
+    APU_MIX_TABLE,
+    // The same curves worked out every time
+    APU_MIX_FORMULA,
+    // Straight line fit of the curves, cheapest but off by up to a few percent at high levels
+    APU_MIX_LINEAR
+} ApuMix;
+
+// Pulse levels are summed before the dac, tnd levels go in separately (triangle, noise, dmc)
+#define APU_PULSE_TABLE_LEN 31
+#define APU_TND_TABLE_LEN (16 * 16 * 128)
+
 typedef struct
 {
+    struct System *system;
+
     struct
     {
+        ApuSampleFn SampleFn;
+        void *userdata;
         float *input_buffer;
-        int16_t *output_buffer;
+        ApuMix mix;
+        ApuSynth synth;
+        double input_rate;
         float sample;
         float sample_rate;
         float accum;
@@ -193,7 +229,12 @@ typedef struct
         int input_len;
         int output_len;
         int input_size;
-        int output_size;
+        // Band limited synthesis, the channel levels and the mix as of the last change
+        Blip blip;
+        uint32_t blip_clock;
+        uint32_t levels;
+        float mapper_level;
+        float amp;
     } mixer;
 
     ApuPulse pulse1;
@@ -269,6 +310,9 @@ typedef struct
 #define APU_FREQ 894886.5
 #define APU_CYCLES_PER_FRAME 14890.0f
 #define HPF_CUTOFF 37
+#define APU_OVERSAMPLE_RATIO 3
+// Apu cycles per blip chunk, at most 110 samples at 192kHz so it fits in BLIP_MAX_SAMPLES
+#define APU_BLIP_CHUNK 512
 
 enum ApuRegs
 {
@@ -299,9 +343,13 @@ uint8_t ApuReadStatus(Apu *apu, const uint8_t bus_data);
 void WriteAPURegister(Apu *apu, const uint16_t addr, const uint8_t data);
 bool PollApuIrqs(Apu *apu);
 void ApuDmcDmaUpdate(Apu *apu);
-void APU_Init(Apu *apu, Arena *arena, const bool swap_duty_cycles, int sample_rate);
+void ApuClockFrameCounter(Apu *apu);
+void ApuPollDmcDma(Apu *apu);
+void APU_Init(Apu *apu, struct System *system, Arena *arena, const bool swap_duty_cycles, int sample_rate,
+              const ApuSynth synth);
+void APU_SetMix(Apu *apu, const ApuMix mix);
+bool APU_ParseMix(const char *name, ApuMix *mix);
 void APU_Tick(Apu *apu, bool put_cycle);
 void APU_Reset(Apu *apu);
-void APU_Shutdown(Apu *apu);
 
 #endif
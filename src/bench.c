@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "system.h"
+#include "profile.h"
+#include "utils.h"
+
+#define VERSION "v0.4.0"
+
+// Buttons in the order SystemUpdateJPButtons expects them
+#define BENCH_NUM_BUTTONS 16
+
+// Set when the movie asks for a reset on that frame
+#define BENCH_INPUT_RESET (1 << BENCH_NUM_BUTTONS)
+
+typedef struct
+{
+    uint32_t *frames;
+    long num_frames;
+} BenchMovie;
+
+typedef struct
+{
+    double seconds;
+    uint64_t frames;
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t total_ticks;
+    Profile profile;
+} BenchResult;
+
+static void About(void)
+{
+    printf("nones-bench " VERSION " by Matt W\n");
+}
+
+static void Usage(void)
+{
+    About();
+    printf("Usage: nones-bench \"game.nes\" [options...]\n");
+}
+
+static void Help(void)
+{
+    Usage();
+    printf("Options:\n"
+           "  --help                             Display this information\n"
+           "  --version                          Display version information\n"
+           "  --frames=\"num-frames\"              Number of frames to run (default 3000)\n"
+           "  --movie=\"movie.fm2\"                Play back the input from a FCEUX movie\n"
+           "  --json=\"file.json\"                 Write the results as json\n"
+           "  --no-profile                       Skip the profiled run\n"
+           "  --apu-mix=\"mode\"                   How the channels are mixed: table (default), formula or linear\n"
+           "  --apu-cycle-mixer                  Mix the audio every apu cycle instead of the band limited synthesis\n"
+           "  --jit                              Run prg rom code through the experimental jit (x86-64 only)\n");
+}
+
+static double BenchNow(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// FM2 pads are written as "RLDUTSBA", a '.' or ' ' means the button is released
+static uint32_t BenchParsePad(const char *field, const size_t len, const int pad)
+{
+    // Index of each fm2 column in the SystemUpdateJPButtons order
+    static const int button_index[8] = { 5, 4, 3, 2, 6, 7, 1, 0 };
+    uint32_t buttons = 0;
+
+    for (size_t i = 0; i < len && i < ARRAY_SIZE(button_index); i++)
+    {
+        if (field[i] != '.' && field[i] != ' ')
+            buttons |= 1 << (button_index[i] + pad * 8);
+    }
+
+    return buttons;
+}
+
+// Only the input log of the fm2 is used, the header is skipped.
+// Each input line is "|commands|pad1|pad2|port2|", a command of 1 or 2 is a soft/hard reset
+static int BenchLoadMovie(Arena *arena, BenchMovie *movie, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        printf("Failed to open %s\n", path);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *text = ArenaPush(arena, size + 1);
+    if (fread(text, 1, size, fp) != (size_t)size)
+    {
+        printf("Failed to read %s\n", path);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    long max_frames = 1;
+    for (long i = 0; i < size; i++)
+    {
+        if (text[i] == '\n')
+            max_frames++;
+    }
+
+    movie->frames = ArenaPush(arena, max_frames * sizeof(uint32_t));
+    movie->num_frames = 0;
+
+    char *line = text;
+    while (line < text + size)
+    {
+        char *end = strchr(line, '\n');
+        if (end == NULL)
+            end = text + size;
+
+        if (line[0] == '|')
+        {
+            const char *commands = line + 1;
+            const char *pad1 = strchr(commands, '|');
+            const char *pad2 = pad1 && pad1 < end ? strchr(pad1 + 1, '|') : NULL;
+            const char *pad2_end = pad2 && pad2 < end ? strchr(pad2 + 1, '|') : NULL;
+
+            uint32_t input = 0;
+            if (strtol(commands, NULL, 10) & 3)
+                input |= BENCH_INPUT_RESET;
+
+            if (pad2 && pad2 < end)
+                input |= BenchParsePad(pad1 + 1, pad2 - (pad1 + 1), 0);
+
+            if (pad2_end && pad2_end < end)
+                input |= BenchParsePad(pad2 + 1, pad2_end - (pad2 + 1), 1);
+
+            movie->frames[movie->num_frames++] = input;
+        }
+
+        line = end + 1;
+    }
+
+    printf("Loaded %ld frames of input from %s\n", movie->num_frames, path);
+    return 0;
+}
+
+static void BenchApplyInput(System *system, const BenchMovie *movie, const long frame)
+{
+    if (movie == NULL || frame >= movie->num_frames)
+        return;
+
+    const uint32_t input = movie->frames[frame];
+    if (input & BENCH_INPUT_RESET)
+        SystemReset(system);
+
+    bool buttons[BENCH_NUM_BUTTONS];
+    for (int i = 0; i < BENCH_NUM_BUTTONS; i++)
+    {
+        buttons[i] = (input >> i) & 1;
+    }
+
+    SystemUpdateJPButtons(system, buttons);
+}
+
+static int BenchRun(const char *rom_path, const BenchMovie *movie, const long num_frames,
+                    const bool profile, const bool jit, const ApuSynth synth, const ApuMix mix,
+                    BenchResult *result)
+{
+    Arena *arena = ArenaCreate(1024 * 1024 * 3);
+    System *system = SystemCreate(arena);
+
+    if (SystemLoadCart(arena, system, rom_path))
+    {
+        ArenaDestroy(arena);
+        return -1;
+    }
+
+    uint16_t *buffers[2];
+    const uint32_t buffer_size = (SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint16_t));
+    buffers[0] = ArenaPush(arena, buffer_size);
+    buffers[1] = ArenaPush(arena, buffer_size);
+
+    // No audio callback, the mixed samples are just dropped
+    SystemInit(system, arena, false, false, 44100, synth, buffers, buffer_size);
+    SystemSetAudioMix(system, mix);
+
+    // The interpreter is timed instead if the jit can't be set up
+    if (jit && !SystemSetCpuJit(system, true))
+        printf("Running without the jit\n");
+
+    // Reset time doesn't count towards the run
+    const uint64_t start_instructions = system->cpu->instructions;
+    const int64_t start_cycles = system->cpu->cycles;
+    system->profile.enabled = profile;
+
+    const uint64_t start_ticks = ProfileNow();
+    const double start_time = BenchNow();
+
+    for (long frame = 0; frame < num_frames; frame++)
+    {
+        BenchApplyInput(system, movie, frame);
+        SystemRun(system, false);
+    }
+
+    result->seconds = BenchNow() - start_time;
+    result->total_ticks = ProfileNow() - start_ticks;
+    result->frames = num_frames;
+    result->instructions = system->cpu->instructions - start_instructions;
+    result->cycles = system->cpu->cycles - start_cycles;
+    result->profile = system->profile;
+
+    SystemShutdown(system);
+    ArenaDestroy(arena);
+    return 0;
+}
+
+static void BenchWriteJsonString(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fprintf(fp, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(fp, "\\u%04x", *str);
+        else
+            fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+// Zone ticks are converted to seconds using the wall time of the profiled run
+static double BenchZoneSeconds(const BenchResult *result, const uint64_t ticks)
+{
+    if (result->total_ticks == 0)
+        return 0;
+
+    return result->seconds * ((double)ticks / result->total_ticks);
+}
+
+static void BenchWriteJson(FILE *fp, const char *rom_path, const char *movie_path,
+                           const BenchResult *run, const BenchResult *profiled)
+{
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"version\": \"%s\",\n", VERSION);
+    fprintf(fp, "  \"rom\": ");
+    BenchWriteJsonString(fp, rom_path);
+    fprintf(fp, ",\n  \"movie\": ");
+    if (movie_path)
+        BenchWriteJsonString(fp, movie_path);
+    else
+        fprintf(fp, "null");
+    fprintf(fp, ",\n");
+    fprintf(fp, "  \"frames\": %lu,\n", (unsigned long)run->frames);
+    fprintf(fp, "  \"instructions\": %lu,\n", (unsigned long)run->instructions);
+    fprintf(fp, "  \"cpu_cycles\": %lu,\n", (unsigned long)run->cycles);
+    fprintf(fp, "  \"seconds\": %.6f,\n", run->seconds);
+    fprintf(fp, "  \"fps\": %.2f,\n", run->frames / run->seconds);
+    fprintf(fp, "  \"ips\": %.0f,\n", run->instructions / run->seconds);
+    fprintf(fp, "  \"profile\": ");
+
+    if (profiled == NULL)
+    {
+        fprintf(fp, "null\n}\n");
+        return;
+    }
+
+    const uint64_t *ticks = profiled->profile.ticks;
+    const uint64_t cpu_ticks = ticks[PROFILE_CPU] - ticks[PROFILE_PPU] - ticks[PROFILE_APU];
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "    \"seconds\": %.6f,\n", profiled->seconds);
+    fprintf(fp, "    \"cpu_execute_instr\": %.6f,\n", BenchZoneSeconds(profiled, cpu_ticks));
+    fprintf(fp, "    \"ppu_tick\": %.6f,\n", BenchZoneSeconds(profiled, ticks[PROFILE_PPU]));
+    fprintf(fp, "    \"apu_tick\": %.6f\n", BenchZoneSeconds(profiled, ticks[PROFILE_APU]));
+    fprintf(fp, "  }\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("No file was provided\n");
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    long num_frames = 3000;
+    bool profile = true;
+    bool jit = false;
+    ApuSynth synth = APU_SYNTH_BLIP;
+    ApuMix mix = APU_MIX_TABLE;
+    const char *movie_path = NULL;
+    const char *json_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp((argv[i]), "--help"))
+        {
+            Help();
+            return EXIT_SUCCESS;
+        }
+
+        if (!strcmp((argv[i]), "--version"))
+        {
+            About();
+            return EXIT_SUCCESS;
+        }
+
+        if (i == 1)
+            continue;
+
+        if (!strcmp((argv[i]), "--no-profile"))
+            profile = false;
+
+        if (strstr((argv[i]), "--apu-mix="))
+        {
+            if (!APU_ParseMix(strchr(argv[i], '=') + 1, &mix))
+            {
+                printf("Invalid apu mix mode! (table, formula or linear)\n");
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!strcmp((argv[i]), "--apu-cycle-mixer"))
+            synth = APU_SYNTH_CYCLE;
+
+        if (!strcmp((argv[i]), "--jit"))
+            jit = true;
+
+        if (strstr((argv[i]), "--frames="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            num_frames = strtol(delim_pos + 1, &end, 10);
+            if (num_frames <= 0 || *end != '\0')
+            {
+                printf("Invalid frame count!\n");
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--movie="))
+            movie_path = strchr(argv[i], '=') + 1;
+
+        if (strstr((argv[i]), "--json="))
+            json_path = strchr(argv[i], '=') + 1;
+    }
+
+    Arena *arena = ArenaCreate(1024 * 1024 * 16);
+
+    BenchMovie movie;
+    if (movie_path != NULL && BenchLoadMovie(arena, &movie, movie_path))
+    {
+        ArenaDestroy(arena);
+        return EXIT_FAILURE;
+    }
+
+    const BenchMovie *input = movie_path ? &movie : NULL;
+
+    // The timed run never takes any timestamps inside the core, the breakdown
+    // comes from a second run since profiling slows everything down
+    BenchResult run = { 0 };
+    BenchResult profiled = { 0 };
+
+    if (BenchRun(argv[1], input, num_frames, false, jit, synth, mix, &run) ||
+        (profile && BenchRun(argv[1], input, num_frames, true, jit, synth, mix, &profiled)))
+    {
+        ArenaDestroy(arena);
+        return EXIT_FAILURE;
+    }
+
+    printf("Frames: %lu in %.3fs\n", (unsigned long)run.frames, run.seconds);
+    printf("FPS: %.2f\n", run.frames / run.seconds);
+    printf("Instructions/s: %.0f\n", run.instructions / run.seconds);
+
+    if (profile)
+    {
+        const uint64_t *ticks = profiled.profile.ticks;
+        const uint64_t cpu_ticks = ticks[PROFILE_CPU] - ticks[PROFILE_PPU] - ticks[PROFILE_APU];
+        printf("Profiled run: %.3fs\n", profiled.seconds);
+        printf("  CPU_ExecuteInstr: %.3fs\n", BenchZoneSeconds(&profiled, cpu_ticks));
+        printf("  PPU_Tick: %.3fs\n", BenchZoneSeconds(&profiled, ticks[PROFILE_PPU]));
+        printf("  APU_Tick: %.3fs\n", BenchZoneSeconds(&profiled, ticks[PROFILE_APU]));
+    }
+
+    int ret = EXIT_SUCCESS;
+    if (json_path != NULL)
+    {
+        FILE *fp = fopen(json_path, "w");
+        if (fp == NULL)
+        {
+            printf("Failed to open %s\n", json_path);
+            ret = EXIT_FAILURE;
+        }
+        else
+        {
+            BenchWriteJson(fp, argv[1], movie_path, &run, profile ? &profiled : NULL);
+            fclose(fp);
+        }
+    }
+
+    ArenaDestroy(arena);
+    return ret;
+}
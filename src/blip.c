@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "blip.h"
+#include "once.h"
+#include "utils.h"
+
+// Cutoff as a fraction of the output rate, the Blackman window rolls off over about
+// 5.5 / BLIP_WIDTH of it so the stopband starts just past nyquist
+#define BLIP_CUTOFF 0.42
+
+// One set of taps per phase, each the impulse of a step that far past the sample before it.
+// The kernel only depends on the output rate as a fraction so every Blip shares this one
+static float kernel[BLIP_PHASES * BLIP_WIDTH];
+static Once kernel_once;
+
+static void BlipBuildKernel(void)
+{
+    for (int phase = 0; phase < BLIP_PHASES; phase++)
+    {
+        float *taps = &kernel[phase * BLIP_WIDTH];
+        double sum = 0;
+
+        for (int i = 0; i < BLIP_WIDTH; i++)
+        {
+            // Distance from the step in samples, it's centered between the middle two taps
+            const double x = i - (BLIP_WIDTH / 2 - 1) - (double)phase / BLIP_PHASES;
+            const double t = 2.0 * BLIP_CUTOFF * x;
+            const double sinc = fabs(t) < 1e-9 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            const double window = 0.42 + 0.5 * cos(2.0 * M_PI * x / BLIP_WIDTH) + 0.08 * cos(4.0 * M_PI * x / BLIP_WIDTH);
+
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // A step has to add up to exactly its delta or the amplitude drifts, whatever
+        // rounding is left goes on the middle tap
+        float total = 0;
+        for (int i = 0; i < BLIP_WIDTH; i++)
+        {
+            taps[i] /= sum;
+            total += taps[i];
+        }
+        taps[BLIP_WIDTH / 2] += 1.0f - total;
+    }
+}
+
+void BlipInit(Blip *blip, const double clock_rate, const double sample_rate)
+{
+    OnceRun(&kernel_once, BlipBuildKernel);
+
+    memset(blip, 0, sizeof(*blip));
+    blip->factor = (uint64_t)(sample_rate / clock_rate * (double)(1ull << BLIP_TIME_BITS) + 0.5);
+}
+
+// Adds a change in amplitude at clock, counted from the start of the current chunk
+void BlipAddDelta(Blip *blip, const uint32_t clock, const float delta)
+{
+    const uint64_t pos = blip->offset + clock * blip->factor;
+    const int index = (int)(pos >> BLIP_TIME_BITS);
+    const int phase = (int)(pos >> (BLIP_TIME_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1);
+
+    const float *taps = &kernel[phase * BLIP_WIDTH];
+    float *out = &blip->buffer[index];
+    for (int i = 0; i < BLIP_WIDTH; i++)
+    {
+        out[i] += delta * taps[i];
+    }
+}
+
+// Ends the chunk after this many clocks, returns how many samples can be read. Those are
+// the ones no delta from a later clock can reach anymore
+int BlipEndChunk(Blip *blip, const uint32_t clocks)
+{
+    blip->offset += clocks * blip->factor;
+    return (int)(blip->offset >> BLIP_TIME_BITS);
+}
+
+void BlipReadSamples(Blip *blip, float *out, const int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        blip->integrator += blip->buffer[i];
+        out[i] = blip->integrator;
+    }
+
+    memmove(blip->buffer, &blip->buffer[count], (BLIP_BUFFER_LEN - count) * sizeof(float));
+    memset(&blip->buffer[BLIP_BUFFER_LEN - count], 0, count * sizeof(float));
+    blip->offset -= (uint64_t)count << BLIP_TIME_BITS;
+}
@@ -0,0 +1,38 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdint.h>
+
+// Step positions within a sample the kernel is worked out for
+#define BLIP_PHASE_BITS 6
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+// Samples a single step is spread over, half of it is added on as latency
+#define BLIP_WIDTH 32
+// Fraction bits of the clock to sample position conversion
+#define BLIP_TIME_BITS 32
+// Most samples a chunk can hold, a chunk of clocks has to resample to fewer than this
+#define BLIP_MAX_SAMPLES 128
+#define BLIP_BUFFER_LEN (BLIP_MAX_SAMPLES + BLIP_WIDTH)
+
+// Band limited synthesis, the output is built from steps instead of point samples of the
+// input. Every change in amplitude is added to the buffer as a windowed sinc impulse placed
+// at its exact clock, reading the samples out sums the impulses back into steps. The work
+// goes with how often the input changes and the output rate, not with the input clock rate.
+// Everything is stored inline so the whole thing can be saved with a state
+typedef struct
+{
+    // Output samples per input clock, BLIP_TIME_BITS fixed point
+    uint64_t factor;
+    // Where the current chunk starts, relative to the first sample in the buffer
+    uint64_t offset;
+    // Running sum of the buffer that's been read out, the current amplitude
+    float integrator;
+    float buffer[BLIP_BUFFER_LEN];
+} Blip;
+
+void BlipInit(Blip *blip, const double clock_rate, const double sample_rate);
+void BlipAddDelta(Blip *blip, const uint32_t clock, const float delta);
+int BlipEndChunk(Blip *blip, const uint32_t clocks);
+void BlipReadSamples(Blip *blip, float *out, const int count);
+
+#endif
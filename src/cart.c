@@ -92,10 +92,14 @@ int CartLoad(Arena *arena, Cart *cart, const char *path)
     uint32_t rom_size = ftell(fp);
     uint8_t *rom = malloc(rom_size);
 
-    char *base_name = strrchr(path, '/');
-    char *filename = base_name ? base_name : (char*)path;
+    const char *base_name = strrchr(path, '/');
+    const char *filename = base_name ? base_name : path;
 
-    cart->name = strtok(filename, ".");
+    // Copy the name up to the first '.' rather than strtok'ing the caller's path
+    const size_t name_len = strcspn(filename, ".");
+    char *name = ArenaPush(arena, name_len + 1);
+    memcpy(name, filename, name_len);
+    cart->name = name;
 
     cart->prg_rom.size = hdr.prg_rom_size_lsb * 0x4000;
     cart->prg_rom.mask = cart->prg_rom.size - 1;
@@ -156,7 +160,7 @@ int CartLoad(Arena *arena, Cart *cart, const char *path)
     fclose(fp);
     free(rom);
 
-    MapperInit(cart);
+    MapperInit(arena, cart);
     return 0;
 }
 
@@ -67,12 +67,16 @@ typedef struct Cart {
     int arrangement;
     const char *name;
     bool battery;
+    struct Mapper *mapper;
+    struct System *system;
     uint8_t (*PrgReadFn)(struct Cart *cart, const uint16_t addr);
+    // Only set by mappers whose prg rom banking can be mapped straight onto the bus
+    uint32_t (*PrgAddrFn)(struct Cart *cart, const uint16_t addr);
     uint8_t (*ChrReadFn)(struct Cart *cart, const uint16_t addr);
     void (*PrgWriteFn)(struct Cart *cart, const uint16_t addr, const uint8_t data);
     void (*ChrWriteFn)(struct Cart *cart, const uint16_t addr, const uint8_t data);
-    void (*RegWriteFn)(const uint16_t addr, const uint8_t data);
-    uint8_t (*RegReadFn)(const uint16_t addr);
+    void (*RegWriteFn)(struct Cart *cart, const uint16_t addr, const uint8_t data);
+    uint8_t (*RegReadFn)(struct Cart *cart, const uint16_t addr);
 } Cart;
 
 #define CART_RAM_SIZE 0x2000
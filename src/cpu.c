@@ -14,33 +14,41 @@
 #include "cart.h"
 #include "mapper.h"
 #include "system.h"
+#include "jit.h"
 #include "utils.h"
 
+// The instruction handlers and the helpers that take the addressing mode are forced inline
+// into the per opcode handlers generated from CPU_OPCODE_LIST, where the mode is a constant
+#ifdef __GNUC__
+#define CPU_INLINE static inline __attribute__((always_inline))
+#else
+#define CPU_INLINE static inline
+#endif
 
-static uint8_t CpuRead8(const uint16_t addr)
+static uint8_t CpuRead8(Cpu *cpu, const uint16_t addr)
 {
-    return SystemRead(addr);
+    return SystemRead(cpu->system, addr);
 }
 
-static void CpuWrite8(const uint16_t addr, const uint8_t data)
+static void CpuWrite8(Cpu *cpu, const uint16_t addr, const uint8_t data)
 {
-    SystemWrite(addr, data);
+    SystemWrite(cpu->system, addr, data);
 }
 
-static uint16_t CpuReadVector(uint16_t addr)
+static uint16_t CpuReadVector(Cpu *cpu, uint16_t addr)
 {
-    return (uint16_t)CpuRead8(addr + 1) << 8 | CpuRead8(addr);
+    return (uint16_t)CpuRead8(cpu, addr + 1) << 8 | CpuRead8(cpu, addr);
 }
 
 static void StackPush(Cpu *cpu, uint8_t data)
 {
-    CpuWrite8(STACK_START + cpu->sp--, data);
+    CpuWrite8(cpu, STACK_START + cpu->sp--, data);
 }
 
 // Retrieve the value on the top of the stack and then pop it
 static uint8_t StackPull(Cpu *cpu)
 {
-    return CpuRead8(STACK_START + (++cpu->sp));
+    return CpuRead8(cpu, STACK_START + (++cpu->sp));
 }
 
 static bool PageCross(uint16_t src_addr, uint16_t dst_addr)
@@ -50,15 +58,15 @@ static bool PageCross(uint16_t src_addr, uint16_t dst_addr)
 
 static void CpuPollIRQ(Cpu *cpu)
 {
-    cpu->irq_pending = !cpu->status.i && SystemPollAllIrqs();
+    cpu->irq_pending = !cpu->status.i && SystemPollAllIrqs(cpu->system);
 }
 
 static void CpuIrqHandler(Cpu *cpu)
 {
     // Dummy read of next instruction
-    CpuRead8(cpu->pc);
+    CpuRead8(cpu, cpu->pc);
     // Another dummy read
-    CpuRead8(cpu->pc);
+    CpuRead8(cpu, cpu->pc);
     //printf("IRQ at PC: 0x%X\n", cpu->pc);
     StackPush(cpu, (cpu->pc >> 8) & 0xFF);
     StackPush(cpu, cpu->pc & 0xFF);
@@ -66,7 +74,7 @@ static void CpuIrqHandler(Cpu *cpu)
     //const bool nmi_hijack = cpu->nmi_pending;
 
     // Push Processor Status (clear Break flag)
-    Flags status = cpu->status;
+    Flags status = {.raw = CPU_GetStatus(cpu)};
     status.b = 0;
     status.unused = 1;
     StackPush(cpu, status.raw);
@@ -74,14 +82,14 @@ static void CpuIrqHandler(Cpu *cpu)
     if (!cpu->nmi_pending)
     {
         // Load IRQ vector ($FFFE-$FFFF) into PC
-        cpu->pc = CpuReadVector(IRQ_VECTOR);
+        cpu->pc = CpuReadVector(cpu, IRQ_VECTOR);
         cpu->irq_pending = false;
         CPU_LOG("Jumping to IRQ vector at 0x%X\n", cpu->pc);
     }
     else
     {
         // NMI vector hijacking
-        cpu->pc = CpuReadVector(NMI_VECTOR);
+        cpu->pc = CpuReadVector(cpu, NMI_VECTOR);
         cpu->nmi_pending = false;
         CPU_LOG("Jumping to NMI vector at 0x%X from hijacked IRQ\n", cpu->pc);
     }
@@ -90,18 +98,18 @@ static void CpuIrqHandler(Cpu *cpu)
 static void CpuNmiHandler(Cpu *cpu)
 {
     // Dummy read of next instruction byte
-    CpuRead8(cpu->pc);
-    CpuRead8(cpu->pc);
+    CpuRead8(cpu, cpu->pc);
+    CpuRead8(cpu, cpu->pc);
     //printf("Nmi at PC: 0x%X\n", cpu->pc);
     // Push high first
     StackPush(cpu, (cpu->pc >> 8) & 0xFF);
     // Push low next
     StackPush(cpu, cpu->pc & 0xFF);
     // Push status with bit 5 set
-    StackPush(cpu, cpu->status.raw | 0x20);
+    StackPush(cpu, CPU_GetStatus(cpu) | 0x20);
 
     //uint16_t prev_pc = cpu->pc;
-    cpu->pc = CpuReadVector(NMI_VECTOR);
+    cpu->pc = CpuReadVector(cpu, NMI_VECTOR);
     cpu->status.i = 1;
     cpu->nmi_pending = false;
     //printf("NMI Jumped from: 0x%X --> 0x%X\n", prev_pc, cpu->pc);
@@ -122,16 +130,16 @@ static void CpuHandleInterrupts(Cpu *cpu)
 // PC += 2 
 static uint16_t GetAbsoluteAddr(Cpu *cpu)
 {
-    uint8_t addr_low = CpuRead8(++cpu->pc);
-    uint8_t addr_high = CpuRead8(++cpu->pc);
+    uint8_t addr_low = CpuRead8(cpu, ++cpu->pc);
+    uint8_t addr_high = CpuRead8(cpu, ++cpu->pc);
     return (uint16_t)addr_high << 8 | addr_low;
 }
 
 // PC += 2 
-static uint16_t GetAbsoluteXAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
+CPU_INLINE uint16_t GetAbsoluteXAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
 {
-    uint8_t addr_low = CpuRead8(++cpu->pc);
-    uint8_t addr_high = CpuRead8(++cpu->pc);
+    uint8_t addr_low = CpuRead8(cpu, ++cpu->pc);
+    uint8_t addr_high = CpuRead8(cpu, ++cpu->pc);
     uint16_t addr_low_final = addr_low + cpu->x;
     bool page_cross = addr_low_final > 255;
     uint16_t final_addr = (uint16_t)addr_high << 8 | (uint8_t)(addr_low_final);
@@ -139,7 +147,7 @@ static uint16_t GetAbsoluteXAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
     if (dummy_read & (page_cross || !add_cycle))
     {
         //printf("Dummy Read at 0x%X\n", final_addr);
-        CpuRead8(final_addr);
+        CpuRead8(cpu, final_addr);
     }
 
     final_addr += page_cross * PAGE_SIZE;
@@ -147,16 +155,16 @@ static uint16_t GetAbsoluteXAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
     return final_addr;
 }
 
-static uint16_t GetAbsoluteYAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
+CPU_INLINE uint16_t GetAbsoluteYAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
 {
-    uint8_t addr_low = CpuRead8(++cpu->pc);
-    uint8_t addr_high = CpuRead8(++cpu->pc);
+    uint8_t addr_low = CpuRead8(cpu, ++cpu->pc);
+    uint8_t addr_high = CpuRead8(cpu, ++cpu->pc);
     uint16_t addr_low_final = addr_low + cpu->y;
     bool page_cross = addr_low_final > 255;
     uint16_t final_addr = (uint16_t)addr_high << 8 | (uint8_t)(addr_low_final);
 
     if (dummy_read & (page_cross || !add_cycle))
-        CpuRead8(final_addr);
+        CpuRead8(cpu, final_addr);
 
     final_addr += page_cross * PAGE_SIZE;
 
@@ -166,14 +174,14 @@ static uint16_t GetAbsoluteYAddr(Cpu *cpu, bool add_cycle, bool dummy_read)
 // PC += 1
 static uint8_t GetZPAddr(Cpu *cpu)
 {
-    return CpuRead8(++cpu->pc);
+    return CpuRead8(cpu, ++cpu->pc);
 }
 
 // PC += 1
 static uint16_t GetZPIndexedAddr(Cpu *cpu, uint8_t reg)
 {
-    uint8_t zp_addr = CpuRead8(++cpu->pc);
-    CpuRead8(zp_addr);
+    uint8_t zp_addr = CpuRead8(cpu, ++cpu->pc);
+    CpuRead8(cpu, zp_addr);
 
     return (zp_addr + reg) & PAGE_MASK;
 }
@@ -181,61 +189,61 @@ static uint16_t GetZPIndexedAddr(Cpu *cpu, uint8_t reg)
 // PC += 2
 static uint16_t GetIndirectAddr(Cpu *cpu)
 {
-    uint8_t ptr_low = CpuRead8(++cpu->pc);
-    uint8_t ptr_high = CpuRead8(++cpu->pc);
+    uint8_t ptr_low = CpuRead8(cpu, ++cpu->pc);
+    uint8_t ptr_high = CpuRead8(cpu, ++cpu->pc);
     uint16_t ptr = (uint16_t)ptr_high << 8 | ptr_low;
 
-    uint8_t pc_low = CpuRead8(ptr);
+    uint8_t pc_low = CpuRead8(cpu, ptr);
     CpuPollIRQ(cpu);
     uint8_t pc_high;
     // 6502 Page Boundary Bug** (If ptr is at 0xXXFF, high byte comes from 0xXX00, not 0xXXFF+1)
     if ((ptr & 0xFF) == 0xFF)
     {
-        pc_high = CpuRead8(ptr & 0xFF00);
+        pc_high = CpuRead8(cpu, ptr & 0xFF00);
     }
     else
     {
-        pc_high = CpuRead8(ptr + 1);
+        pc_high = CpuRead8(cpu, ptr + 1);
     }
 
     return (uint16_t)pc_high << 8 | pc_low;
 }
 
 // PC += 1
-static uint16_t GetIndirectYAddr(Cpu *cpu, bool page_cycle, bool dummy_read)
+CPU_INLINE uint16_t GetIndirectYAddr(Cpu *cpu, bool page_cycle, bool dummy_read)
 {
     uint8_t zp_addr = GetZPAddr(cpu);
-    uint8_t addr_low = CpuRead8(zp_addr);
+    uint8_t addr_low = CpuRead8(cpu, zp_addr);
     // Fetch high (with zero-page wraparound)
-    uint8_t addr_high = CpuRead8((zp_addr + 1) & PAGE_MASK);
+    uint8_t addr_high = CpuRead8(cpu, (zp_addr + 1) & PAGE_MASK);
 
     uint16_t addr_low_final = addr_low + cpu->y;
     bool page_cross = addr_low_final > 255;
     uint16_t final_addr = (uint16_t)addr_high << 8 | (uint8_t)(addr_low_final);
 
     if (dummy_read & (page_cross || !page_cycle))
-        CpuRead8(final_addr);
+        CpuRead8(cpu, final_addr);
 
     final_addr += page_cross * PAGE_SIZE;
     return final_addr;
 }
 
-static void ShaInstrHandler(Cpu *cpu, AddressingMode addr_mode, const uint8_t reg_value)
+CPU_INLINE void ShaInstrHandler(Cpu *cpu, AddressingMode addr_mode, const uint8_t reg_value)
 {
     uint8_t addr_low = 0;
     uint8_t addr_high = 0;
 
     if (addr_mode == AbsoluteX || addr_mode == AbsoluteY)
     {
-        addr_low = CpuRead8(++cpu->pc);
-        addr_high = CpuRead8(++cpu->pc);
+        addr_low = CpuRead8(cpu, ++cpu->pc);
+        addr_high = CpuRead8(cpu, ++cpu->pc);
     }
     else
     {
         const uint8_t zp_addr = GetZPAddr(cpu);
-        addr_low = CpuRead8(zp_addr);
+        addr_low = CpuRead8(cpu, zp_addr);
         // Fetch high (with zero-page wraparound)
-        addr_high = CpuRead8((zp_addr + 1) & PAGE_MASK);
+        addr_high = CpuRead8(cpu, (zp_addr + 1) & PAGE_MASK);
     }
 
     const uint8_t data = reg_value & (addr_high + 1);
@@ -247,21 +255,21 @@ static void ShaInstrHandler(Cpu *cpu, AddressingMode addr_mode, const uint8_t re
 
     uint16_t final_addr = (uint16_t)addr_high << 8 | (uint8_t)(addr_low_final);
 
-    CpuRead8(final_addr);
+    CpuRead8(cpu, final_addr);
     CpuPollIRQ(cpu);
-    CpuWrite8(final_addr, data);
+    CpuWrite8(cpu, final_addr, data);
 }
 
 // PC += 1
 static uint16_t GetIndirectXAddr(Cpu *cpu, uint8_t reg)
 {
     uint8_t zp_addr = GetZPAddr(cpu);
-    CpuRead8(zp_addr);
+    CpuRead8(cpu, zp_addr);
     // Wrap in zero-page
     uint8_t effective_ptr = (zp_addr + reg) & PAGE_MASK;
-    uint8_t addr_low = CpuRead8(effective_ptr);
+    uint8_t addr_low = CpuRead8(cpu, effective_ptr);
     // Wrap in zero-page
-    uint8_t addr_high = CpuRead8((effective_ptr + 1) & PAGE_MASK);
+    uint8_t addr_high = CpuRead8(cpu, (effective_ptr + 1) & PAGE_MASK);
     return (uint16_t)addr_high << 8 | addr_low;
 }
 
@@ -269,19 +277,17 @@ static void CompareRegAndSetFlags(Cpu *cpu, uint8_t reg, uint8_t operand)
 {
     //printf("CMP 0x%X\n", operand);
     uint8_t result = reg - operand;
-    // Negative flag (bit 7)
-    cpu->status.n = GET_NEG_BIT(result);
-    // Zero flag (is result zero?)
-    cpu->status.z = !result;
+    // Negative and zero flags
+    UPDATE_FLAGS_NZ(result);
     // Update the Carry Flag (C)
-    cpu->status.c = (reg >= operand);
+    SET_FLAG_C(cpu, reg >= operand);
 }
 
 static void RotateOneLeft(Cpu *cpu, uint8_t *operand)
 {
-    uint8_t old_carry = cpu->status.c;
+    uint8_t old_carry = FLAG_C(cpu);
     // Store bit 7 in carry before rotating
-    cpu->status.c = (*operand >> 7) & 1;
+    SET_FLAG_C(cpu, (*operand >> 7) & 1);
     // Shift all bits left one position and insert old carry into bit 0
     *operand = (*operand << 1) | old_carry;
     // Update status flags
@@ -290,18 +296,18 @@ static void RotateOneLeft(Cpu *cpu, uint8_t *operand)
 
 static uint8_t RotateOneLeftFromMem(Cpu *cpu, const uint16_t operand_addr)
 {
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
     // Dummy write
-    CpuWrite8(operand_addr, operand);
-    uint8_t old_carry = cpu->status.c;
+    CpuWrite8(cpu, operand_addr, operand);
+    uint8_t old_carry = FLAG_C(cpu);
     // Store bit 7 in carry before rotating
-    cpu->status.c = (operand >> 7) & 1;
+    SET_FLAG_C(cpu, (operand >> 7) & 1);
     // Shift all bits left one position and insert old carry into bit 0
     operand = (operand << 1) | old_carry;
     // IRQ polling before last cycle
     CpuPollIRQ(cpu);
     // Write to the bus
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
     // Update status flags
     UPDATE_FLAGS_NZ(operand);
     return operand;
@@ -309,9 +315,9 @@ static uint8_t RotateOneLeftFromMem(Cpu *cpu, const uint16_t operand_addr)
 
 static void RotateOneRight(Cpu *cpu, uint8_t *operand)
 {
-    uint8_t old_carry = cpu->status.c;
+    uint8_t old_carry = FLAG_C(cpu);
     // Store bit 0 in carry before rotating
-    cpu->status.c = *operand & 1;
+    SET_FLAG_C(cpu, *operand & 1);
     // Shift all bits right one position and insert old carry into bit 7
     *operand = (*operand >> 1) | (old_carry << 7);
     // Update status flags
@@ -320,18 +326,18 @@ static void RotateOneRight(Cpu *cpu, uint8_t *operand)
 
 static uint8_t RotateOneRightFromMem(Cpu *cpu, const uint16_t operand_addr)
 {
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
     // Dummy write
-    CpuWrite8(operand_addr, operand);
-    uint8_t old_carry = cpu->status.c;
+    CpuWrite8(cpu, operand_addr, operand);
+    uint8_t old_carry = FLAG_C(cpu);
     // Store bit 0 in carry before rotating
-    cpu->status.c = operand & 1;
+    SET_FLAG_C(cpu, operand & 1);
     // Shift all bits right one position and insert old carry into bit 7
     operand = (operand >> 1) | (old_carry << 7);
     // IRQ polling before last cycle
     CpuPollIRQ(cpu);
     // Write to the bus
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
     // Update status flags
     UPDATE_FLAGS_NZ(operand);
     return operand;
@@ -340,39 +346,35 @@ static uint8_t RotateOneRightFromMem(Cpu *cpu, const uint16_t operand_addr)
 static void ShiftOneRight(Cpu *cpu, uint8_t *operand)
 {
     // Store bit 0 in carry before shifting
-    cpu->status.c = *operand & 1;
+    SET_FLAG_C(cpu, *operand & 1);
     // Shift all bits right by one position
     *operand >>= 1;
-    // Clear N flag 
-    cpu->status.n = 0;
-    // Zero flag (is operand zero?)
-    cpu->status.z = !(*operand);
+    // N is always cleared since bit 7 is now zero
+    UPDATE_FLAGS_NZ(*operand);
 }
 
 static uint8_t ShiftOneRightFromMem(Cpu *cpu, const uint16_t operand_addr)
 {
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
     // Dummy write
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
     // Store bit 0 in carry before shifting
-    cpu->status.c = operand & 1;
+    SET_FLAG_C(cpu, operand & 1);
     // Shift all bits right by one position
     operand >>= 1;
     // IRQ polling before last cycle
     CpuPollIRQ(cpu);
     // Write to the bus
-    CpuWrite8(operand_addr, operand);
-    // Clear N flag 
-    cpu->status.n = 0;
-    // Zero flag (is operand zero?)
-    cpu->status.z = !operand;
+    CpuWrite8(cpu, operand_addr, operand);
+    // N is always cleared since bit 7 is now zero
+    UPDATE_FLAGS_NZ(operand);
     return operand;
 }
 
 static void ShiftOneLeft(Cpu *cpu, uint8_t *operand)
 {
     // Store bit 7 in carry before shifting
-    cpu->status.c = (*operand >> 7) & 1;
+    SET_FLAG_C(cpu, (*operand >> 7) & 1);
     // Shift all bits left by one position
     *operand <<= 1;
     // Update status flags
@@ -381,17 +383,17 @@ static void ShiftOneLeft(Cpu *cpu, uint8_t *operand)
 
 static uint8_t ShiftOneLeftFromMem(Cpu *cpu, const uint16_t operand_addr)
 {
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
     // Dummy write
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
     // Store bit 7 in carry before shifting
-    cpu->status.c = (operand >> 7) & 1;
+    SET_FLAG_C(cpu, (operand >> 7) & 1);
     // Shift all bits left by one position
     operand <<= 1;
     // IRQ polling before last cycle
     CpuPollIRQ(cpu);
     // Write to the bus
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
     // Update status flags
     UPDATE_FLAGS_NZ(operand);
     return operand;
@@ -400,13 +402,13 @@ static uint8_t ShiftOneLeftFromMem(Cpu *cpu, const uint16_t operand_addr)
 // ADC/SBC only uses the A register (Accumulator)
 static void AddWithCarry(Cpu *cpu, uint8_t operand)
 {
-    uint16_t sum = cpu->a + operand + cpu->status.c;
+    uint16_t sum = cpu->a + operand + FLAG_C(cpu);
 
     // Set Carry Flag (C) - Set if result is > 255 (unsigned overflow)
-    cpu->status.c = (sum > UINT8_MAX);
+    SET_FLAG_C(cpu, sum > UINT8_MAX);
 
     // Set Overflow Flag (V) - Detect signed overflow
-    cpu->status.v = ((sum ^ cpu->a) & (sum ^ operand) & 0x80) > 0;
+    SET_FLAG_V(cpu, ((sum ^ cpu->a) & (sum ^ operand) & 0x80) > 0);
 
     // Store result
     cpu->a = (uint8_t)sum;
@@ -417,38 +419,136 @@ static void AddWithCarry(Cpu *cpu, uint8_t operand)
     CPU_LOG("ADC/SBC Operand: %x\n", operand);
 }
 
+// Loops longer than this aren't checked for being idle
+#define IDLE_LOOP_MAX_INSTRS 3
+
+// A loop that does nothing but poll memory, e.g. waiting on a flag set by the nmi handler or for
+// vblank through $2002, ends every iteration in the same state until the next event can change
+// what it reads. So whole iterations up to that point only tick the apu and count the cycles.
+// The body runs from loop_start up to the jump back at loop_end, which takes end_cycles
+static void CpuSkipIdleLoop(Cpu *cpu, const uint16_t loop_start, const uint16_t loop_end, const int end_cycles)
+{
+    System *system = cpu->system;
+
+    const uint16_t prev_pc = cpu->idle_loop_pc;
+    const uint64_t prev_cycle = cpu->idle_loop_cycle;
+    cpu->idle_loop_pc = loop_end;
+    cpu->idle_loop_cycle = system->cycles;
+
+    // The iteration that just ran has to be a whole one, with no event anywhere in it (the last
+    // read could have been before one) and nothing else like an interrupt or dma stretching it
+    if (prev_pc != loop_end || system->last_event_cycle >= prev_cycle || cpu->nmi_pending || cpu->irq_pending)
+        return;
+
+    const uint64_t idle_cycles = SystemIdleCycles(system);
+    if (!idle_cycles)
+        return;
+
+    // Only vblank can end a $2002 poll on an event, sprite 0 hit and overflow aren't one
+    uint8_t end_opcode = 0;
+    const bool vblank_poll = SystemPeek(system, loop_end, &end_opcode) && end_opcode == 0x10;
+
+    int cycles = end_cycles;
+    int instrs = 1;
+    uint16_t addr = loop_start;
+
+    while (addr < loop_end)
+    {
+        uint8_t opcode;
+        uint8_t operand_low;
+        uint8_t operand_high;
+
+        if (instrs == IDLE_LOOP_MAX_INSTRS || !SystemPeek(system, addr, &opcode) ||
+            !SystemPeek(system, addr + 1, &operand_low))
+            return;
+
+        switch (opcode)
+        {
+            // LDA, LDX, LDY, BIT, CMP, CPX, CPY zp
+            case 0xA5: case 0xA6: case 0xA4: case 0x24:
+            case 0xC5: case 0xE4: case 0xC4:
+                if (!SystemReadIsPure(system, operand_low))
+                    return;
+                cycles += 3;
+                addr += 2;
+                break;
+            // LDA, LDX, LDY, BIT, CMP, CPX, CPY abs
+            case 0xAD: case 0xAE: case 0xAC: case 0x2C:
+            case 0xCD: case 0xEC: case 0xCC:
+            {
+                if (!SystemPeek(system, addr + 2, &operand_high))
+                    return;
+
+                const uint16_t operand_addr = (uint16_t)operand_high << 8 | operand_low;
+                // A load of $2002 on its own, the flags it leaves for the BPL only depend on vblank
+                const bool status_read = vblank_poll && operand_addr >= 0x2000 && operand_addr < 0x4000 &&
+                                         (operand_addr & 7) == 2 && addr == loop_start && addr + 3 == loop_end &&
+                                         opcode != 0xCD && opcode != 0xEC && opcode != 0xCC;
+
+                if (!status_read && !SystemReadIsPure(system, operand_addr))
+                    return;
+                cycles += 4;
+                addr += 3;
+                break;
+            }
+            // AND, CMP, CPX, CPY #imm
+            case 0x29: case 0xC9: case 0xE0: case 0xC0:
+                cycles += 2;
+                addr += 2;
+                break;
+            default:
+                return;
+        }
+
+        ++instrs;
+    }
+
+    if (addr != loop_end || system->cycles - prev_cycle != (uint64_t)cycles)
+        return;
+
+    const uint64_t iterations = idle_cycles / cycles;
+    SystemRunIdleCycles(system, iterations * cycles);
+    cpu->instructions += iterations * instrs;
+    cpu->idle_loop_cycle = system->cycles;
+}
+
 static void BranchHandler(Cpu *cpu, const bool flag_cmp)
 {
     if (!flag_cmp)
     {
         CpuPollIRQ(cpu);
-        CpuRead8(++cpu->pc);
+        CpuRead8(cpu, ++cpu->pc);
         ++cpu->pc;
         return;
     }
 
-    int8_t offset = (int8_t)CpuRead8(++cpu->pc);
+    const uint16_t branch_addr = cpu->pc;
+    int8_t offset = (int8_t)CpuRead8(cpu, ++cpu->pc);
     ++cpu->pc;
     uint16_t final_addr = cpu->pc + offset;
+    const bool page_cross = PageCross(cpu->pc, final_addr);
     // Extra cycle if the branch crosses a page boundary
-    if (PageCross(cpu->pc, final_addr))
+    if (page_cross)
     {
         // Dummy read 1
-        CpuRead8(final_addr + PAGE_SIZE);
+        CpuRead8(cpu, final_addr + PAGE_SIZE);
         CpuPollIRQ(cpu);
         // Dummy read 2
-        CpuRead8(final_addr);
+        CpuRead8(cpu, final_addr);
     }
     else
     {
         // TODO: Shouldn't IRQ's be ignored here?
         CpuPollIRQ(cpu);
-        CpuRead8(cpu->pc);
+        CpuRead8(cpu, cpu->pc);
     }
     cpu->pc = final_addr;
+
+    if (cpu->idle_skip && final_addr <= branch_addr)
+        CpuSkipIdleLoop(cpu, final_addr, branch_addr, page_cross ? 4 : 3);
 }
 
-static uint16_t GetOperandAddrFromMem(Cpu *cpu, AddressingMode addr_mode, bool page_cycle, bool dummy_read)
+CPU_INLINE uint16_t GetOperandAddrFromMem(Cpu *cpu, AddressingMode addr_mode, bool page_cycle, bool dummy_read)
 {
     switch (addr_mode)
     {
@@ -480,20 +580,20 @@ static uint16_t GetOperandAddrFromMem(Cpu *cpu, AddressingMode addr_mode, bool p
     return 0;
 }
 
-static void ADC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ADC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    AddWithCarry(cpu, CpuRead8(operand_addr));
+    AddWithCarry(cpu, CpuRead8(cpu, operand_addr));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void AND_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void AND_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    cpu->a &= CpuRead8(operand_addr);
+    cpu->a &= CpuRead8(cpu, operand_addr);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->a);
@@ -501,38 +601,38 @@ static void AND_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void ASR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ASR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    cpu->a &= CpuRead8(operand_addr);
+    cpu->a &= CpuRead8(cpu, operand_addr);
     ShiftOneRight(cpu, &cpu->a);
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void ANC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ANC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    cpu->a &= CpuRead8(operand_addr);
+    cpu->a &= CpuRead8(cpu, operand_addr);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->a);
     // Update carry bit like ASL
-    cpu->status.c = (cpu->a >> 7) & 1;
+    SET_FLAG_C(cpu, (cpu->a >> 7) & 1);
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void ANE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ANE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     CpuPollIRQ(cpu);
-    cpu->a &= cpu->x & CpuRead8(++cpu->pc);
+    cpu->a &= cpu->x & CpuRead8(cpu, ++cpu->pc);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->a);
@@ -541,34 +641,34 @@ static void ANE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void ARR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ARR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     CpuPollIRQ(cpu);
-    cpu->a &= CpuRead8(++cpu->pc);
+    cpu->a &= CpuRead8(cpu, ++cpu->pc);
 
     RotateOneRight(cpu, &cpu->a);
     // C will be copied from the bit 6 of the result
-    cpu->status.c = (cpu->a >> 6) & 1;
+    SET_FLAG_C(cpu, (cpu->a >> 6) & 1);
     // V is the result of an XOR operation between the bit 6 and the bit 5 of the result
-    cpu->status.v = cpu->status.c ^ ((cpu->a >> 5) & 1);
+    SET_FLAG_V(cpu, FLAG_C(cpu) ^ ((cpu->a >> 5) & 1));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void SAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, cpu->a & cpu->x);
+    CpuWrite8(cpu, operand_addr, cpu->a & cpu->x);
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void ASL_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ASL_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -576,19 +676,19 @@ static void ASL_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
     ShiftOneLeft(cpu, &cpu->a);
     CpuHandleInterrupts(cpu);
 }
 
-static void ASL_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ASL_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     ShiftOneLeftFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void SLO_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SLO_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     cpu->a |= ShiftOneLeftFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     // Update status flags
@@ -597,7 +697,7 @@ static void SLO_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void SRE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SRE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     cpu->a ^= ShiftOneRightFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     // Update status flags
@@ -606,92 +706,91 @@ static void SRE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void BCC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BCC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, !cpu->status.c);
+    BranchHandler(cpu, !FLAG_C(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BCS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BCS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, cpu->status.c);
+    BranchHandler(cpu, FLAG_C(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BEQ_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BEQ_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, cpu->status.z);
+    BranchHandler(cpu, FLAG_Z(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BIT_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BIT_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    uint8_t operand = CpuRead8(operand_addr);
-    cpu->status.n = GET_NEG_BIT(operand);
-    cpu->status.v = GET_OVERFLOW_BIT(operand);
-    cpu->status.z = !(cpu->a & operand);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
+    UPDATE_FLAGS_N_Z(operand, cpu->a & operand);
+    SET_FLAG_V(cpu, GET_OVERFLOW_BIT(operand));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void BMI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BMI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, cpu->status.n);
+    BranchHandler(cpu, FLAG_N(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BNE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BNE_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, !cpu->status.z);
+    BranchHandler(cpu, !FLAG_Z(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BPL_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BPL_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, !cpu->status.n);
+    BranchHandler(cpu, !FLAG_N(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BRK_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BRK_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
     ++cpu->pc;
     // Push PC += 2
     StackPush(cpu, (cpu->pc >> 8) & 0xFF);
     StackPush(cpu, cpu->pc & 0xFF);
     // Push status status regs with the b(bit4) and bit5 flag set
-    Flags status = cpu->status;
+    Flags status = {.raw = CPU_GetStatus(cpu)};
     status.b = 1;
     status.unused = 1;
     StackPush(cpu, status.raw);
@@ -700,38 +799,38 @@ static void BRK_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     if (!cpu->nmi_pending)
     {
         // Load IRQ vector ($FFFE-$FFFF) into PC
-        cpu->pc = CpuReadVector(0xFFFE);
+        cpu->pc = CpuReadVector(cpu, 0xFFFE);
         CPU_LOG("Jumping to IRQ vector at 0x%X\n", cpu->pc);
     }
     else
     {
         // NMI vector hijacking
-        cpu->pc = CpuReadVector(0xFFFA);
+        cpu->pc = CpuReadVector(cpu, 0xFFFA);
         cpu->nmi_pending = false;
         CPU_LOG("Jumping to NMI vector at 0x%X from hijacked BRK\n", cpu->pc);
     }
 }
 
-static void BVC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BVC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, !cpu->status.v);
+    BranchHandler(cpu, !FLAG_V(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void BVS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void BVS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    BranchHandler(cpu, cpu->status.v);
+    BranchHandler(cpu, FLAG_V(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void CLC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CLC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -739,13 +838,13 @@ static void CLC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
-    cpu->status.c = 0;
+    SET_FLAG_C(cpu, 0);
     CpuHandleInterrupts(cpu);
 }
 
-static void CLD_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CLD_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -753,13 +852,13 @@ static void CLD_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->status.d = 0;
     CpuHandleInterrupts(cpu);
 }
 
-static void CLI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CLI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -767,13 +866,13 @@ static void CLI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->status.i = 0;
     CpuHandleInterrupts(cpu);
 }
 
-static void CLV_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CLV_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -781,49 +880,49 @@ static void CLV_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
-    cpu->status.v = 0;
+    SET_FLAG_V(cpu, 0);
     CpuHandleInterrupts(cpu);
 }
 
-static void CMP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CMP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    CompareRegAndSetFlags(cpu, cpu->a, CpuRead8(operand_addr));
+    CompareRegAndSetFlags(cpu, cpu->a, CpuRead8(cpu, operand_addr));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void CPX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CPX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, false);
     CpuPollIRQ(cpu);
-    CompareRegAndSetFlags(cpu, cpu->x, CpuRead8(operand_addr));
+    CompareRegAndSetFlags(cpu, cpu->x, CpuRead8(cpu, operand_addr));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void CPY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void CPY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, false);
     CpuPollIRQ(cpu);
-    CompareRegAndSetFlags(cpu, cpu->y, CpuRead8(operand_addr));
+    CompareRegAndSetFlags(cpu, cpu->y, CpuRead8(cpu, operand_addr));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void DEC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void DEC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
 
     // Dummy write
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, --operand);
+    CpuWrite8(cpu, operand_addr, --operand);
     // Update status flags
     UPDATE_FLAGS_NZ(operand);
 
@@ -831,16 +930,16 @@ static void DEC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void DCP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void DCP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
 
     // Dummy write
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, --operand);
+    CpuWrite8(cpu, operand_addr, --operand);
 
     CompareRegAndSetFlags(cpu, cpu->a, operand);
 
@@ -848,7 +947,7 @@ static void DCP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void DEX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void DEX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -856,7 +955,7 @@ static void DEX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     --cpu->x;
     // Update status flags
@@ -865,7 +964,7 @@ static void DEX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void SBX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SBX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -874,22 +973,20 @@ static void SBX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuPollIRQ(cpu);
 
     // Always immediate addr mode
-    uint8_t operand = CpuRead8(++cpu->pc);
+    uint8_t operand = CpuRead8(cpu, ++cpu->pc);
     cpu->x = (cpu->a & cpu->x) - operand;
 
-    // Negative flag (bit 7)
-    cpu->status.n = GET_NEG_BIT(cpu->x);
-    // Zero flag (is result zero?)
-    cpu->status.z = !cpu->x;
+    // Negative and zero flags
+    UPDATE_FLAGS_NZ(cpu->x);
     // Update the Carry Flag (C)
-    cpu->status.c = (cpu->a >= cpu->x);
+    SET_FLAG_C(cpu, cpu->a >= cpu->x);
 
     ++cpu->pc;
 
     CpuHandleInterrupts(cpu);
 }
 
-static void DEY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void DEY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -897,7 +994,7 @@ static void DEY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     --cpu->y;
     // Update status flags
@@ -906,12 +1003,12 @@ static void DEY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void EOR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void EOR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
 
-    cpu->a ^= CpuRead8(operand_addr);
+    cpu->a ^= CpuRead8(cpu, operand_addr);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->a);
@@ -919,32 +1016,32 @@ static void EOR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void INC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void INC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
 
     // Dummy write
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, ++operand);
+    CpuWrite8(cpu, operand_addr, ++operand);
     UPDATE_FLAGS_NZ(operand);
 
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void ISC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ISC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
 
     // Dummy write
-    CpuWrite8(operand_addr, operand);
+    CpuWrite8(cpu, operand_addr, operand);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, ++operand);
+    CpuWrite8(cpu, operand_addr, ++operand);
 
     AddWithCarry(cpu, ~operand);
 
@@ -952,7 +1049,7 @@ static void ISC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void INX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void INX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -960,7 +1057,7 @@ static void INX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     ++cpu->x;
     // Update status flags
@@ -969,7 +1066,7 @@ static void INX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void INY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void INY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -977,7 +1074,7 @@ static void INY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     ++cpu->y;
     // Update status flags
@@ -986,16 +1083,21 @@ static void INY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void JMP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void JMP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     UNUSED(page_cycle);
 
     if (addr_mode == Absolute)
     {
-        uint8_t addr_low = CpuRead8(++cpu->pc);
+        const uint16_t jmp_addr = cpu->pc;
+        uint8_t addr_low = CpuRead8(cpu, ++cpu->pc);
         CpuPollIRQ(cpu);
-        uint8_t addr_high = CpuRead8(++cpu->pc);
+        uint8_t addr_high = CpuRead8(cpu, ++cpu->pc);
         cpu->pc = (uint16_t)addr_high << 8 | addr_low;
+
+        // Jumping to itself, the usual way to wait for the nmi
+        if (cpu->idle_skip && cpu->pc == jmp_addr)
+            CpuSkipIdleLoop(cpu, jmp_addr, jmp_addr, 3);
     }
     else
     {
@@ -1005,32 +1107,32 @@ static void JMP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void JSR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void JSR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
-    uint8_t pc_low = CpuRead8(++cpu->pc);
+    uint8_t pc_low = CpuRead8(cpu, ++cpu->pc);
     ++cpu->pc;
     // Dummy read from the stack
-    CpuRead8(STACK_START + cpu->sp);
+    CpuRead8(cpu, STACK_START + cpu->sp);
 
     StackPush(cpu, (cpu->pc >> 8) & 0xFF);
     StackPush(cpu, cpu->pc & 0xFF);
 
     CpuPollIRQ(cpu);
-    uint8_t pc_high = CpuRead8(cpu->pc);
+    uint8_t pc_high = CpuRead8(cpu, cpu->pc);
     cpu->pc = (uint16_t)pc_high << 8 | pc_low;
     CpuHandleInterrupts(cpu);
 }
 
-static void LDA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LDA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
 
-    cpu->a = CpuRead8(operand_addr);
+    cpu->a = CpuRead8(cpu, operand_addr);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->a);
@@ -1039,12 +1141,12 @@ static void LDA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void LDX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LDX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
 
-    cpu->x = CpuRead8(operand_addr);
+    cpu->x = CpuRead8(cpu, operand_addr);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->x);
@@ -1052,7 +1154,7 @@ static void LDX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void LAS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LAS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1060,7 +1162,7 @@ static void LAS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     const uint16_t operand_addr = GetAbsoluteYAddr(cpu, page_cycle, true);
     CpuPollIRQ(cpu);
 
-    cpu->a = cpu->x = cpu->sp = CpuRead8(operand_addr) & cpu->sp;
+    cpu->a = cpu->x = cpu->sp = CpuRead8(cpu, operand_addr) & cpu->sp;
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->a);
@@ -1069,12 +1171,12 @@ static void LAS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void LAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
 
-    cpu->a = CpuRead8(operand_addr);
+    cpu->a = CpuRead8(cpu, operand_addr);
     cpu->x = cpu->a;
 
     // Update status flags
@@ -1084,14 +1186,14 @@ static void LAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void LXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     CpuPollIRQ(cpu);
-    cpu->a &= cpu->a & CpuRead8(++cpu->pc);
+    cpu->a &= cpu->a & CpuRead8(cpu, ++cpu->pc);
     cpu->x = cpu->a;
 
     // Update status flags
@@ -1101,12 +1203,12 @@ static void LXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void LDY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LDY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
 
-    cpu->y = CpuRead8(operand_addr);
+    cpu->y = CpuRead8(cpu, operand_addr);
 
     // Update status flags
     UPDATE_FLAGS_NZ(cpu->y);
@@ -1114,7 +1216,7 @@ static void LDY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void LSR_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LSR_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1122,20 +1224,20 @@ static void LSR_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     ShiftOneRight(cpu, &cpu->a);
     CpuHandleInterrupts(cpu);
 }
 
-static void LSR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void LSR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     ShiftOneRightFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void NOP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void NOP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     uint16_t operand_addr = 0;
     switch (addr_mode)
@@ -1143,35 +1245,35 @@ static void NOP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
         case Implied:
             CpuPollIRQ(cpu);
             // Dummy read of next instruction byte
-            CpuRead8(++cpu->pc);
+            CpuRead8(cpu, ++cpu->pc);
             break;
         case Immediate:
             CpuPollIRQ(cpu);
-            CpuRead8(++cpu->pc);
+            CpuRead8(cpu, ++cpu->pc);
             ++cpu->pc;
             break;
         case ZeroPage:
             operand_addr = GetZPAddr(cpu);
             CpuPollIRQ(cpu);
-            CpuRead8(operand_addr);
+            CpuRead8(cpu, operand_addr);
             ++cpu->pc;
             break;
         case ZeroPageX:
             operand_addr = GetZPIndexedAddr(cpu, cpu->x);
             CpuPollIRQ(cpu);
-            CpuRead8(operand_addr);
+            CpuRead8(cpu, operand_addr);
             ++cpu->pc;
             break;
         case Absolute:
             operand_addr = GetAbsoluteAddr(cpu);
             CpuPollIRQ(cpu);
-            CpuRead8(operand_addr);
+            CpuRead8(cpu, operand_addr);
             ++cpu->pc;
             break;
         case AbsoluteX:
             operand_addr = GetAbsoluteXAddr(cpu, page_cycle, true);
             CpuPollIRQ(cpu);
-            CpuRead8(operand_addr);
+            CpuRead8(cpu, operand_addr);
             ++cpu->pc;
             break;
         default:
@@ -1183,11 +1285,11 @@ static void NOP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void ORA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ORA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
     cpu->a |= operand;
 
     // Update status flags
@@ -1196,14 +1298,14 @@ static void ORA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void PHA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void PHA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     CpuPollIRQ(cpu);
     // Push accumulator reg to stack
@@ -1211,16 +1313,16 @@ static void PHA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void PHP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void PHP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
-    Flags status = cpu->status;
+    Flags status = {.raw = CPU_GetStatus(cpu)};
     status.b = true;
     status.unused = true;
     CpuPollIRQ(cpu);
@@ -1228,16 +1330,16 @@ static void PHP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void PLA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void PLA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
     // Read for incrementing the SP
-    CpuRead8(STACK_START + cpu->sp);
+    CpuRead8(cpu, STACK_START + cpu->sp);
 
     CpuPollIRQ(cpu);
     cpu->a = StackPull(cpu);
@@ -1245,32 +1347,24 @@ static void PLA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void PLP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void PLP_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
     // Read for incrementing the SP
-    CpuRead8(STACK_START + cpu->sp);
+    CpuRead8(cpu, STACK_START + cpu->sp);
 
     CpuPollIRQ(cpu);
-    uint8_t status_raw = StackPull(cpu);
-    Flags status = {.raw = status_raw};
-
-    // Ignore bit for break and 5th bit
-    cpu->status.c = status.c;
-    cpu->status.d = status.d;
-    cpu->status.i = status.i;
-    cpu->status.n = status.n;
-    cpu->status.v = status.v;
-    cpu->status.z = status.z;
+    // Ignores the break and 5th bit
+    CPU_SetStatus(cpu, StackPull(cpu));
     CpuHandleInterrupts(cpu);
 }
 
-static void ROL_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ROL_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1278,20 +1372,20 @@ static void ROL_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     RotateOneLeft(cpu, &cpu->a);
     CpuHandleInterrupts(cpu);
 }
 
-static void ROL_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ROL_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     RotateOneLeftFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void ROR_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ROR_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1299,54 +1393,46 @@ static void ROR_A_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     RotateOneRight(cpu, &cpu->a);
     CpuHandleInterrupts(cpu);
 }
 
-static void ROR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void ROR_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     RotateOneRightFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void RLA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void RLA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     cpu->a &= RotateOneLeftFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void RRA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void RRA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     AddWithCarry(cpu, RotateOneRightFromMem(cpu, GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true)));
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void RTI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void RTI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
     // Read for incrementing the SP
-    CpuRead8(STACK_START + cpu->sp);
-
-    uint8_t status_raw = StackPull(cpu);
-    Flags status = {.raw = status_raw};
+    CpuRead8(cpu, STACK_START + cpu->sp);
 
-    // Ignore bit for break and 5th bit
-    cpu->status.c = status.c;
-    cpu->status.d = status.d;
-    cpu->status.i = status.i;
-    cpu->status.n = status.n;
-    cpu->status.v = status.v;
-    cpu->status.z = status.z;
+    // Ignores the break and 5th bit
+    CPU_SetStatus(cpu, StackPull(cpu));
 
     uint8_t pc_low = StackPull(cpu);
     CpuPollIRQ(cpu);
@@ -1355,31 +1441,31 @@ static void RTI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void RTS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void RTS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
 
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
     // Read for incrementing the SP
-    CpuRead8(STACK_START + cpu->sp);
+    CpuRead8(cpu, STACK_START + cpu->sp);
 
     uint8_t pc_low = StackPull(cpu);
     uint8_t pc_high = StackPull(cpu);
 
     CpuPollIRQ(cpu);
     cpu->pc = ((uint16_t)pc_high << 8 | pc_low);
-    CpuRead8(cpu->pc++);
+    CpuRead8(cpu, cpu->pc++);
     CpuHandleInterrupts(cpu);
 }
 
-static void SBC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SBC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
     CpuPollIRQ(cpu);
-    uint8_t operand = CpuRead8(operand_addr);
+    uint8_t operand = CpuRead8(cpu, operand_addr);
     // Invert operand since we are reusing ADC logic for SBC
     AddWithCarry(cpu, ~operand);
 
@@ -1388,7 +1474,7 @@ static void SBC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void SEC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SEC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1396,13 +1482,13 @@ static void SEC_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
-    cpu->status.c = 1;
+    SET_FLAG_C(cpu, 1);
     CpuHandleInterrupts(cpu);
 }
 
-static void SED_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SED_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1410,13 +1496,13 @@ static void SED_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->status.d = 1;
     CpuHandleInterrupts(cpu);
 }
 
-static void SEI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SEI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1424,43 +1510,43 @@ static void SEI_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->status.i = 1;
     CpuHandleInterrupts(cpu);
 }
 
-static void STA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void STA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, true);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, cpu->a);
+    CpuWrite8(cpu, operand_addr, cpu->a);
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void STX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void STX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, false);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, cpu->x);
+    CpuWrite8(cpu, operand_addr, cpu->x);
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void STY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void STY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     const uint16_t operand_addr = GetOperandAddrFromMem(cpu, addr_mode, page_cycle, false);
 
     CpuPollIRQ(cpu);
-    CpuWrite8(operand_addr, cpu->y);
+    CpuWrite8(cpu, operand_addr, cpu->y);
     ++cpu->pc;
     CpuHandleInterrupts(cpu);
 }
 
-static void SHA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SHA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(page_cycle);
@@ -1470,7 +1556,7 @@ static void SHA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void SHS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SHS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(page_cycle);
@@ -1481,7 +1567,7 @@ static void SHS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void SHY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SHY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(page_cycle);
@@ -1491,7 +1577,7 @@ static void SHY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void SHX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void SHX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(page_cycle);
@@ -1502,7 +1588,7 @@ static void SHX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 }
 
 // Transfer Accumulator to Index X
-static void TAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void TAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1510,7 +1596,7 @@ static void TAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->x = cpu->a;
     // Update status flags
@@ -1520,7 +1606,7 @@ static void TAX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 }
 
 // Transfer Accumulator to Index Y
-static void TAY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void TAY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1528,7 +1614,7 @@ static void TAY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->y = cpu->a;
     // Update status flags
@@ -1538,7 +1624,7 @@ static void TAY_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 }
 
 // Transfer Stack Pointer to Index X
-static void TSX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void TSX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1546,7 +1632,7 @@ static void TSX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->x = cpu->sp;
     // Update status flags
@@ -1556,7 +1642,7 @@ static void TSX_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 }
 
 // Transfer Index X to Accumulator
-static void TXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void TXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1564,7 +1650,7 @@ static void TXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->a = cpu->x;
     // Update status flags
@@ -1574,7 +1660,7 @@ static void TXA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 }
 
 // Transfer Index X to Stack Register
-static void TXS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void TXS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1582,7 +1668,7 @@ static void TXS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->sp = cpu->x;
 
@@ -1590,7 +1676,7 @@ static void TXS_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 }
 
 // Transfer Index Y to Accumulator
-static void TYA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void TYA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
@@ -1598,7 +1684,7 @@ static void TYA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 
     CpuPollIRQ(cpu);
     // Dummy read of next instruction byte
-    CpuRead8(++cpu->pc);
+    CpuRead8(cpu, ++cpu->pc);
 
     cpu->a = cpu->y;
 
@@ -1606,310 +1692,333 @@ static void TYA_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
     CpuHandleInterrupts(cpu);
 }
 
-static void JAM_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
+CPU_INLINE void JAM_Instr(Cpu *cpu, AddressingMode addr_mode, bool page_cycle)
 {
     // Unused
     UNUSED(addr_mode);
     UNUSED(page_cycle);
     
-    printf("\nJAM opcode: 0x%02X at PC: 0x%04X\n", CpuRead8(cpu->pc), cpu->pc);
+    printf("\nJAM opcode: 0x%02X at PC: 0x%04X\n", CpuRead8(cpu, cpu->pc), cpu->pc);
     printf("Cycles done: %lu\n", cpu->cycles);
-    printf("A: 0x%X\nX: 0x%X\nY: 0x%X\nSP: 0x%X\nSR: 0x%X\n\n", cpu->a, cpu->x, cpu->y, cpu->sp, cpu->status.raw);
+    printf("A: 0x%X\nX: 0x%X\nY: 0x%X\nSP: 0x%X\nSR: 0x%X\n\n", cpu->a, cpu->x, cpu->y, cpu->sp, CPU_GetStatus(cpu));
 
     // Dump Stack for debugging
     for (int sp = 0xFF; sp >= cpu->sp; sp--)
     {
-        printf("STACK: 0x%X = %X\n", sp + STACK_START, CpuRead8(sp + STACK_START));
+        printf("STACK: 0x%X = %X\n", sp + STACK_START, CpuRead8(cpu, sp + STACK_START));
     }
 
     printf("Exiting Emulator!\n");
     exit(EXIT_FAILURE);
 }
 
+// Every opcode as X(opcode, handler, mnemonic, bytes, page cross penalty, addressing mode),
+// both the opcode table and the dispatch in CPU_Run are generated from this list
+#define CPU_OPCODE_LIST(X) \
+    X(0x00, BRK_Instr,   "BRK",         1, false, Implied    ) \
+    X(0x01, ORA_Instr,   "ORA (ind,X)", 2, false, IndirectX  ) \
+    X(0x02, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x03, SLO_Instr,   "SLO (ind,X)", 2, false, IndirectX  ) \
+    X(0x04, NOP_Instr,   "NOP",         2, false, ZeroPage   ) \
+    X(0x05, ORA_Instr,   "ORA zp",      2, false, ZeroPage   ) \
+    X(0x06, ASL_Instr,   "ASL zp",      2, false, ZeroPage   ) \
+    X(0x07, SLO_Instr,   "SLO zp",      2, false, ZeroPage   ) \
+    X(0x08, PHP_Instr,   "PHP",         1, false, Implied    ) \
+    X(0x09, ORA_Instr,   "ORA #imm",    2, false, Immediate  ) \
+    X(0x0A, ASL_A_Instr, "ASL A",       1, false, Accumulator) \
+    X(0x0B, ANC_Instr,   "ANC #imm",    2, false, Immediate  ) \
+    X(0x0C, NOP_Instr,   "NOP",         3, false, Absolute   ) \
+    X(0x0D, ORA_Instr,   "ORA abs",     3, false, Absolute   ) \
+    X(0x0E, ASL_Instr,   "ASL abs",     3, false, Absolute   ) \
+    X(0x0F, SLO_Instr,   "SLO abs",     3, false, Absolute   ) \
+    \
+    X(0x10, BPL_Instr,   "BPL rel",     2, true,  Relative   ) \
+    X(0x11, ORA_Instr,   "ORA (ind),Y", 2, true,  IndirectY  ) \
+    X(0x12, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x13, SLO_Instr,   "SLO (ind),Y", 2, false, IndirectY  ) \
+    X(0x14, NOP_Instr,   "NOP zp,X",    2, false, ZeroPageX  ) \
+    X(0x15, ORA_Instr,   "ORA zp,X",    2, false, ZeroPageX  ) \
+    X(0x16, ASL_Instr,   "ASL zp,X",    2, false, ZeroPageX  ) \
+    X(0x17, SLO_Instr,   "SLO zp,X",    2, false, ZeroPageX  ) \
+    X(0x18, CLC_Instr,   "CLC",         1, false, Implied    ) \
+    X(0x19, ORA_Instr,   "ORA abs,Y",   3, true,  AbsoluteY  ) \
+    X(0x1A, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0x1B, SLO_Instr,   "SLO abs,Y",   3, false, AbsoluteY  ) \
+    X(0x1C, NOP_Instr,   "NOP abs,X",   3, true,  AbsoluteX  ) \
+    X(0x1D, ORA_Instr,   "ORA abs,X",   3, true,  AbsoluteX  ) \
+    X(0x1E, ASL_Instr,   "ASL abs,X",   3, false, AbsoluteX  ) \
+    X(0x1F, SLO_Instr,   "SLO abs,X",   3, false, AbsoluteX  ) \
+    \
+    X(0x20, JSR_Instr,   "JSR abs",     3, false, Absolute   ) \
+    X(0x21, AND_Instr,   "AND (ind,X)", 2, false, IndirectX  ) \
+    X(0x22, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x23, RLA_Instr,   "RLA (ind,X)", 2, false, IndirectX  ) \
+    X(0x24, BIT_Instr,   "BIT zp",      2, false, ZeroPage   ) \
+    X(0x25, AND_Instr,   "AND zp",      2, false, ZeroPage   ) \
+    X(0x26, ROL_Instr,   "ROL zp",      2, false, ZeroPage   ) \
+    X(0x27, RLA_Instr,   "RLA zp",      2, false, ZeroPage   ) \
+    X(0x28, PLP_Instr,   "PLP",         1, false, Implied    ) \
+    X(0x29, AND_Instr,   "AND #imm",    2, false, Immediate  ) \
+    X(0x2A, ROL_A_Instr, "ROL A",       1, false, Accumulator) \
+    X(0x2B, ANC_Instr,   "ANC2 #imm",   2, false, Immediate  ) \
+    X(0x2C, BIT_Instr,   "BIT abs",     3, false, Absolute   ) \
+    X(0x2D, AND_Instr,   "AND abs",     3, false, Absolute   ) \
+    X(0x2E, ROL_Instr,   "ROL abs",     3, false, Absolute   ) \
+    X(0x2F, RLA_Instr,   "RLA abs",     3, false, Absolute   ) \
+    \
+    X(0x30, BMI_Instr,   "BMI rel",     2, true,  Relative   ) \
+    X(0x31, AND_Instr,   "AND (ind),Y", 2, true,  IndirectY  ) \
+    X(0x32, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x33, RLA_Instr,   "RLA (ind),Y", 2, false, IndirectY  ) \
+    X(0x34, NOP_Instr,   "NOP",         2, false, ZeroPageX  ) \
+    X(0x35, AND_Instr,   "AND zp,X",    2, false, ZeroPageX  ) \
+    X(0x36, ROL_Instr,   "ROL zp,X",    2, false, ZeroPageX  ) \
+    X(0x37, RLA_Instr,   "RLA zp,X",    2, false, ZeroPageX  ) \
+    X(0x38, SEC_Instr,   "SEC",         1, false, Implied    ) \
+    X(0x39, AND_Instr,   "AND abs,Y",   3, true,  AbsoluteY  ) \
+    X(0x3A, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0x3B, RLA_Instr,   "RLA abs,Y",   3, false, AbsoluteY  ) \
+    X(0x3C, NOP_Instr,   "NOP",         3, true,  AbsoluteX  ) \
+    X(0x3D, AND_Instr,   "AND abs,X",   3, true,  AbsoluteX  ) \
+    X(0x3E, ROL_Instr,   "ROL abs,X",   3, false, AbsoluteX  ) \
+    X(0x3F, RLA_Instr,   "RLA abs,X",   3, false, AbsoluteX  ) \
+    \
+    X(0x40, RTI_Instr,   "RTI",         1, false, Implied    ) \
+    X(0x41, EOR_Instr,   "EOR (ind,X)", 2, false, IndirectX  ) \
+    X(0x42, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x43, SRE_Instr,   "SRE (ind,X)", 2, false, IndirectX  ) \
+    X(0x44, NOP_Instr,   "NOP",         2, false, ZeroPage   ) \
+    X(0x45, EOR_Instr,   "EOR zp",      2, false, ZeroPage   ) \
+    X(0x46, LSR_Instr,   "LSR zp",      2, false, ZeroPage   ) \
+    X(0x47, SRE_Instr,   "SRE zp",      2, false, ZeroPage   ) \
+    X(0x48, PHA_Instr,   "PHA",         1, false, Implied    ) \
+    X(0x49, EOR_Instr,   "EOR #imm",    2, false, Immediate  ) \
+    X(0x4A, LSR_A_Instr, "LSR A",       1, false, Accumulator) \
+    X(0x4B, ASR_Instr,   "ASR",         2, false, Immediate  ) \
+    X(0x4C, JMP_Instr,   "JMP abs",     3, false, Absolute   ) \
+    X(0x4D, EOR_Instr,   "EOR abs",     3, false, Absolute   ) \
+    X(0x4E, LSR_Instr,   "LSR abs",     3, false, Absolute   ) \
+    X(0x4F, SRE_Instr,   "SRE abs",     3, false, Absolute   ) \
+    \
+    X(0x50, BVC_Instr,   "BVC rel",     2, true,  Relative   ) \
+    X(0x51, EOR_Instr,   "EOR (ind),Y", 2, true,  IndirectY  ) \
+    X(0x52, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x53, SRE_Instr,   "SRE (ind),Y", 2, false, IndirectY  ) \
+    X(0x54, NOP_Instr,   "NOP",         2, false, ZeroPageX  ) \
+    X(0x55, EOR_Instr,   "EOR zp,X",    2, false, ZeroPageX  ) \
+    X(0x56, LSR_Instr,   "LSR zp,X",    2, false, ZeroPageX  ) \
+    X(0x57, SRE_Instr,   "SRE zp,X",    2, false, ZeroPageX  ) \
+    X(0x58, CLI_Instr,   "CLI",         1, false, Implied    ) \
+    X(0x59, EOR_Instr,   "EOR abs,Y",   3, true,  AbsoluteY  ) \
+    X(0x5A, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0x5B, SRE_Instr,   "SRE abs,Y",   3, false, AbsoluteY  ) \
+    X(0x5C, NOP_Instr,   "NOP",         3, true,  AbsoluteX  ) \
+    X(0x5D, EOR_Instr,   "EOR abs,X",   3, true,  AbsoluteX  ) \
+    X(0x5E, LSR_Instr,   "LSR abs,X",   3, false, AbsoluteX  ) \
+    X(0x5F, SRE_Instr,   "SRE abs,X",   3, false, AbsoluteX  ) \
+    \
+    X(0x60, RTS_Instr,   "RTS",         1, false, Implied    ) \
+    X(0x61, ADC_Instr,   "ADC (ind,X)", 2, false, IndirectX  ) \
+    X(0x62, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x63, RRA_Instr,   "RRA (ind,X)", 2, false, IndirectX  ) \
+    X(0x64, NOP_Instr,   "NOP",         2, false, ZeroPage   ) \
+    X(0x65, ADC_Instr,   "ADC zp",      2, false, ZeroPage   ) \
+    X(0x66, ROR_Instr,   "ROR zp",      2, false, ZeroPage   ) \
+    X(0x67, RRA_Instr,   "RRA zp",      2, false, ZeroPage   ) \
+    X(0x68, PLA_Instr,   "PLA",         1, false, Implied    ) \
+    X(0x69, ADC_Instr,   "ADC #imm",    2, false, Immediate  ) \
+    X(0x6A, ROR_A_Instr, "ROR A",       1, false, Accumulator) \
+    X(0x6B, ARR_Instr,   "ARR",         2, false, Immediate  ) \
+    X(0x6C, JMP_Instr,   "JMP (ind)",   3, false, Indirect   ) \
+    X(0x6D, ADC_Instr,   "ADC abs",     3, false, Absolute   ) \
+    X(0x6E, ROR_Instr,   "ROR abs",     3, false, Absolute   ) \
+    X(0x6F, RRA_Instr,   "RRA abs",     3, false, Absolute   ) \
+    \
+    X(0x70, BVS_Instr,   "BVS rel",     2, true,  Relative   ) \
+    X(0x71, ADC_Instr,   "ADC (ind),Y", 2, true,  IndirectY  ) \
+    X(0x72, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x73, RRA_Instr,   "RRA (ind),Y", 2, false, IndirectY  ) \
+    X(0x74, NOP_Instr,   "NOP",         2, false, ZeroPageX  ) \
+    X(0x75, ADC_Instr,   "ADC zp,X",    2, false, ZeroPageX  ) \
+    X(0x76, ROR_Instr,   "ROR zp,X",    2, false, ZeroPageX  ) \
+    X(0x77, RRA_Instr,   "RRA zp,X",    2, false, ZeroPageX  ) \
+    X(0x78, SEI_Instr,   "SEI",         1, false, Implied    ) \
+    X(0x79, ADC_Instr,   "ADC abs,Y",   3, true,  AbsoluteY  ) \
+    X(0x7A, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0x7B, RRA_Instr,   "RRA abs,Y",   3, false, AbsoluteY  ) \
+    X(0x7C, NOP_Instr,   "NOP",         3, true,  AbsoluteX  ) \
+    X(0x7D, ADC_Instr,   "ADC abs,X",   3, true,  AbsoluteX  ) \
+    X(0x7E, ROR_Instr,   "ROR abs,X",   3, false, AbsoluteX  ) \
+    X(0x7F, RRA_Instr,   "RRA abs,X",   3, false, AbsoluteX  ) \
+    \
+    X(0x80, NOP_Instr,   "NOP",         2, false, Immediate  ) \
+    X(0x81, STA_Instr,   "STA (ind,X)", 2, false, IndirectX  ) \
+    X(0x82, NOP_Instr,   "NOP",         2, false, Immediate  ) \
+    X(0x83, SAX_Instr,   "SAX (ind,X)", 2, false, IndirectX  ) \
+    X(0x84, STY_Instr,   "STY zp",      2, false, ZeroPage   ) \
+    X(0x85, STA_Instr,   "STA zp",      2, false, ZeroPage   ) \
+    X(0x86, STX_Instr,   "STX zp",      2, false, ZeroPage   ) \
+    X(0x87, SAX_Instr,   "SAX zp",      2, false, ZeroPage   ) \
+    X(0x88, DEY_Instr,   "DEY",         1, false, Implied    ) \
+    X(0x89, NOP_Instr,   "NOP",         2, false, Immediate  ) \
+    X(0x8A, TXA_Instr,   "TXA",         1, false, Implied    ) \
+    X(0x8B, ANE_Instr,   "ANE",         2, false, Immediate  ) \
+    X(0x8C, STY_Instr,   "STY abs",     3, false, Absolute   ) \
+    X(0x8D, STA_Instr,   "STA abs",     3, false, Absolute   ) \
+    X(0x8E, STX_Instr,   "STX abs",     3, false, Absolute   ) \
+    X(0x8F, SAX_Instr,   "SAX abs",     3, false, Absolute   ) \
+    \
+    X(0x90, BCC_Instr,   "BCC rel",     2, true,  Relative   ) \
+    X(0x91, STA_Instr,   "STA (ind),Y", 2, false, IndirectY  ) \
+    X(0x92, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0x93, SHA_Instr,   "SHA (ind),Y", 2, false, IndirectY  ) \
+    X(0x94, STY_Instr,   "STY zp,X",    2, false, ZeroPageX  ) \
+    X(0x95, STA_Instr,   "STA zp,X",    2, false, ZeroPageX  ) \
+    X(0x96, STX_Instr,   "STX zp,Y",    2, false, ZeroPageY  ) \
+    X(0x97, SAX_Instr,   "SAX zp,Y",    2, false, ZeroPageY  ) \
+    X(0x98, TYA_Instr,   "TYA",         1, false, Implied    ) \
+    X(0x99, STA_Instr,   "STA abs,Y",   3, false, AbsoluteY  ) \
+    X(0x9A, TXS_Instr,   "TXS",         1, false, Implied    ) \
+    X(0x9B, SHS_Instr,   "SHS",         3, false, AbsoluteY  ) \
+    X(0x9C, SHY_Instr,   "SHY",         3, false, AbsoluteX  ) \
+    X(0x9D, STA_Instr,   "STA abs,X",   3, false, AbsoluteX  ) \
+    X(0x9E, SHX_Instr,   "SHX",         3, false, AbsoluteY  ) \
+    X(0x9F, SHA_Instr,   "SHA abs,Y",   3, false, AbsoluteY  ) \
+    \
+    X(0xA0, LDY_Instr,   "LDY #imm",    2, false, Immediate  ) \
+    X(0xA1, LDA_Instr,   "LDA (ind,X)", 2, false, IndirectX  ) \
+    X(0xA2, LDX_Instr,   "LDX #imm",    2, false, Immediate  ) \
+    X(0xA3, LAX_Instr,   "LAX (ind,X)", 2, false, IndirectX  ) \
+    X(0xA4, LDY_Instr,   "LDY zp",      2, false, ZeroPage   ) \
+    X(0xA5, LDA_Instr,   "LDA zp",      2, false, ZeroPage   ) \
+    X(0xA6, LDX_Instr,   "LDX zp",      2, false, ZeroPage   ) \
+    X(0xA7, LAX_Instr,   "LAX zp",      2, false, ZeroPage   ) \
+    X(0xA8, TAY_Instr,   "TAY",         1, false, Implied    ) \
+    X(0xA9, LDA_Instr,   "LDA #imm",    2, false, Immediate  ) \
+    X(0xAA, TAX_Instr,   "TAX",         1, false, Implied    ) \
+    X(0xAB, LXA_Instr,   "LXA",         2, false, Immediate  ) \
+    X(0xAC, LDY_Instr,   "LDY abs",     3, false, Absolute   ) \
+    X(0xAD, LDA_Instr,   "LDA abs",     3, false, Absolute   ) \
+    X(0xAE, LDX_Instr,   "LDX abs",     3, false, Absolute   ) \
+    X(0xAF, LAX_Instr,   "LAX abs",     3, false, Absolute   ) \
+    \
+    X(0xB0, BCS_Instr,   "BCS rel",     2, true,  Relative   ) \
+    X(0xB1, LDA_Instr,   "LDA (ind),Y", 2, true,  IndirectY  ) \
+    X(0xB2, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0xB3, LAX_Instr,   "LAX (ind),Y", 2, true,  IndirectY  ) \
+    X(0xB4, LDY_Instr,   "LDY zp,X",    2, false, ZeroPageX  ) \
+    X(0xB5, LDA_Instr,   "LDA zp,X",    2, false, ZeroPageX  ) \
+    X(0xB6, LDX_Instr,   "LDX zp,Y",    2, false, ZeroPageY  ) \
+    X(0xB7, LAX_Instr,   "LAX zp,Y",    2, false, ZeroPageY  ) \
+    X(0xB8, CLV_Instr,   "CLV",         1, false, Implied    ) \
+    X(0xB9, LDA_Instr,   "LDA abs,Y",   3, true,  AbsoluteY  ) \
+    X(0xBA, TSX_Instr,   "TSX",         1, false, Implied    ) \
+    X(0xBB, LAS_Instr,   "LAS",         3, true,  AbsoluteY  ) \
+    X(0xBC, LDY_Instr,   "LDY abs,X",   3, true,  AbsoluteX  ) \
+    X(0xBD, LDA_Instr,   "LDA abs,X",   3, true,  AbsoluteX  ) \
+    X(0xBE, LDX_Instr,   "LDX abs,Y",   3, true,  AbsoluteY  ) \
+    X(0xBF, LAX_Instr,   "LAX abs,Y",   3, true,  AbsoluteY  ) \
+    \
+    X(0xC0, CPY_Instr,   "CPY #imm",    2, false, Immediate  ) \
+    X(0xC1, CMP_Instr,   "CMP (ind,X)", 2, false, IndirectX  ) \
+    X(0xC2, NOP_Instr,   "NOP",         2, false, Immediate  ) \
+    X(0xC3, DCP_Instr,   "DCP (ind,X)", 2, false, IndirectX  ) \
+    X(0xC4, CPY_Instr,   "CPY zp",      2, false, ZeroPage   ) \
+    X(0xC5, CMP_Instr,   "CMP zp",      2, false, ZeroPage   ) \
+    X(0xC6, DEC_Instr,   "DEC zp",      2, false, ZeroPage   ) \
+    X(0xC7, DCP_Instr,   "DCP zp",      2, false, ZeroPage   ) \
+    X(0xC8, INY_Instr,   "INY",         1, false, Implied    ) \
+    X(0xC9, CMP_Instr,   "CMP #imm",    2, false, Immediate  ) \
+    X(0xCA, DEX_Instr,   "DEX",         1, false, Implied    ) \
+    X(0xCB, SBX_Instr,   "SBX",         2, false, Immediate  ) \
+    X(0xCC, CPY_Instr,   "CPY abs",     3, false, Absolute   ) \
+    X(0xCD, CMP_Instr,   "CMP abs",     3, false, Absolute   ) \
+    X(0xCE, DEC_Instr,   "DEC abs",     3, false, Absolute   ) \
+    X(0xCF, DCP_Instr,   "DCP abs",     3, false, Absolute   ) \
+    \
+    X(0xD0, BNE_Instr,   "BNE rel",     2, true,  Relative   ) \
+    X(0xD1, CMP_Instr,   "CMP (ind),Y", 2, true,  IndirectY  ) \
+    X(0xD2, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0xD3, DCP_Instr,   "DCP (ind),Y", 2, false, IndirectY  ) \
+    X(0xD4, NOP_Instr,   "NOP",         2, false, ZeroPageX  ) \
+    X(0xD5, CMP_Instr,   "CMP zp,X",    2, false, ZeroPageX  ) \
+    X(0xD6, DEC_Instr,   "DEC zp,X",    2, false, ZeroPageX  ) \
+    X(0xD7, DCP_Instr,   "DCP zp,X",    2, false, ZeroPageX  ) \
+    X(0xD8, CLD_Instr,   "CLD",         1, false, Implied    ) \
+    X(0xD9, CMP_Instr,   "CMP abs,Y",   3, true,  AbsoluteY  ) \
+    X(0xDA, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0xDB, DCP_Instr,   "DCP abs,Y",   3, false, AbsoluteY  ) \
+    X(0xDC, NOP_Instr,   "NOP",         3, true,  AbsoluteX  ) \
+    X(0xDD, CMP_Instr,   "CMP abs,X",   3, true,  AbsoluteX  ) \
+    X(0xDE, DEC_Instr,   "DEC abs,X",   3, false, AbsoluteX  ) \
+    X(0xDF, DCP_Instr,   "DCP abs,X",   3, false, AbsoluteX  ) \
+    \
+    X(0xE0, CPX_Instr,   "CPX #imm",    2, false, Immediate  ) \
+    X(0xE1, SBC_Instr,   "SBC (ind,X)", 2, false, IndirectX  ) \
+    X(0xE2, NOP_Instr,   "NOP #imm",    2, false, Immediate  ) \
+    X(0xE3, ISC_Instr,   "ISC (ind,X)", 2, false, IndirectX  ) \
+    X(0xE4, CPX_Instr,   "CPX zp",      2, false, ZeroPage   ) \
+    X(0xE5, SBC_Instr,   "SBC zp",      2, false, ZeroPage   ) \
+    X(0xE6, INC_Instr,   "INC zp",      2, false, ZeroPage   ) \
+    X(0xE7, ISC_Instr,   "ISC zp",      2, false, ZeroPage   ) \
+    X(0xE8, INX_Instr,   "INX",         1, false, Implied    ) \
+    X(0xE9, SBC_Instr,   "SBC #imm",    2, false, Immediate  ) \
+    X(0xEA, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0xEB, SBC_Instr,   "SBC #imm",    2, false, Immediate  ) \
+    X(0xEC, CPX_Instr,   "CPX abs",     3, false, Absolute   ) \
+    X(0xED, SBC_Instr,   "SBC abs",     3, false, Absolute   ) \
+    X(0xEE, INC_Instr,   "INC abs",     3, false, Absolute   ) \
+    X(0xEF, ISC_Instr,   "ISC abs",     3, false, Absolute   ) \
+    \
+    X(0xF0, BEQ_Instr,   "BEQ rel",     2, true,  Relative   ) \
+    X(0xF1, SBC_Instr,   "SBC (ind),Y", 2, true,  IndirectY  ) \
+    X(0xF2, JAM_Instr,   "JAM",         1, false, Implied    ) \
+    X(0xF3, ISC_Instr,   "ISC (ind),Y", 2, false, IndirectY  ) \
+    X(0xF4, NOP_Instr,   "NOP zp,X",    2, false, ZeroPageX  ) \
+    X(0xF5, SBC_Instr,   "SBC zp,X",    2, false, ZeroPageX  ) \
+    X(0xF6, INC_Instr,   "INC zp,X",    2, false, ZeroPageX  ) \
+    X(0xF7, ISC_Instr,   "ISC zp,X",    2, false, ZeroPageX  ) \
+    X(0xF8, SED_Instr,   "SED",         1, false, Implied    ) \
+    X(0xF9, SBC_Instr,   "SBC abs,Y",   3, true,  AbsoluteY  ) \
+    X(0xFA, NOP_Instr,   "NOP",         1, false, Implied    ) \
+    X(0xFB, ISC_Instr,   "ISC abs,Y",   3, false, AbsoluteY  ) \
+    X(0xFC, NOP_Instr,   "NOP abs,X",   3, true,  AbsoluteX  ) \
+    X(0xFD, SBC_Instr,   "SBC abs,X",   3, true,  AbsoluteX  ) \
+    X(0xFE, INC_Instr,   "INC abs,X",   3, false, AbsoluteX  ) \
+    X(0xFF, ISC_Instr,   "ISC abs,X",   3, false, AbsoluteX  )
+
+// One handler per opcode with the addressing mode and page cross penalty baked in,
+// the arguments are only kept so they match InstrFn
+#define CPU_OPCODE_HANDLER(code, fn, name, bytes, penalty, mode) \
+static void fn##_##code(Cpu *cpu, AddressingMode addr_mode, bool page_cycle) \
+{ \
+    UNUSED(addr_mode); \
+    UNUSED(page_cycle); \
+    fn(cpu, mode, penalty); \
+}
+
+CPU_OPCODE_LIST(CPU_OPCODE_HANDLER)
+
+#define CPU_OPCODE_ENTRY(code, fn, name, bytes, penalty, mode) [code] = { fn##_##code, name, bytes, penalty, mode },
 static const OpcodeHandler opcodes[256] =
 {
-    [0x00] = { BRK_Instr,   "BRK",         1, false, Implied     },
-    [0x01] = { ORA_Instr,   "ORA (ind,X)", 2, false, IndirectX   },
-    [0x02] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x03] = { SLO_Instr,   "SLO (ind,X)", 2, false, IndirectX   },
-    [0x04] = { NOP_Instr,   "NOP",         2, false, ZeroPage    },
-    [0x05] = { ORA_Instr,   "ORA zp",      2, false, ZeroPage    },
-    [0x06] = { ASL_Instr,   "ASL zp",      2, false, ZeroPage    },
-    [0x07] = { SLO_Instr,   "SLO zp",      2, false, ZeroPage    },
-    [0x08] = { PHP_Instr,   "PHP",         1, false, Implied     },
-    [0x09] = { ORA_Instr,   "ORA #imm",    2, false, Immediate   },
-    [0x0A] = { ASL_A_Instr, "ASL A",       1, false, Accumulator },
-    [0x0B] = { ANC_Instr,   "ANC #imm",    2, false, Immediate   },
-    [0x0C] = { NOP_Instr,   "NOP",         3, false, Absolute    },
-    [0x0D] = { ORA_Instr,   "ORA abs",     3, false, Absolute    },
-    [0x0E] = { ASL_Instr,   "ASL abs",     3, false, Absolute    },
-    [0x0F] = { SLO_Instr,   "SLO abs",     3, false, Absolute    },
-
-    [0x10] = { BPL_Instr,   "BPL rel",     2, true,  Relative    },
-    [0x11] = { ORA_Instr,   "ORA (ind),Y", 2, true,  IndirectY   },
-    [0x12] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x13] = { SLO_Instr,   "SLO (ind),Y", 2, false, IndirectY   },
-    [0x14] = { NOP_Instr,   "NOP zp,X",    2, false, ZeroPageX   },
-    [0x15] = { ORA_Instr,   "ORA zp,X",    2, false, ZeroPageX   },
-    [0x16] = { ASL_Instr,   "ASL zp,X",    2, false, ZeroPageX   },
-    [0x17] = { SLO_Instr,   "SLO zp,X",    2, false, ZeroPageX   },
-    [0x18] = { CLC_Instr,   "CLC",         1, false, Implied     },
-    [0x19] = { ORA_Instr,   "ORA abs,Y",   3, true,  AbsoluteY   },
-    [0x1A] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0x1B] = { SLO_Instr,   "SLO abs,Y",   3, false, AbsoluteY   },
-    [0x1C] = { NOP_Instr,   "NOP abs,X",   3, true,  AbsoluteX   },
-    [0x1D] = { ORA_Instr,   "ORA abs,X",   3, true,  AbsoluteX   },
-    [0x1E] = { ASL_Instr,   "ASL abs,X",   3, false, AbsoluteX   },
-    [0x1F] = { SLO_Instr,   "SLO abs,X",   3, false, AbsoluteX   },
-
-    [0x20] = { JSR_Instr,   "JSR abs",     3, false, Absolute    },
-    [0x21] = { AND_Instr,   "AND (ind,X)", 2, false, IndirectX   },
-    [0x22] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x23] = { RLA_Instr,   "RLA (ind,X)", 2, false, IndirectX   },
-    [0x24] = { BIT_Instr,   "BIT zp",      2, false, ZeroPage    },
-    [0x25] = { AND_Instr,   "AND zp",      2, false, ZeroPage    },
-    [0x26] = { ROL_Instr,   "ROL zp",      2, false, ZeroPage    },
-    [0x27] = { RLA_Instr,   "RLA zp",      2, false, ZeroPage    },
-    [0x28] = { PLP_Instr,   "PLP",         1, false, Implied     },
-    [0x29] = { AND_Instr,   "AND #imm",    2, false, Immediate   },
-    [0x2A] = { ROL_A_Instr, "ROL A",       1, false, Accumulator },
-    [0x2B] = { ANC_Instr,   "ANC2 #imm",   2, false, Immediate   },
-    [0x2C] = { BIT_Instr,   "BIT abs",     3, false, Absolute    },
-    [0x2D] = { AND_Instr,   "AND abs",     3, false, Absolute    },
-    [0x2E] = { ROL_Instr,   "ROL abs",     3, false, Absolute    },
-    [0x2F] = { RLA_Instr,   "RLA abs",     3, false, Absolute    },
-
-    [0x30] = { BMI_Instr,   "BMI rel",     2, true,  Relative    },
-    [0x32] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x31] = { AND_Instr,   "AND (ind),Y", 2, true,  IndirectY   },
-    [0x33] = { RLA_Instr,   "RLA (ind),Y", 2, false, IndirectY   },
-    [0x34] = { NOP_Instr,   "NOP",         2, false, ZeroPageX   },
-    [0x35] = { AND_Instr,   "AND zp,X",    2, false, ZeroPageX   },
-    [0x36] = { ROL_Instr,   "ROL zp,X",    2, false, ZeroPageX   },
-    [0x37] = { RLA_Instr,   "RLA zp,X",    2, false, ZeroPageX   },
-    [0x38] = { SEC_Instr,   "SEC",         1, false, Implied     },
-    [0x39] = { AND_Instr,   "AND abs,Y",   3, true,  AbsoluteY   },
-    [0x3A] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0x3B] = { RLA_Instr,   "RLA abs,Y",   3, false, AbsoluteY   },
-    [0x3C] = { NOP_Instr,   "NOP",         3, true,  AbsoluteX   },
-    [0x3D] = { AND_Instr,   "AND abs,X",   3, true,  AbsoluteX   },
-    [0x3E] = { ROL_Instr,   "ROL abs,X",   3, false, AbsoluteX   },
-    [0x3F] = { RLA_Instr,   "RLA abs,X",   3, false, AbsoluteX   },
-
-    [0x40] = { RTI_Instr,   "RTI",         1, false, Implied     },
-    [0x41] = { EOR_Instr,   "EOR (ind,X)", 2, false, IndirectX   },
-    [0x42] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x43] = { SRE_Instr,   "SRE (ind,X)", 2, false, IndirectX   },
-    [0x44] = { NOP_Instr,   "NOP",         2, false, ZeroPage    },
-    [0x45] = { EOR_Instr,   "EOR zp",      2, false, ZeroPage    },
-    [0x46] = { LSR_Instr,   "LSR zp",      2, false, ZeroPage    },
-    [0x47] = { SRE_Instr,   "SRE zp",      2, false, ZeroPage    },
-    [0x48] = { PHA_Instr,   "PHA",         1, false, Implied     },
-    [0x49] = { EOR_Instr,   "EOR #imm",    2, false, Immediate   },
-    [0x4A] = { LSR_A_Instr, "LSR A",       1, false, Accumulator },
-    [0x4B] = { ASR_Instr,   "ASR",         2, false, Immediate   },
-    [0x4C] = { JMP_Instr,   "JMP abs",     3, false, Absolute    },
-    [0x4D] = { EOR_Instr,   "EOR abs",     3, false, Absolute    },
-    [0x4E] = { LSR_Instr,   "LSR abs",     3, false, Absolute    },
-    [0x4F] = { SRE_Instr,   "SRE abs",     3, false, Absolute    },
-
-    [0x50] = { BVC_Instr,   "BVC rel",     2, true,  Relative    },
-    [0x51] = { EOR_Instr,   "EOR (ind),Y", 2, true,  IndirectY   },
-    [0x52] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x53] = { SRE_Instr,   "SRE (ind),Y", 2, false, IndirectY   },
-    [0x54] = { NOP_Instr,   "NOP",         2, false, ZeroPageX   },
-    [0x55] = { EOR_Instr,   "EOR zp,X",    2, false, ZeroPageX   },
-    [0x56] = { LSR_Instr,   "LSR zp,X",    2, false, ZeroPageX   },
-    [0x57] = { SRE_Instr,   "SRE zp,X",    2, false, ZeroPageX   },
-    [0x58] = { CLI_Instr,   "CLI",         1, false, Implied     },
-    [0x59] = { EOR_Instr,   "EOR abs,Y",   3, true,  AbsoluteY   },
-    [0x5A] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0x5B] = { SRE_Instr,   "SRE abs,Y",   3, false, AbsoluteY   },
-    [0x5C] = { NOP_Instr,   "NOP",         3, true,  AbsoluteX   },
-    [0x5D] = { EOR_Instr,   "EOR abs,X",   3, true,  AbsoluteX   },
-    [0x5E] = { LSR_Instr,   "LSR abs,X",   3, false, AbsoluteX   },
-    [0x5F] = { SRE_Instr,   "SRE abs,X",   3, false, AbsoluteX   },
-
-    [0x60] = { RTS_Instr,   "RTS",         1, false, Implied     },
-    [0x61] = { ADC_Instr,   "ADC (ind,X)", 2, false, IndirectX   },
-    [0x62] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x63] = { RRA_Instr,   "RRA (ind,X)", 2, false, IndirectX   },
-    [0x64] = { NOP_Instr,   "NOP",         2, false, ZeroPage    },
-    [0x65] = { ADC_Instr,   "ADC zp",      2, false, ZeroPage    },
-    [0x66] = { ROR_Instr,   "ROR zp",      2, false, ZeroPage    },
-    [0x67] = { RRA_Instr,   "RRA zp",      2, false, ZeroPage    },
-    [0x68] = { PLA_Instr,   "PLA",         1, false, Implied     },
-    [0x69] = { ADC_Instr,   "ADC #imm",    2, false, Immediate   },
-    [0x6A] = { ROR_A_Instr, "ROR A",       1, false, Accumulator },
-    [0x6B] = { ARR_Instr,   "ARR",         2, false, Immediate   },
-    [0x6C] = { JMP_Instr,   "JMP (ind)",   3, false, Indirect    },
-    [0x6D] = { ADC_Instr,   "ADC abs",     3, false, Absolute    },
-    [0x6E] = { ROR_Instr,   "ROR abs",     3, false, Absolute    },
-    [0x6F] = { RRA_Instr,   "RRA abs",     3, false, Absolute    },
-
-    [0x70] = { BVS_Instr,   "BVS rel",     2, true,  Relative    },
-    [0x71] = { ADC_Instr,   "ADC (ind),Y", 2, true,  IndirectY   },
-    [0x72] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x73] = { RRA_Instr,   "RRA (ind),Y", 2, false, IndirectY   },
-    [0x74] = { NOP_Instr,   "NOP",         2, false, ZeroPageX   },
-    [0x75] = { ADC_Instr,   "ADC zp,X",    2, false, ZeroPageX   },
-    [0x76] = { ROR_Instr,   "ROR zp,X",    2, false, ZeroPageX   },
-    [0x77] = { RRA_Instr,   "RRA zp,X",    2, false, ZeroPageX   },
-    [0x78] = { SEI_Instr,   "SEI",         1, false, Implied     },
-    [0x79] = { ADC_Instr,   "ADC abs,Y",   3, true,  AbsoluteY   },
-    [0x7A] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0x7B] = { RRA_Instr,   "RRA abs,Y",   3, false, AbsoluteY   },
-    [0x7C] = { NOP_Instr,   "NOP",         3, true,  AbsoluteX   },
-    [0x7D] = { ADC_Instr,   "ADC abs,X",   3, true,  AbsoluteX   },
-    [0x7E] = { ROR_Instr,   "ROR abs,X",   3, false, AbsoluteX   },
-    [0x7F] = { RRA_Instr,   "RRA abs,X",   3, false, AbsoluteX   },
-
-    [0x80] = { NOP_Instr,   "NOP",         2, false, Immediate   },
-    [0x81] = { STA_Instr,   "STA (ind,X)", 2, false, IndirectX   },
-    [0x82] = { NOP_Instr,   "NOP",         2, false, Immediate   },
-    [0x83] = { SAX_Instr,   "SAX (ind,X)", 2, false, IndirectX   },
-    [0x84] = { STY_Instr,   "STY zp",      2, false, ZeroPage    },
-    [0x85] = { STA_Instr,   "STA zp",      2, false, ZeroPage    },
-    [0x86] = { STX_Instr,   "STX zp",      2, false, ZeroPage    },
-    [0x87] = { SAX_Instr,   "SAX zp",      2, false, ZeroPage    },
-    [0x88] = { DEY_Instr,   "DEY",         1, false, Implied     },
-    [0x89] = { NOP_Instr,   "NOP",         2, false, Immediate   },
-    [0x8A] = { TXA_Instr,   "TXA",         1, false, Implied     },
-    [0x8B] = { ANE_Instr,   "ANE",         2, false, Immediate   },
-    [0x8C] = { STY_Instr,   "STY abs",     3, false, Absolute    },
-    [0x8D] = { STA_Instr,   "STA abs",     3, false, Absolute    },
-    [0x8E] = { STX_Instr,   "STX abs",     3, false, Absolute    },
-    [0x8F] = { SAX_Instr,   "SAX abs",     3, false, Absolute    },
-
-    [0x90] = { BCC_Instr,   "BCC rel",     2, true,  Relative    },
-    [0x91] = { STA_Instr,   "STA (ind),Y", 2, false, IndirectY   },
-    [0x92] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0x93] = { SHA_Instr,   "SHA (ind),Y", 2, false, IndirectY   },
-    [0x94] = { STY_Instr,   "STY zp,X",    2, false, ZeroPageX   },
-    [0x95] = { STA_Instr,   "STA zp,X",    2, false, ZeroPageX   },
-    [0x96] = { STX_Instr,   "STX zp,Y",    2, false, ZeroPageY   },
-    [0x97] = { SAX_Instr,   "SAX zp,Y",    2, false, ZeroPageY   },
-    [0x98] = { TYA_Instr,   "TYA",         1, false, Implied     },
-    [0x99] = { STA_Instr,   "STA abs,Y",   3, false, AbsoluteY   },
-    [0x9A] = { TXS_Instr,   "TXS",         1, false, Implied     },
-    [0x9B] = { SHS_Instr,   "SHS",         3, false, AbsoluteY   },
-    [0x9C] = { SHY_Instr,   "SHY",         3, false, AbsoluteX   },
-    [0x9D] = { STA_Instr,   "STA abs,X",   3, false, AbsoluteX   },
-    [0x9E] = { SHX_Instr,   "SHX",         3, false, AbsoluteY   },
-    [0x9F] = { SHA_Instr,   "SHA abs,Y",   3, false, AbsoluteY   },
-
-    [0xA0] = { LDY_Instr,   "LDY #imm",    2, false, Immediate   },
-    [0xA1] = { LDA_Instr,   "LDA (ind,X)", 2, false, IndirectX   },
-    [0xA2] = { LDX_Instr,   "LDX #imm",    2, false, Immediate   },
-    [0xA3] = { LAX_Instr,   "LAX (ind,X)", 2, false, IndirectX   },
-    [0xA4] = { LDY_Instr,   "LDY zp",      2, false, ZeroPage    },
-    [0xA5] = { LDA_Instr,   "LDA zp",      2, false, ZeroPage    },
-    [0xA6] = { LDX_Instr,   "LDX zp",      2, false, ZeroPage    },
-    [0xA7] = { LAX_Instr,   "LAX zp",      2, false, ZeroPage    },
-    [0xA8] = { TAY_Instr,   "TAY",         1, false, Implied     },
-    [0xA9] = { LDA_Instr,   "LDA #imm",    2, false, Immediate   },
-    [0xAA] = { TAX_Instr,   "TAX",         1, false, Implied     },
-    [0xAB] = { LXA_Instr,   "LXA",         2, false, Immediate   },
-    [0xAC] = { LDY_Instr,   "LDY abs",     3, false, Absolute    },
-    [0xAD] = { LDA_Instr,   "LDA abs",     3, false, Absolute    },
-    [0xAE] = { LDX_Instr,   "LDX abs",     3, false, Absolute    },
-    [0xAF] = { LAX_Instr,   "LAX abs",     3, false, Absolute    },
-
-    [0xB0] = { BCS_Instr,   "BCS rel",     2, true,  Relative    },
-    [0xB1] = { LDA_Instr,   "LDA (ind),Y", 2, true,  IndirectY   },
-    [0xB2] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0xB3] = { LAX_Instr,   "LAX (ind),Y", 2, true,  IndirectY   },
-    [0xB4] = { LDY_Instr,   "LDY zp,X",    2, false, ZeroPageX   },
-    [0xB5] = { LDA_Instr,   "LDA zp,X",    2, false, ZeroPageX   },
-    [0xB6] = { LDX_Instr,   "LDX zp,Y",    2, false, ZeroPageY   },
-    [0xB7] = { LAX_Instr,   "LAX zp,Y",    2, false, ZeroPageY   },
-    [0xB8] = { CLV_Instr,   "CLV",         1, false, Implied     },
-    [0xB9] = { LDA_Instr,   "LDA abs,Y",   3, true,  AbsoluteY   },
-    [0xBA] = { TSX_Instr,   "TSX",         1, false, Implied     },
-    [0xBB] = { LAS_Instr,   "LAS",         3, true,  AbsoluteY   },
-    [0xBC] = { LDY_Instr,   "LDY abs,X",   3, true,  AbsoluteX   },
-    [0xBD] = { LDA_Instr,   "LDA abs,X",   3, true,  AbsoluteX   },
-    [0xBE] = { LDX_Instr,   "LDX abs,Y",   3, true,  AbsoluteY   },
-    [0xBF] = { LAX_Instr,   "LAX abs,Y",   3, true,  AbsoluteY   },
-
-    [0xC0] = { CPY_Instr,   "CPY #imm",    2, false, Immediate   },
-    [0xC1] = { CMP_Instr,   "CMP (ind,X)", 2, false, IndirectX   },
-    [0xC2] = { NOP_Instr,   "NOP",         2, false, Immediate   },
-    [0xC3] = { DCP_Instr,   "DCP (ind,X)", 2, false, IndirectX   },
-    [0xC4] = { CPY_Instr,   "CPY zp",      2, false, ZeroPage    },
-    [0xC5] = { CMP_Instr,   "CMP zp",      2, false, ZeroPage    },
-    [0xC6] = { DEC_Instr,   "DEC zp",      2, false, ZeroPage    },
-    [0xC7] = { DCP_Instr,   "DCP zp",      2, false, ZeroPage    },
-    [0xC8] = { INY_Instr,   "INY",         1, false, Implied     },
-    [0xC9] = { CMP_Instr,   "CMP #imm",    2, false, Immediate   },
-    [0xCA] = { DEX_Instr,   "DEX",         1, false, Implied     },
-    [0xCB] = { SBX_Instr,   "SBX",         2, false, Immediate   },
-    [0xCC] = { CPY_Instr,   "CPY abs",     3, false, Absolute    },
-    [0xCD] = { CMP_Instr,   "CMP abs",     3, false, Absolute    },
-    [0xCE] = { DEC_Instr,   "DEC abs",     3, false, Absolute    },
-    [0xCF] = { DCP_Instr,   "DCP abs",     3, false, Absolute    },
-
-    [0xD0] = { BNE_Instr,   "BNE rel",     2, true,  Relative    },
-    [0xD1] = { CMP_Instr,   "CMP (ind),Y", 2, true,  IndirectY   },
-    [0xD2] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0xD3] = { DCP_Instr,   "DCP (ind),Y", 2, false, IndirectY   },
-    [0xD4] = { NOP_Instr,   "NOP",         2, false, ZeroPageX   },
-    [0xD5] = { CMP_Instr,   "CMP zp,X",    2, false, ZeroPageX   },
-    [0xD6] = { DEC_Instr,   "DEC zp,X",    2, false, ZeroPageX   },
-    [0xD7] = { DCP_Instr,   "DCP zp,X",    2, false, ZeroPageX   },
-    [0xD8] = { CLD_Instr,   "CLD",         1, false, Implied     },
-    [0xD9] = { CMP_Instr,   "CMP abs,Y",   3, true,  AbsoluteY   },
-    [0xDA] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0xDB] = { DCP_Instr,   "DCP abs,Y",   3, false, AbsoluteY   },
-    [0xDC] = { NOP_Instr,   "NOP",         3, true,  AbsoluteX   },
-    [0xDD] = { CMP_Instr,   "CMP abs,X",   3, true,  AbsoluteX   },
-    [0xDE] = { DEC_Instr,   "DEC abs,X",   3, false, AbsoluteX   },
-    [0xDF] = { DCP_Instr,   "DCP abs,X",   3, false, AbsoluteX   },
-
-    [0xE0] = { CPX_Instr,   "CPX #imm",    2, false, Immediate   },
-    [0xE1] = { SBC_Instr,   "SBC (ind,X)", 2, false, IndirectX   },
-    [0xE2] = { NOP_Instr,   "NOP #imm",    2, false, Immediate   },
-    [0xE3] = { ISC_Instr,   "ISC (ind,X)", 2, false, IndirectX   },
-    [0xE4] = { CPX_Instr,   "CPX zp",      2, false, ZeroPage    },
-    [0xE5] = { SBC_Instr,   "SBC zp",      2, false, ZeroPage    },
-    [0xE6] = { INC_Instr,   "INC zp",      2, false, ZeroPage    },
-    [0xE7] = { ISC_Instr,   "ISC zp",      2, false, ZeroPage    },
-    [0xE8] = { INX_Instr,   "INX",         1, false, Implied     },
-    [0xE9] = { SBC_Instr,   "SBC #imm",    2, false, Immediate   },
-    [0xEA] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0xEB] = { SBC_Instr,   "SBC #imm",    2, false, Immediate   },
-    [0xEC] = { CPX_Instr,   "CPX abs",     3, false, Absolute    },
-    [0xED] = { SBC_Instr,   "SBC abs",     3, false, Absolute    },
-    [0xEE] = { INC_Instr,   "INC abs",     3, false, Absolute    },
-    [0xEF] = { ISC_Instr,   "ISC abs",     3, false, Absolute    },
-
-    [0xF0] = { BEQ_Instr,   "BEQ rel",     2, true,  Relative    },
-    [0xF1] = { SBC_Instr,   "SBC (ind),Y", 2, true,  IndirectY   },
-    [0xF2] = { JAM_Instr,   "JAM",         1, false, Implied     },
-    [0xF3] = { ISC_Instr,   "ISC (ind),Y", 2, false, IndirectY   },
-    [0xF4] = { NOP_Instr,   "NOP zp,X",    2, false, ZeroPageX   },
-    [0xF5] = { SBC_Instr,   "SBC zp,X",    2, false, ZeroPageX   },
-    [0xF6] = { INC_Instr,   "INC zp,X",    2, false, ZeroPageX   },
-    [0xF7] = { ISC_Instr,   "ISC zp,X",    2, false, ZeroPageX   },
-    [0xF8] = { SED_Instr,   "SED",         1, false, Implied     },
-    [0xF9] = { SBC_Instr,   "SBC abs,Y",   3, true,  AbsoluteY   },
-    [0xFA] = { NOP_Instr,   "NOP",         1, false, Implied     },
-    [0xFB] = { ISC_Instr,   "ISC abs,Y",   3, false, AbsoluteY   },
-    [0xFC] = { NOP_Instr,   "NOP abs,X",   3, true,  AbsoluteX   },
-    [0xFD] = { SBC_Instr,   "SBC abs,X",   3, true,  AbsoluteX   },
-    [0xFE] = { INC_Instr,   "INC abs,X",   3, false, AbsoluteX   },
-    [0xFF] = { ISC_Instr,   "ISC abs,X",   3, false, AbsoluteX   },
+    CPU_OPCODE_LIST(CPU_OPCODE_ENTRY)
 };
 
-void CPU_Init(Cpu *cpu)
+void CPU_Init(Cpu *cpu, struct System *system)
 {
     memset(cpu, 0, sizeof(*cpu));
+    cpu->system = system;
+    // All flags start cleared, the lazy z flag is only clear when its source is non zero
+    CPU_SetStatus(cpu, 0);
     CPU_Reset(cpu);
 }
 
 void CPU_ExecuteInstr(Cpu *cpu, bool debug_info)
 {
-    const uint8_t opcode = CpuRead8(cpu->pc);
+    cpu->idle_skip = false;
+
+    const uint8_t opcode = CpuRead8(cpu, cpu->pc);
     const OpcodeHandler *handler = &opcodes[opcode];
 
     if (handler->InstrFn)
@@ -1920,34 +2029,158 @@ void CPU_ExecuteInstr(Cpu *cpu, bool debug_info)
 
         // Execute instruction
         handler->InstrFn(cpu, handler->addr_mode, handler->page_cross_penalty);
+        ++cpu->instructions;
     }
     else
     {
         printf("\nUnhandled opcode: 0x%02X at PC: 0x%04X\n", opcode, cpu->pc);
-        printf("A: 0x%X\nX: 0x%X\nY: 0x%X\nSP: 0x%X\nSR: 0x%X\n", cpu->a, cpu->x, cpu->y, cpu->sp, cpu->status.raw);
+        printf("A: 0x%X\nX: 0x%X\nY: 0x%X\nSP: 0x%X\nSR: 0x%X\n", cpu->a, cpu->x, cpu->y, cpu->sp, CPU_GetStatus(cpu));
         printf("Cycles done: %lu\n", cpu->cycles);
         exit(EXIT_FAILURE);
     }
 }
 
+const OpcodeHandler *CPU_GetOpcode(const uint8_t opcode)
+{
+    return &opcodes[opcode];
+}
+
+// Same as CPU_Run, except prg rom code that's been run enough goes through the jit's blocks.
+// Blocks only start where control flow lands or where the last one was cut off, so without
+// one the interpreter runs up to the next jump (or a block's worth) before asking again
+static void CpuRunJit(Cpu *cpu)
+{
+    const Ppu *ppu = cpu->system->ppu;
+
+    do {
+        if (JIT_Run(cpu->jit, cpu))
+            continue;
+
+        for (int i = 0; i < JIT_MAX_BLOCK_INSTRS && !ppu->frame_finished; i++)
+        {
+            const OpcodeHandler *handler = &opcodes[CpuRead8(cpu, cpu->pc)];
+            const uint16_t pc = cpu->pc;
+            const uint16_t next_pc = pc + handler->bytes;
+            handler->InstrFn(cpu, handler->addr_mode, handler->page_cross_penalty);
+            ++cpu->instructions;
+
+            // Blocks stay in one page, so one can start where the code runs onto the next
+            if (cpu->pc != next_pc || (pc ^ next_pc) & 0xFF00)
+                break;
+        }
+    } while (!ppu->frame_finished);
+}
+
+// Computed goto is a gcc/clang extension, build with DISABLE_COMPUTED_GOTO to use the switch instead
+#if defined(__GNUC__) && !defined(DISABLE_COMPUTED_GOTO)
+#define CPU_COMPUTED_GOTO
+#endif
+
+#ifdef CPU_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+// Runs instructions until the ppu finishes the frame. Every opcode gets its own copy of the
+// dispatch with the addressing mode and page cross penalty as constants, so the indirect
+// branch at the end of each one is predicted on its own instead of sharing a single call site
+void CPU_Run(Cpu *cpu)
+{
+    const Ppu *ppu = cpu->system->ppu;
+    cpu->idle_skip = cpu->system->skip_idle_loops;
+
+    if (cpu->jit)
+    {
+        CpuRunJit(cpu);
+        return;
+    }
+
+#ifdef CPU_COMPUTED_GOTO
+#define CPU_OPCODE_LABEL(code, fn, name, bytes, penalty, mode) [code] = &&op_##code,
+    static const void *const dispatch[256] =
+    {
+        CPU_OPCODE_LIST(CPU_OPCODE_LABEL)
+    };
+
+#define CPU_OPCODE_CASE(code, fn, name, bytes, penalty, mode) \
+op_##code: \
+    fn##_##code(cpu, mode, penalty); \
+    ++cpu->instructions; \
+    if (ppu->frame_finished) \
+        return; \
+    goto *dispatch[CpuRead8(cpu, cpu->pc)];
+
+    goto *dispatch[CpuRead8(cpu, cpu->pc)];
+    CPU_OPCODE_LIST(CPU_OPCODE_CASE)
+#else
+#define CPU_OPCODE_CASE(code, fn, name, bytes, penalty, mode) \
+    case code: \
+        fn##_##code(cpu, mode, penalty); \
+        break;
+
+    do {
+        switch (CpuRead8(cpu, cpu->pc))
+        {
+            CPU_OPCODE_LIST(CPU_OPCODE_CASE)
+        }
+        ++cpu->instructions;
+    } while (!ppu->frame_finished);
+#endif
+}
+
+#ifdef CPU_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+uint8_t CPU_GetStatus(const Cpu *cpu)
+{
+#ifdef CPU_LAZY_FLAGS
+    // i, d, b and the unused bit are still kept in status
+    return (cpu->status.raw & 0x3C) | (cpu->n_result & 0x80) | cpu->v_result << 6 |
+           !cpu->z_result << 1 | cpu->c_result;
+#else
+    return cpu->status.raw;
+#endif
+}
+
+// Loads every flag but b and the unused bit, like PLP and RTI
+void CPU_SetStatus(Cpu *cpu, uint8_t status)
+{
+#ifdef CPU_LAZY_FLAGS
+    cpu->status.raw = (cpu->status.raw & 0x30) | (status & 0x0C);
+    cpu->n_result = status;
+    cpu->z_result = !(status & 0x02);
+    cpu->c_result = status & 1;
+    cpu->v_result = (status >> 6) & 1;
+#else
+    Flags flags = {.raw = status};
+    cpu->status.c = flags.c;
+    cpu->status.d = flags.d;
+    cpu->status.i = flags.i;
+    cpu->status.n = flags.n;
+    cpu->status.v = flags.v;
+    cpu->status.z = flags.z;
+#endif
+}
+
 void CPU_Reset(Cpu *cpu)
 {
     cpu->cycles = -1;
     cpu->pc = 0xFF;
     // Dummy read
-    CpuRead8(cpu->pc);
+    CpuRead8(cpu, cpu->pc);
     // Dummy read
-    CpuRead8(cpu->pc);
+    CpuRead8(cpu, cpu->pc);
     // Another dummy read
-    CpuRead8(cpu->pc);
+    CpuRead8(cpu, cpu->pc);
     // Stack pointer is decremented by 3 via 3 fake pushes
-    CpuRead8(STACK_START + cpu->sp--);
-    CpuRead8(STACK_START + cpu->sp--);
-    CpuRead8(STACK_START + cpu->sp--);
+    CpuRead8(cpu, STACK_START + cpu->sp--);
+    CpuRead8(cpu, STACK_START + cpu->sp--);
+    CpuRead8(cpu, STACK_START + cpu->sp--);
     // Set interrupt disable flag (I) to prevent IRQs immediately after reset
     cpu->status.i = 1;
     // Read the reset vector from 0xFFFC (little-endian)
-    uint16_t reset_vector = CpuReadVector(RESET_VECTOR); 
+    uint16_t reset_vector = CpuReadVector(cpu, RESET_VECTOR); 
     
     printf("CPU Reset: Loading reset vector PC: 0x%04X\n", reset_vector);
 
@@ -1,6 +1,8 @@
 #ifndef CPU_H
 #define CPU_H
 
+//#define CPU_LAZY_FLAGS
+
 typedef enum
 {
     Accumulator,
@@ -50,17 +52,34 @@ typedef union
 
 typedef struct
 {
+    struct System *system;
     char debug_msg[128];
     int64_t cycles;
+    uint64_t instructions;
     uint16_t pc;
     uint8_t a;
     uint8_t x;
     uint8_t y;
     uint8_t sp;
     Flags status;
+#ifdef CPU_LAZY_FLAGS
+    // The n, z, c and v flags are kept as the values they were last set from,
+    // status only holds i and d until CPU_GetStatus packs everything together
+    uint8_t n_result;
+    uint8_t z_result;
+    uint8_t c_result;
+    uint8_t v_result;
+#endif
     uint8_t nmi_pin;
     bool nmi_pending;
     bool irq_pending;
+    // Only CPU_Run skips idle loops, stepping through them one instruction at a time still works
+    bool idle_skip;
+    // Jump back of the last loop checked for being idle and the cycle it was taken on
+    uint16_t idle_loop_pc;
+    uint64_t idle_loop_cycle;
+    // Set when CPU_Run should use the jit for prg rom code
+    struct Jit *jit;
 } Cpu;
 
 typedef struct
@@ -84,12 +103,41 @@ typedef struct
 #define CHECK_BIT(var, pos) ((var) & (1 << (pos)))
 #define GET_NEG_BIT(operand) ((operand >> 7) & 1)
 #define GET_OVERFLOW_BIT(operand) ((operand >> 6) & 1)
+
+#ifdef CPU_LAZY_FLAGS
+#define FLAG_N(cpu) ((cpu)->n_result >> 7)
+#define FLAG_Z(cpu) (!(cpu)->z_result)
+#define FLAG_C(cpu) ((cpu)->c_result)
+#define FLAG_V(cpu) ((cpu)->v_result)
+#define SET_FLAG_C(cpu, val) ((cpu)->c_result = (val))
+#define SET_FLAG_V(cpu, val) ((cpu)->v_result = (val))
+#define UPDATE_FLAGS_NZ(var) \
+    cpu->n_result = cpu->z_result = (var)
+// N from bit 7 of n_src, Z if z_src is zero
+#define UPDATE_FLAGS_N_Z(n_src, z_src) \
+    cpu->n_result = (n_src); \
+    cpu->z_result = (z_src)
+#else
+#define FLAG_N(cpu) ((cpu)->status.n)
+#define FLAG_Z(cpu) ((cpu)->status.z)
+#define FLAG_C(cpu) ((cpu)->status.c)
+#define FLAG_V(cpu) ((cpu)->status.v)
+#define SET_FLAG_C(cpu, val) ((cpu)->status.c = (val))
+#define SET_FLAG_V(cpu, val) ((cpu)->status.v = (val))
 #define UPDATE_FLAGS_NZ(var) \
     cpu->status.n = GET_NEG_BIT(var); \
     cpu->status.z = !var
+#define UPDATE_FLAGS_N_Z(n_src, z_src) \
+    cpu->status.n = GET_NEG_BIT(n_src); \
+    cpu->status.z = !(z_src)
+#endif
 
-void CPU_Init(Cpu *cpu);
+void CPU_Init(Cpu *cpu, struct System *system);
 void CPU_ExecuteInstr(Cpu *cpu, bool debug_info);
+void CPU_Run(Cpu *cpu);
 void CPU_Reset(Cpu *cpu);
+uint8_t CPU_GetStatus(const Cpu *cpu);
+void CPU_SetStatus(Cpu *cpu, uint8_t status);
+const OpcodeHandler *CPU_GetOpcode(const uint8_t opcode);
 
 #endif
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "system.h"
+#include "utils.h"
+
+#define VERSION "v0.4.0"
+
+// One emulated console, every instance owns its own arena and System
+// so they can be run side by side on separate threads
+typedef struct
+{
+    const char *rom_path;
+    const char *palette_path;
+    const char *frame_path;
+    const char *audio_path;
+    long num_frames;
+    int sample_rate;
+    int run_ahead;
+    bool ppu_warmup;
+    bool swap_duty_cycles;
+    bool cycle_mixer;
+    ApuMix mix;
+    bool skip_idle_loops;
+    bool jit;
+    bool verify_jit;
+    bool run_ahead_instance;
+
+    FILE *audio_file;
+    uint64_t audio_samples;
+    uint32_t audio_hash;
+    uint64_t cycles;
+    uint32_t frame_hash;
+    int ret;
+    bool finished;
+} Headless;
+
+#define HEADLESS_MAX_INSTANCES 64
+
+static void About(void)
+{
+    printf("nones-headless " VERSION " by Matt W\n");
+}
+
+static void Usage(void)
+{
+    About();
+    printf("Usage: nones-headless \"game.nes\" [options...]\n");
+}
+
+static void Help(void)
+{
+    Usage();
+    printf("Options:\n"
+           "  --help                             Display this information\n"
+           "  --version                          Display version information\n"
+           "  --frames=\"num-frames\"              Number of frames to run (default 600)\n"
+           "  --dump-frame=\"file.ppm\"            Write the last frame to a ppm image\n"
+           "  --dump-audio=\"file.raw\"            Write the mixed audio as raw 32-bit float mono samples\n"
+           "  --apu-mix=\"mode\"                   How the channels are mixed: table (default), formula or linear\n"
+           "  --apu-cycle-mixer                  Mix the audio every apu cycle and oversample it 3x instead of the band limited synthesis\n"
+           "  --palette=\"file.pal\"               Use the colors from a .pal file instead of the built in palette\n"
+           "  --instances=\"num-instances\"        Run the rom on multiple independent systems at once, one thread each (default 1)\n"
+           "  --no-idle-skip                     Run idle loops instruction by instruction instead of skipping to the next event\n"
+           "  --jit                              Run prg rom code through the experimental jit (x86-64 only)\n"
+           "  --jit-verify                       Run the jit and the interpreter side by side and check every frame matches\n"
+           "  --run-ahead=\"num-frames\"           Show the frame this many frames ahead of the emulated one (0 - 4, default 0)\n"
+           "  --run-ahead-instance               Run ahead on a second system instead of saving and restoring the state\n"
+           "  --ppu-warmup                       Enable the ppu warm up delay found on the NES-001(Will break some famicom games)\n"
+           "  --apu-swap-duty-cycles             Enable the use of swapped duty cycles for the square/pulse channels(Needed for older famiclone games)\n"
+           "  --sample-rate=\"sample-rate-mode\"   Set the audio sample-rate: 0 = 44100Hz (default), 1 = 48000Hz, 2 = 96000Hz, 3 = 192000Hz\n");
+}
+
+static const int sample_rates[] =
+{
+    44100,
+    48000,
+    96000,
+    192000
+};
+
+// FNV-1a
+static uint32_t HeadlessHash(uint32_t hash, const void *data, const size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void HeadlessPutSamples(void *userdata, const float *samples, const int num_samples)
+{
+    Headless *headless = userdata;
+
+    headless->audio_samples += num_samples;
+    headless->audio_hash = HeadlessHash(headless->audio_hash, samples, num_samples * sizeof(float));
+
+    if (headless->audio_file)
+    {
+        fwrite(samples, sizeof(float), num_samples, headless->audio_file);
+    }
+}
+
+static int HeadlessWriteFrame(const char *path, const uint32_t *buffer)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        printf("Failed to open %s\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    uint8_t line[SCREEN_WIDTH * 3];
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            // Pixels are stored as RGBA8888
+            const uint32_t pixel = buffer[y * SCREEN_WIDTH + x];
+            line[x * 3 + 0] = (pixel >> 24) & 0xFF;
+            line[x * 3 + 1] = (pixel >> 16) & 0xFF;
+            line[x * 3 + 2] = (pixel >> 8) & 0xFF;
+        }
+        fwrite(line, 1, sizeof(line), fp);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static System *HeadlessCreateSystem(Headless *headless, Arena *arena)
+{
+    System *system = SystemCreate(arena);
+
+    if (SystemLoadCart(arena, system, headless->rom_path))
+        return NULL;
+
+    uint16_t *buffers[2];
+    const uint32_t buffer_size = (SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint16_t));
+    buffers[0] = ArenaPush(arena, buffer_size);
+    buffers[1] = ArenaPush(arena, buffer_size);
+
+    const ApuSynth synth = headless->cycle_mixer ? APU_SYNTH_CYCLE : APU_SYNTH_BLIP;
+    SystemInit(system, arena, headless->ppu_warmup, headless->swap_duty_cycles, headless->sample_rate, synth, buffers, buffer_size);
+    SystemSetAudioMix(system, headless->mix);
+    if (headless->palette_path != NULL && SystemLoadPalette(system, headless->palette_path))
+        return NULL;
+
+    system->skip_idle_loops = headless->skip_idle_loops;
+    return system;
+}
+
+// Checks everything the jit could get wrong against the interpreter's run of the same frame
+static bool HeadlessSameFrame(const System *system, const System *ref, const uint32_t buffer_size)
+{
+    const Cpu *cpu = system->cpu;
+    const Cpu *ref_cpu = ref->cpu;
+
+    return cpu->cycles == ref_cpu->cycles && cpu->instructions == ref_cpu->instructions &&
+           cpu->pc == ref_cpu->pc && cpu->a == ref_cpu->a && cpu->x == ref_cpu->x && cpu->y == ref_cpu->y &&
+           cpu->sp == ref_cpu->sp && CPU_GetStatus(cpu) == CPU_GetStatus(ref_cpu) &&
+           !memcmp(system->sys_ram, ref->sys_ram, CPU_RAM_SIZE) &&
+           !memcmp(system->ppu->buffers[1], ref->ppu->buffers[1], buffer_size);
+}
+
+static void *HeadlessRun(void *arg)
+{
+    Headless *headless = arg;
+    headless->ret = EXIT_FAILURE;
+    headless->audio_hash = 2166136261u;
+
+    if (headless->audio_path != NULL)
+    {
+        headless->audio_file = fopen(headless->audio_path, "wb");
+        if (headless->audio_file == NULL)
+        {
+            printf("Failed to open %s\n", headless->audio_path);
+            return NULL;
+        }
+    }
+
+    const uint32_t buffer_size = (SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint16_t));
+    Arena *arena = ArenaCreate(1024 * 1024 * 3);
+    System *system = HeadlessCreateSystem(headless, arena);
+
+    // The interpreter's copy of the run the jit is checked against
+    Arena *ref_arena = NULL;
+    System *ref_system = NULL;
+    if (headless->verify_jit)
+    {
+        ref_arena = ArenaCreate(1024 * 1024 * 3);
+        ref_system = HeadlessCreateSystem(headless, ref_arena);
+    }
+
+    if (system == NULL || (headless->verify_jit && ref_system == NULL) ||
+        ((headless->jit || headless->verify_jit) && !SystemSetCpuJit(system, true)))
+    {
+        if (headless->audio_file)
+            fclose(headless->audio_file);
+
+        if (ref_arena)
+            ArenaDestroy(ref_arena);
+
+        ArenaDestroy(arena);
+        return NULL;
+    }
+
+    SystemSetAudioCallback(system, HeadlessPutSamples, headless);
+
+    const size_t state_size = SystemStateSize(system);
+    void *state = headless->run_ahead ? ArenaPush(arena, state_size) : NULL;
+
+    Arena *ahead_arena = NULL;
+    System *ahead_system = NULL;
+    if (headless->run_ahead && headless->run_ahead_instance)
+    {
+        ahead_arena = ArenaCreate(1024 * 1024 * 3);
+        ahead_system = HeadlessCreateSystem(headless, ahead_arena);
+    }
+
+    const uint16_t *frame_buffer = system->ppu->buffers[1];
+    long frame;
+    for (frame = 0; frame < headless->num_frames; frame++)
+    {
+        // Only the last frame is ever looked at, unless every frame is compared to the interpreter's
+        if (!ref_system)
+            SystemSetFrameOutput(system, frame + 2 >= headless->num_frames);
+
+        SystemRun(system, false);
+
+        if (ref_system)
+        {
+            SystemRun(ref_system, false);
+            if (!HeadlessSameFrame(system, ref_system, buffer_size))
+            {
+                printf("The jit diverged from the interpreter on frame %ld\n", frame);
+                break;
+            }
+        }
+
+        frame_buffer = SystemRunAhead(system, ahead_system, state, state_size, headless->run_ahead);
+    }
+
+    headless->cycles = system->cpu->cycles;
+    // Hashed and dumped as rgba so neither depends on how the ppu stores its frames
+    const uint32_t pixels_size = SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t);
+    uint32_t *pixels = ArenaPush(arena, pixels_size);
+    SystemConvertFrame(system, frame_buffer, pixels, SCREEN_WIDTH * sizeof(uint32_t), PPU_PIXEL_RGBA8888);
+    headless->frame_hash = HeadlessHash(2166136261u, pixels, pixels_size);
+    headless->finished = true;
+    headless->ret = frame == headless->num_frames ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (headless->frame_path != NULL && HeadlessWriteFrame(headless->frame_path, pixels))
+        headless->ret = EXIT_FAILURE;
+
+    if (headless->audio_file)
+        fclose(headless->audio_file);
+
+    if (ref_system)
+    {
+        SystemShutdown(ref_system);
+        ArenaDestroy(ref_arena);
+    }
+
+    if (ahead_arena)
+    {
+        if (ahead_system)
+            SystemShutdown(ahead_system);
+
+        ArenaDestroy(ahead_arena);
+    }
+
+    SystemShutdown(system);
+    ArenaDestroy(arena);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("No file was provided\n");
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    int sample_rate_mode = 0;
+    long num_frames = 600;
+    bool ppu_warmup = false;
+    bool swap_duty_cycles = false;
+    bool cycle_mixer = false;
+    ApuMix mix = APU_MIX_TABLE;
+    bool skip_idle_loops = true;
+    bool jit = false;
+    bool verify_jit = false;
+    int run_ahead = 0;
+    bool run_ahead_instance = false;
+    const char *frame_path = NULL;
+    const char *audio_path = NULL;
+    const char *palette_path = NULL;
+    int num_instances = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp((argv[i]), "--help"))
+        {
+            Help();
+            return EXIT_SUCCESS;
+        }
+
+        if (!strcmp((argv[i]), "--version"))
+        {
+            About();
+            return EXIT_SUCCESS;
+        }
+
+        if (i == 1)
+            continue;
+
+        if (!strcmp((argv[i]), "--ppu-warmup"))
+            ppu_warmup = true;
+
+        if (!strcmp((argv[i]), "--apu-swap-duty-cycles"))
+            swap_duty_cycles = true;
+
+        if (strstr((argv[i]), "--apu-mix="))
+        {
+            if (!APU_ParseMix(strchr(argv[i], '=') + 1, &mix))
+            {
+                printf("Invalid apu mix mode! (table, formula or linear)\n");
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!strcmp((argv[i]), "--apu-cycle-mixer"))
+            cycle_mixer = true;
+
+        if (!strcmp((argv[i]), "--no-idle-skip"))
+            skip_idle_loops = false;
+
+        if (!strcmp((argv[i]), "--jit"))
+            jit = true;
+
+        if (!strcmp((argv[i]), "--jit-verify"))
+            verify_jit = true;
+
+        if (!strcmp((argv[i]), "--run-ahead-instance"))
+            run_ahead_instance = true;
+
+        if (strstr((argv[i]), "--run-ahead="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            run_ahead = (int)strtol(delim_pos + 1, &end, 10);
+            if (run_ahead < 0 || run_ahead > SYSTEM_MAX_RUN_AHEAD || *end != '\0')
+            {
+                printf("Invalid run ahead frame count! (0 - %d)\n", SYSTEM_MAX_RUN_AHEAD);
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--sample-rate="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            int new_sample_mode = (int)strtol(delim_pos + 1, &end, 10);
+            if (new_sample_mode >= 0 && new_sample_mode < (int)ARRAY_SIZE(sample_rates))
+                sample_rate_mode = new_sample_mode;
+            else
+            {
+                printf("Invalid sample rate mode!\n");
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--frames="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            num_frames = strtol(delim_pos + 1, &end, 10);
+            if (num_frames <= 0 || *end != '\0')
+            {
+                printf("Invalid frame count!\n");
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--instances="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            num_instances = (int)strtol(delim_pos + 1, &end, 10);
+            if (num_instances <= 0 || num_instances > HEADLESS_MAX_INSTANCES || *end != '\0')
+            {
+                printf("Invalid instance count! (1 - %d)\n", HEADLESS_MAX_INSTANCES);
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--dump-frame="))
+            frame_path = strchr(argv[i], '=') + 1;
+
+        if (strstr((argv[i]), "--dump-audio="))
+            audio_path = strchr(argv[i], '=') + 1;
+
+        if (strstr((argv[i]), "--palette="))
+            palette_path = strchr(argv[i], '=') + 1;
+    }
+
+    static Headless instances[HEADLESS_MAX_INSTANCES];
+    for (int i = 0; i < num_instances; i++)
+    {
+        Headless *headless = &instances[i];
+        headless->rom_path = argv[1];
+        headless->palette_path = palette_path;
+        headless->num_frames = num_frames;
+        headless->sample_rate = sample_rates[sample_rate_mode];
+        headless->ppu_warmup = ppu_warmup;
+        headless->swap_duty_cycles = swap_duty_cycles;
+        headless->cycle_mixer = cycle_mixer;
+        headless->mix = mix;
+        headless->skip_idle_loops = skip_idle_loops;
+        headless->jit = jit;
+        headless->verify_jit = verify_jit;
+        headless->run_ahead = run_ahead;
+        headless->run_ahead_instance = run_ahead_instance;
+    }
+
+    // Only the first instance dumps anything, the rest would write the same files
+    instances[0].frame_path = frame_path;
+    instances[0].audio_path = audio_path;
+
+    if (num_instances == 1)
+    {
+        HeadlessRun(&instances[0]);
+    }
+    else
+    {
+        pthread_t threads[HEADLESS_MAX_INSTANCES];
+        for (int i = 0; i < num_instances; i++)
+        {
+            if (pthread_create(&threads[i], NULL, HeadlessRun, &instances[i]))
+            {
+                printf("Failed to create thread for instance %d\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+
+        for (int i = 0; i < num_instances; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    const Headless *headless = &instances[0];
+    if (!headless->finished)
+        return EXIT_FAILURE;
+
+    printf("Frames: %ld\n", num_frames);
+    printf("CPU cycles: %lu\n", (unsigned long)headless->cycles);
+    printf("Frame hash: %08X\n", headless->frame_hash);
+    printf("Audio samples: %lu\n", (unsigned long)headless->audio_samples);
+    printf("Audio hash: %08X\n", headless->audio_hash);
+
+    int ret = headless->ret;
+    if (num_instances > 1)
+    {
+        // Every instance ran the same rom with the same settings, so anything
+        // that differs means state leaked between them
+        int mismatches = 0;
+        for (int i = 1; i < num_instances; i++)
+        {
+            const Headless *other = &instances[i];
+            if (!other->finished || other->cycles != headless->cycles ||
+                other->frame_hash != headless->frame_hash || other->audio_hash != headless->audio_hash)
+            {
+                printf("Instance %d differs! CPU cycles: %lu Frame hash: %08X Audio hash: %08X\n",
+                       i, (unsigned long)other->cycles, other->frame_hash, other->audio_hash);
+                mismatches++;
+            }
+        }
+
+        printf("Instances: %d (%d mismatched)\n", num_instances, mismatches);
+        if (mismatches)
+            ret = EXIT_FAILURE;
+    }
+
+    return ret;
+}
@@ -0,0 +1,1692 @@
+// mmap's MAP_ANONYMOUS and sysconf's _SC_PAGESIZE aren't part of plain c11
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "jit.h"
+#include "cpu.h"
+#include "system.h"
+#include "utils.h"
+
+#ifdef JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Blocks are keyed by the cpu address and the prg rom address it's mapped to, so a bank
+// switch just selects other blocks instead of invalidating anything
+#define JIT_CACHE_BITS 16
+#define JIT_CACHE_SIZE (1 << JIT_CACHE_BITS)
+#define JIT_CODE_SIZE (16 * 1024 * 1024)
+// Times a block has to be reached before it's worth compiling
+#define JIT_HOT_THRESHOLD 16
+// Set as the hits of a block that can't be compiled
+#define JIT_NEVER UINT16_MAX
+// The worst instruction (a read-modify-write abs,X with its stub) is under 256 bytes,
+// the prologue and the code every exit and stub share fit in the spare
+#define JIT_INSTR_CODE_SIZE 256
+#define JIT_BLOCK_CODE_SIZE ((JIT_MAX_BLOCK_INSTRS + 1) * JIT_INSTR_CODE_SIZE)
+// Most checks a single instruction can leave the native code from
+#define JIT_MAX_DEOPTS 4
+// An instruction leaves the native code one way at most, then there's the end of the block
+#define JIT_MAX_EXITS (JIT_MAX_BLOCK_INSTRS + 1)
+// The longest loop body CpuSkipIdleLoop takes, two 3 byte reads before the jump back
+#define JIT_IDLE_LOOP_BYTES 6
+
+// budget is how many cycles the block can run before anything but the cpu has to be ticked
+typedef void (*JitBlockFn)(Cpu *cpu, uint64_t budget);
+
+typedef struct
+{
+    JitBlockFn code;
+    uint32_t rom_addr;
+    // Most cycles a pass through the block takes up to the first instruction it can't run,
+    // at least 1 so it never runs with an interrupt pending
+    uint32_t cycles;
+    uint16_t pc;
+    uint16_t hits;
+} JitBlock;
+
+struct Jit
+{
+    JitBlock blocks[JIT_CACHE_SIZE];
+    uint8_t *code;
+    size_t code_used;
+    size_t page_size;
+    // Page the running block was compiled from, it's left if a bank switch maps out of it
+    const uint8_t *code_page;
+};
+
+typedef enum
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+} JitReg;
+
+// Group 1 ops (add, or, adc... r/m, imm) are picked by the reg field
+enum { ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP };
+
+enum { CC_O = 0x0, CC_C = 0x2, CC_NC = 0x3, CC_Z = 0x4, CC_NZ = 0x5, CC_A = 0x7 };
+
+// The 6502 state lives in callee saved registers for the whole block
+#define REG_P RBX
+#define REG_CYCLES RBP
+#define REG_SYSTEM R12
+#define REG_A R13
+#define REG_X R14
+#define REG_Y R15
+// Stack slots, the cpu and the budget passed in
+#define SLOT_CPU 0
+#define SLOT_BUDGET 8
+#define FRAME_SIZE 24
+
+#define FLAG_C_BIT 0x01
+#define FLAG_Z_BIT 0x02
+#define FLAG_I_BIT 0x04
+#define FLAG_D_BIT 0x08
+#define FLAG_V_BIT 0x40
+#define FLAG_N_BIT 0x80
+
+// The n and z flags of every value, or'd into P after clearing them
+#define JIT_NZ(v) ((v) & 0x80 ? FLAG_N_BIT : (v) == 0 ? FLAG_Z_BIT : 0)
+#define JIT_NZ4(v) JIT_NZ(v), JIT_NZ((v) + 1), JIT_NZ((v) + 2), JIT_NZ((v) + 3)
+#define JIT_NZ16(v) JIT_NZ4(v), JIT_NZ4((v) + 4), JIT_NZ4((v) + 8), JIT_NZ4((v) + 12)
+#define JIT_NZ64(v) JIT_NZ16(v), JIT_NZ16((v) + 16), JIT_NZ16((v) + 32), JIT_NZ16((v) + 48)
+static const uint8_t jit_nz_flags[256] = { JIT_NZ64(0), JIT_NZ64(64), JIT_NZ64(128), JIT_NZ64(192) };
+
+typedef enum
+{
+    // Left to the interpreter
+    JIT_OP_NONE,
+    JIT_OP_LDA, JIT_OP_LDX, JIT_OP_LDY, JIT_OP_STA, JIT_OP_STX, JIT_OP_STY,
+    JIT_OP_ADC, JIT_OP_SBC, JIT_OP_AND, JIT_OP_ORA, JIT_OP_EOR,
+    JIT_OP_CMP, JIT_OP_CPX, JIT_OP_CPY, JIT_OP_BIT,
+    JIT_OP_INC, JIT_OP_DEC, JIT_OP_ASL, JIT_OP_LSR, JIT_OP_ROL, JIT_OP_ROR,
+    JIT_OP_INX, JIT_OP_INY, JIT_OP_DEX, JIT_OP_DEY,
+    JIT_OP_TAX, JIT_OP_TAY, JIT_OP_TXA, JIT_OP_TYA, JIT_OP_TSX, JIT_OP_TXS,
+    JIT_OP_CLC, JIT_OP_SEC, JIT_OP_CLI, JIT_OP_SEI, JIT_OP_CLV, JIT_OP_CLD, JIT_OP_SED, JIT_OP_NOP,
+    JIT_OP_PHA, JIT_OP_PHP, JIT_OP_PLA, JIT_OP_PLP, JIT_OP_JMP, JIT_OP_JSR, JIT_OP_RTS, JIT_OP_BRANCH
+} JitOp;
+
+// Matched against the mnemonic at the start of the handler's name. The illegal opcodes that
+// share one (NOP, SBC #imm) behave the same, anything else isn't listed and is interpreted
+static const struct
+{
+    char name[4];
+    JitOp op;
+} jit_ops[] =
+{
+    { "LDA", JIT_OP_LDA }, { "LDX", JIT_OP_LDX }, { "LDY", JIT_OP_LDY },
+    { "STA", JIT_OP_STA }, { "STX", JIT_OP_STX }, { "STY", JIT_OP_STY },
+    { "ADC", JIT_OP_ADC }, { "SBC", JIT_OP_SBC }, { "AND", JIT_OP_AND },
+    { "ORA", JIT_OP_ORA }, { "EOR", JIT_OP_EOR }, { "CMP", JIT_OP_CMP },
+    { "CPX", JIT_OP_CPX }, { "CPY", JIT_OP_CPY }, { "BIT", JIT_OP_BIT },
+    { "INC", JIT_OP_INC }, { "DEC", JIT_OP_DEC }, { "ASL", JIT_OP_ASL },
+    { "LSR", JIT_OP_LSR }, { "ROL", JIT_OP_ROL }, { "ROR", JIT_OP_ROR },
+    { "INX", JIT_OP_INX }, { "INY", JIT_OP_INY }, { "DEX", JIT_OP_DEX },
+    { "DEY", JIT_OP_DEY }, { "TAX", JIT_OP_TAX }, { "TAY", JIT_OP_TAY },
+    { "TXA", JIT_OP_TXA }, { "TYA", JIT_OP_TYA }, { "TSX", JIT_OP_TSX },
+    { "TXS", JIT_OP_TXS }, { "CLC", JIT_OP_CLC }, { "SEC", JIT_OP_SEC },
+    { "CLI", JIT_OP_CLI }, { "SEI", JIT_OP_SEI }, { "CLV", JIT_OP_CLV },
+    { "CLD", JIT_OP_CLD }, { "SED", JIT_OP_SED }, { "NOP", JIT_OP_NOP },
+    { "PHA", JIT_OP_PHA }, { "PHP", JIT_OP_PHP }, { "PLA", JIT_OP_PLA },
+    { "PLP", JIT_OP_PLP }, { "JMP", JIT_OP_JMP }, { "JSR", JIT_OP_JSR },
+    { "RTS", JIT_OP_RTS },
+};
+
+typedef enum
+{
+    JIT_READ,
+    JIT_WRITE,
+    JIT_MODIFY
+} JitAccess;
+
+typedef struct
+{
+    const OpcodeHandler *handler;
+    JitOp op;
+    uint16_t pc;
+    // The bytes after the opcode
+    uint8_t operand[2];
+    // Most cycles it takes natively, 0 if it's left to the interpreter
+    uint8_t cycles;
+} JitInstr;
+
+// Where a memory operand is once its address is worked out, [rcx + index + disp] to read it
+// and [rdi + index + disp] to write it. The address is in eax unless it's fixed
+typedef struct
+{
+    int index;
+    int32_t disp;
+    bool fixed;
+    uint16_t addr;
+} JitMem;
+
+typedef struct
+{
+    uint8_t *pos;
+} JitEmitter;
+
+typedef struct
+{
+    JitEmitter e;
+    System *system;
+    // Page the block is in, every instruction's bytes are read from it
+    const uint8_t *page;
+    JitInstr instrs[JIT_MAX_BLOCK_INSTRS];
+    int num_instrs;
+    // Instruction being emitted
+    int current;
+    // Most cycles from each instruction up to the next one left to the interpreter
+    uint32_t remaining[JIT_MAX_BLOCK_INSTRS + 1];
+    // Code of each instruction, the last one is the exit after the block
+    uint8_t *resume[JIT_MAX_BLOCK_INSTRS + 1];
+    // Jumps to each instruction's stub, taken when it can't run natively
+    uint8_t *deopts[JIT_MAX_BLOCK_INSTRS][JIT_MAX_DEOPTS];
+    int num_deopts[JIT_MAX_BLOCK_INSTRS];
+    // Branches to instructions further on in the block, patched once their code is there
+    uint8_t *skips[JIT_MAX_BLOCK_INSTRS];
+    int skip_targets[JIT_MAX_BLOCK_INSTRS];
+    int num_skips;
+    // Jumps to the code every exit shares and calls from the stubs to the interpreter
+    uint8_t *exits[JIT_MAX_EXITS];
+    int num_exits;
+    uint8_t *interprets[JIT_MAX_BLOCK_INSTRS];
+    int num_interprets;
+} JitCompiler;
+
+static void Emit8(JitEmitter *e, const uint8_t val)
+{
+    *e->pos++ = val;
+}
+
+static void EmitBytes(JitEmitter *e, const void *bytes, const size_t size)
+{
+    memcpy(e->pos, bytes, size);
+    e->pos += size;
+}
+
+static void Emit16(JitEmitter *e, const uint16_t val)
+{
+    EmitBytes(e, &val, sizeof(val));
+}
+
+static void Emit32(JitEmitter *e, const uint32_t val)
+{
+    EmitBytes(e, &val, sizeof(val));
+}
+
+static void Emit64(JitEmitter *e, const uint64_t val)
+{
+    EmitBytes(e, &val, sizeof(val));
+}
+
+// Operand size prefix and rex, byte operands always get a rex so sil/dil aren't ah/bh
+static void EmitPrefix(JitEmitter *e, const int size, const int reg, const int index, const int base)
+{
+    if (size == 2)
+        Emit8(e, 0x66);
+
+    const uint8_t rex = (size == 8) << 3 | (reg >> 3 & 1) << 2 | (index >> 3 & 1) << 1 | (base >> 3 & 1);
+    if (rex || size == 1)
+        Emit8(e, 0x40 | rex);
+}
+
+static void EmitOpcode(JitEmitter *e, const int op)
+{
+    if (op > 0xFF)
+        Emit8(e, op >> 8);
+    Emit8(e, op & 0xFF);
+}
+
+// op reg, rm with both registers
+static void EmitRR(JitEmitter *e, const int size, const int op, const int reg, const int rm)
+{
+    EmitPrefix(e, size, reg, 0, rm);
+    EmitOpcode(e, op);
+    Emit8(e, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// op reg, [base + index + disp], index is -1 for none
+static void EmitRM(JitEmitter *e, const int size, const int op, const int reg, const int base,
+                   const int index, const int32_t disp)
+{
+    EmitPrefix(e, size, reg, index < 0 ? 0 : index, base);
+    EmitOpcode(e, op);
+
+    // rsp and r12 as the base always need a sib
+    if (index >= 0 || (base & 7) == RSP)
+    {
+        Emit8(e, 0x80 | (reg & 7) << 3 | 4);
+        Emit8(e, (index < 0 ? 4 : index & 7) << 3 | (base & 7));
+    }
+    else
+    {
+        Emit8(e, 0x80 | (reg & 7) << 3 | (base & 7));
+    }
+
+    Emit32(e, (uint32_t)disp);
+}
+
+static void EmitMovImm32(JitEmitter *e, const int reg, const uint32_t imm)
+{
+    if (reg >= R8)
+        Emit8(e, 0x41);
+    Emit8(e, 0xB8 | (reg & 7));
+    Emit32(e, imm);
+}
+
+static void EmitMovImm64(JitEmitter *e, const int reg, const uint64_t imm)
+{
+    Emit8(e, 0x48 | (reg >> 3 & 1));
+    Emit8(e, 0xB8 | (reg & 7));
+    Emit64(e, imm);
+}
+
+// op reg, imm8 for the group 1 ops, sign extended
+static void EmitAluImm8(JitEmitter *e, const int size, const int alu, const int reg, const uint8_t imm)
+{
+    EmitRR(e, size, 0x83, alu, reg);
+    Emit8(e, imm);
+}
+
+static void EmitShiftImm(JitEmitter *e, const int ext, const int reg, const uint8_t count)
+{
+    EmitRR(e, 4, 0xC1, ext, reg);
+    Emit8(e, count);
+}
+
+static void EmitPush(JitEmitter *e, const int reg)
+{
+    if (reg >= R8)
+        Emit8(e, 0x41);
+    Emit8(e, 0x50 | (reg & 7));
+}
+
+static void EmitPop(JitEmitter *e, const int reg)
+{
+    if (reg >= R8)
+        Emit8(e, 0x41);
+    Emit8(e, 0x58 | (reg & 7));
+}
+
+static void EmitCall(JitEmitter *e, const uintptr_t fn)
+{
+    EmitMovImm64(e, RAX, fn);
+    // call rax
+    EmitBytes(e, "\xFF\xD0", 2);
+}
+
+// jcc rel32, returns where the offset goes so it can be pointed somewhere later
+static uint8_t *EmitJcc(JitEmitter *e, const int cc)
+{
+    Emit8(e, 0x0F);
+    Emit8(e, 0x80 | cc);
+    uint8_t *rel = e->pos;
+    Emit32(e, 0);
+    return rel;
+}
+
+static uint8_t *EmitJmp(JitEmitter *e)
+{
+    Emit8(e, 0xE9);
+    uint8_t *rel = e->pos;
+    Emit32(e, 0);
+    return rel;
+}
+
+// call rel32 to code in the same block
+static uint8_t *EmitCallRel(JitEmitter *e)
+{
+    Emit8(e, 0xE8);
+    uint8_t *rel = e->pos;
+    Emit32(e, 0);
+    return rel;
+}
+
+static void PatchJump(uint8_t *rel, const uint8_t *target)
+{
+    const int32_t offset = (int32_t)(target - (rel + 4));
+    memcpy(rel, &offset, sizeof(offset));
+}
+
+// Ticks the cycles the block has run and leaves it at pc
+static void JitExit(Cpu *cpu, const uint64_t cycles, const uint32_t pc, const uint32_t instrs)
+{
+    cpu->pc = pc;
+    cpu->instructions += instrs;
+    SystemRunIdleCycles(cpu->system, cycles);
+}
+
+// Cycles the cpu can run from here on with nothing else having to be ticked along with it.
+// It's the window idle loops are skipped over, up to the next event with no dma, dmc fetch
+// (a looping sample restarting included), interrupt or irq the ppu clocks in it, so inside
+// it only the apu needs ticking and that can wait
+static uint64_t JitBudget(Cpu *cpu)
+{
+    if (cpu->nmi_pending || cpu->irq_pending)
+        return 0;
+
+    const uint64_t idle_cycles = SystemIdleCycles(cpu->system);
+    if (idle_cycles && !cpu->status.i && SystemPollAllIrqs(cpu->system))
+        return 0;
+
+    return idle_cycles;
+}
+
+// Runs the instruction at pc that the block can't, after ticking the cycles the block ran up to
+// it. Returns the budget to carry on with, or 0 if the block has to be left because control went
+// somewhere else, the frame ended or there isn't enough budget for the native code after it
+static uint64_t JitInterpret(Cpu *cpu, const uint64_t cycles, const uint32_t pc, const uint32_t instrs,
+                             const uint32_t next_pc, const uint32_t next_cycles)
+{
+    System *system = cpu->system;
+    cpu->pc = pc;
+    SystemRunIdleCycles(system, cycles);
+
+    const OpcodeHandler *handler = CPU_GetOpcode(SystemRead(system, cpu->pc));
+    handler->InstrFn(cpu, handler->addr_mode, handler->page_cross_penalty);
+
+    if (cpu->pc == next_pc && !system->ppu->frame_finished &&
+        system->read_pages[next_pc >> MEM_PAGE_SHIFT].data == cpu->jit->code_page)
+    {
+        const uint64_t budget = JitBudget(cpu);
+        if (budget >= MAX(next_cycles, 1))
+            return budget;
+    }
+
+    cpu->instructions += instrs;
+    return 0;
+}
+
+static JitOp JitGetOp(const OpcodeHandler *handler)
+{
+    if (handler->addr_mode == Relative)
+        return JIT_OP_BRANCH;
+
+    for (size_t i = 0; i < ARRAY_SIZE(jit_ops); i++)
+    {
+        if (strncmp(handler->name, jit_ops[i].name, 3) == 0 &&
+            (handler->name[3] == '\0' || handler->name[3] == ' '))
+        {
+            // Only the implied NOP, the others read memory and JMP (ind) goes through it too
+            if ((jit_ops[i].op == JIT_OP_NOP && handler->addr_mode != Implied) ||
+                (jit_ops[i].op == JIT_OP_JMP && handler->addr_mode != Absolute))
+                return JIT_OP_NONE;
+
+            return jit_ops[i].op;
+        }
+    }
+
+    return JIT_OP_NONE;
+}
+
+static JitAccess JitGetAccess(const JitOp op)
+{
+    switch (op)
+    {
+        case JIT_OP_STA:
+        case JIT_OP_STX:
+        case JIT_OP_STY:
+            return JIT_WRITE;
+        case JIT_OP_INC:
+        case JIT_OP_DEC:
+        case JIT_OP_ASL:
+        case JIT_OP_LSR:
+        case JIT_OP_ROL:
+        case JIT_OP_ROR:
+            return JIT_MODIFY;
+        default:
+            return JIT_READ;
+    }
+}
+
+static bool JitIsMemOp(const JitInstr *instr)
+{
+    switch (instr->handler->addr_mode)
+    {
+        case Implied:
+        case Accumulator:
+        case Relative:
+            return false;
+        default:
+            return instr->op != JIT_OP_JMP && instr->op != JIT_OP_JSR;
+    }
+}
+
+// The index modes where the extra cycle of a page cross is only known at runtime
+static bool JitHasPageCrossCycle(const JitInstr *instr)
+{
+    const AddressingMode mode = instr->handler->addr_mode;
+    return instr->handler->page_cross_penalty && (mode == AbsoluteX || mode == AbsoluteY || mode == IndirectY);
+}
+
+static uint16_t JitAbsAddr(const JitInstr *instr)
+{
+    return (uint16_t)instr->operand[1] << 8 | instr->operand[0];
+}
+
+static uint16_t JitBranchTarget(const JitInstr *instr)
+{
+    return instr->pc + 2 + (int8_t)instr->operand[0];
+}
+
+// Ram that never moves, the page pointers can be used directly
+static bool JitIsFixedRam(const System *system, const uint8_t page)
+{
+    const uint8_t *data = system->read_pages[page].data;
+    return page < 0x20 && data && data == system->write_pages[page].data &&
+           data >= system->sys_ram && data < system->sys_ram + CPU_RAM_SIZE;
+}
+
+// Most cycles the instruction takes, including the opcode fetch and every dummy access
+static uint8_t JitMaxCycles(const JitInstr *instr)
+{
+    switch (instr->op)
+    {
+        case JIT_OP_BRANCH:
+            return (JitBranchTarget(instr) ^ (instr->pc + 2)) & 0xFF00 ? 4 : 3;
+        case JIT_OP_JMP:
+        case JIT_OP_PHA:
+        case JIT_OP_PHP:
+            return 3;
+        case JIT_OP_PLA:
+        case JIT_OP_PLP:
+            return 4;
+        case JIT_OP_JSR:
+        case JIT_OP_RTS:
+            return 6;
+        default:
+            break;
+    }
+
+    uint8_t cycles;
+    switch (instr->handler->addr_mode)
+    {
+        case Immediate:   cycles = 2; break;
+        case ZeroPage:    cycles = 3; break;
+        case ZeroPageX:
+        case ZeroPageY:
+        case Absolute:    cycles = 4; break;
+        case AbsoluteX:
+        case AbsoluteY:   cycles = 5; break;
+        case IndirectX:
+        case IndirectY:   cycles = 6; break;
+        default:          return 2;
+    }
+
+    // The dummy write of the old value and the write of the new one
+    return JitGetAccess(instr->op) == JIT_MODIFY ? cycles + 2 : cycles;
+}
+
+// Anything that never carries on to the next instruction ends a block, branches don't since
+// they do when not taken. CLI does too, an irq it lets through has to be seen straight away
+static bool JitEndsBlock(const uint8_t opcode)
+{
+    switch (opcode)
+    {
+        case 0x00: // BRK
+        case 0x20: // JSR
+        case 0x40: // RTI
+        case 0x4C: // JMP abs
+        case 0x58: // CLI
+        case 0x60: // RTS
+        case 0x6C: // JMP ind
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whether the instruction is translated, BRK, RTI, JMP (ind) and the illegal ops are left to
+// the interpreter along with absolute accesses of io registers and mapper ports. So are the
+// jumps back of loops short enough to be idle loops, the interpreter fast forwards those to
+// the next event instead of running them
+static bool JitIsNative(const JitCompiler *c, const JitInstr *instr)
+{
+    const System *system = c->system;
+
+    switch (instr->op)
+    {
+        case JIT_OP_NONE:
+            return false;
+        case JIT_OP_JMP:
+        case JIT_OP_BRANCH:
+        {
+            const uint16_t target = instr->op == JIT_OP_JMP ? JitAbsAddr(instr) : JitBranchTarget(instr);
+            return !system->skip_idle_loops || target > instr->pc || instr->pc - target > JIT_IDLE_LOOP_BYTES;
+        }
+        default:
+            break;
+    }
+
+    if (JitIsMemOp(instr) && instr->handler->addr_mode == Absolute)
+    {
+        const uint8_t page = instr->operand[1];
+        const JitAccess access = JitGetAccess(instr->op);
+
+        if ((access != JIT_WRITE && !system->read_pages[page].data) ||
+            (access != JIT_READ && !system->write_pages[page].data))
+            return false;
+    }
+
+    return true;
+}
+
+// Leaves the instruction for its stub if the last compare found no plain memory
+static void EmitDeopt(JitCompiler *c, const int cc)
+{
+    const int k = c->current;
+    assert(c->num_deopts[k] < JIT_MAX_DEOPTS);
+    c->deopts[k][c->num_deopts[k]++] = EmitJcc(&c->e, cc);
+}
+
+// slot is where the cpu is on the stack
+static void EmitLoadRegs(JitEmitter *e, const int32_t slot)
+{
+    EmitRM(e, 8, 0x8B, RAX, RSP, -1, slot);
+    EmitRM(e, 1, 0x0FB6, REG_A, RAX, -1, offsetof(Cpu, a));
+    EmitRM(e, 1, 0x0FB6, REG_X, RAX, -1, offsetof(Cpu, x));
+    EmitRM(e, 1, 0x0FB6, REG_Y, RAX, -1, offsetof(Cpu, y));
+    EmitRM(e, 1, 0x0FB6, REG_P, RAX, -1, offsetof(Cpu, status));
+}
+
+static void EmitStoreRegs(JitEmitter *e, const int32_t slot)
+{
+    EmitRM(e, 8, 0x8B, RAX, RSP, -1, slot);
+    EmitRM(e, 1, 0x88, REG_A, RAX, -1, offsetof(Cpu, a));
+    EmitRM(e, 1, 0x88, REG_X, RAX, -1, offsetof(Cpu, x));
+    EmitRM(e, 1, 0x88, REG_Y, RAX, -1, offsetof(Cpu, y));
+    EmitRM(e, 1, 0x88, REG_P, RAX, -1, offsetof(Cpu, status));
+}
+
+static void EmitEpilogue(JitEmitter *e)
+{
+    EmitAluImm8(e, 8, ALU_ADD, RSP, FRAME_SIZE);
+    EmitPop(e, R15);
+    EmitPop(e, R14);
+    EmitPop(e, R13);
+    EmitPop(e, R12);
+    EmitPop(e, RBP);
+    EmitPop(e, RBX);
+    Emit8(e, 0xC3);
+}
+
+// Leaves the block at the pc in edx with instrs run since it was entered, the code that does
+// it is shared by every exit and goes at the end of the block
+static void EmitExit(JitCompiler *c, const uint32_t instrs)
+{
+    EmitMovImm32(&c->e, RCX, instrs);
+    assert(c->num_exits < JIT_MAX_EXITS);
+    c->exits[c->num_exits++] = EmitJmp(&c->e);
+}
+
+// cpu_addr and bus_data are left the way the last access of the instruction leaves them
+static void EmitBusAddr(JitEmitter *e, const JitMem *mem)
+{
+    if (mem->fixed)
+    {
+        EmitRM(e, 2, 0xC7, 0, REG_SYSTEM, -1, offsetof(System, cpu_addr));
+        Emit16(e, mem->addr);
+    }
+    else
+    {
+        EmitRM(e, 2, 0x89, RAX, REG_SYSTEM, -1, offsetof(System, cpu_addr));
+    }
+}
+
+static void EmitBusAddrImm(JitEmitter *e, const uint16_t addr)
+{
+    const JitMem mem = { .fixed = true, .addr = addr };
+    EmitBusAddr(e, &mem);
+}
+
+static void EmitBusData(JitEmitter *e, const int reg)
+{
+    EmitRM(e, 1, 0x88, reg, REG_SYSTEM, -1, offsetof(System, bus_data));
+}
+
+static void EmitBusDataImm(JitEmitter *e, const uint8_t data)
+{
+    EmitRM(e, 1, 0xC6, 0, REG_SYSTEM, -1, offsetof(System, bus_data));
+    Emit8(e, data);
+}
+
+static void EmitAddCycles(JitEmitter *e, const uint8_t cycles)
+{
+    EmitAluImm8(e, 4, ALU_ADD, REG_CYCLES, cycles);
+}
+
+// n and z from the byte in reg, clobbers rcx
+static void EmitSetNZ(JitEmitter *e, const int reg)
+{
+    EmitMovImm64(e, RCX, (uintptr_t)jit_nz_flags);
+    EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~(FLAG_N_BIT | FLAG_Z_BIT));
+    EmitRM(e, 1, 0x0A, REG_P, RCX, reg, 0);
+}
+
+// c from the host carry (inverted for a compare's borrow), clobbers rax
+static void EmitSetC(JitEmitter *e, const int cc)
+{
+    EmitRR(e, 1, 0x0F90 | cc, 0, RAX);
+    EmitRR(e, 4, 0x0FB6, RAX, RAX);
+    EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~FLAG_C_BIT);
+    EmitRR(e, 4, 0x09, RAX, REG_P);
+}
+
+// Loads the address of a page's entry in read_pages or write_pages into reg, 0 if it isn't
+// plain memory. The page is in edx when page is -1
+static void EmitLoadPage(JitEmitter *e, const int reg, const bool write, const int page)
+{
+    const int32_t pages = write ? offsetof(System, write_pages) : offsetof(System, read_pages);
+
+    if (page >= 0)
+        EmitRM(e, 8, 0x8B, reg, REG_SYSTEM, -1, pages + page * (int32_t)sizeof(MemPage) + offsetof(MemPage, data));
+    else
+        EmitRM(e, 8, 0x8B, reg, REG_SYSTEM, RDX, pages + offsetof(MemPage, data));
+
+    EmitRR(e, 8, 0x85, reg, reg);
+}
+
+// edx = the page of the address in eax, scaled to index the page tables
+static void EmitPageIndex(JitEmitter *e)
+{
+    EmitRR(e, 4, 0x89, RAX, RDX);
+    EmitShiftImm(e, 5, RDX, MEM_PAGE_SHIFT);
+    EmitRR(e, 4, 0x69, RDX, RDX);
+    Emit32(e, sizeof(MemPage));
+}
+
+// A dummy read of a fixed page, it only has to be plain memory
+static void EmitCheckPage(JitCompiler *c, const uint8_t page)
+{
+    if (JitIsFixedRam(c->system, page))
+        return;
+
+    EmitRM(&c->e, 8, 0x83, ALU_CMP, REG_SYSTEM, -1,
+           offsetof(System, read_pages) + page * (int32_t)sizeof(MemPage) + offsetof(MemPage, data));
+    Emit8(&c->e, 0);
+    EmitDeopt(c, CC_Z);
+}
+
+// The pages of a fixed address, rcx to read from and rdi to write to
+static void EmitFixedPages(JitCompiler *c, const uint8_t page, const JitAccess access)
+{
+    JitEmitter *e = &c->e;
+    const System *system = c->system;
+
+    if (JitIsFixedRam(system, page))
+    {
+        if (access != JIT_WRITE)
+            EmitMovImm64(e, RCX, (uintptr_t)system->read_pages[page].data);
+        if (access != JIT_READ)
+            EmitMovImm64(e, RDI, (uintptr_t)system->write_pages[page].data);
+        return;
+    }
+
+    if (access != JIT_WRITE)
+    {
+        EmitLoadPage(e, RCX, false, page);
+        EmitDeopt(c, CC_Z);
+    }
+    if (access != JIT_READ)
+    {
+        EmitLoadPage(e, RDI, true, page);
+        EmitDeopt(c, CC_Z);
+    }
+}
+
+// The pages of the address in eax, with its offset in the page put in esi
+static void EmitDynamicPages(JitCompiler *c, const JitAccess access, JitMem *mem)
+{
+    JitEmitter *e = &c->e;
+
+    EmitPageIndex(e);
+    if (access != JIT_WRITE)
+    {
+        EmitLoadPage(e, RCX, false, -1);
+        EmitDeopt(c, CC_Z);
+    }
+    if (access != JIT_READ)
+    {
+        EmitLoadPage(e, RDI, true, -1);
+        EmitDeopt(c, CC_Z);
+    }
+
+    EmitRR(e, 1, 0x0FB6, RSI, RAX);
+    mem->index = RSI;
+}
+
+// Works out where the operand is, everything the interpreter reads on the way (pointers, dummy
+// reads of the wrong page) is checked to be plain memory first. Any check that fails leaves
+// for the stub before anything has changed, the page cross cycle is only counted after them
+static void EmitOperand(JitCompiler *c, const JitInstr *instr, const JitAccess access, JitMem *mem)
+{
+    JitEmitter *e = &c->e;
+    const AddressingMode mode = instr->handler->addr_mode;
+    const uint8_t low = instr->operand[0];
+    const uint8_t *ram = c->system->sys_ram;
+    const bool page_cross_cycle = JitHasPageCrossCycle(instr);
+
+    *mem = (JitMem){ .index = -1 };
+
+    switch (mode)
+    {
+        case ZeroPage:
+            mem->fixed = true;
+            mem->addr = low;
+            mem->disp = low;
+            EmitMovImm64(e, RCX, (uintptr_t)ram);
+            EmitRR(e, 8, 0x89, RCX, RDI);
+            break;
+        case ZeroPageX:
+        case ZeroPageY:
+            EmitRM(e, 4, 0x8D, RAX, mode == ZeroPageX ? REG_X : REG_Y, -1, low);
+            EmitRR(e, 1, 0x0FB6, RAX, RAX);
+            // Not eax, the flags of a read-modify-write clobber it before the write
+            EmitRR(e, 4, 0x89, RAX, RSI);
+            EmitMovImm64(e, RCX, (uintptr_t)ram);
+            EmitRR(e, 8, 0x89, RCX, RDI);
+            mem->index = RSI;
+            break;
+        case Absolute:
+            mem->fixed = true;
+            mem->addr = JitAbsAddr(instr);
+            mem->disp = low;
+            EmitFixedPages(c, instr->operand[1], access);
+            break;
+        case AbsoluteX:
+        case AbsoluteY:
+        {
+            const int index = mode == AbsoluteX ? REG_X : REG_Y;
+            // The dummy read before the page is fixed up
+            EmitCheckPage(c, instr->operand[1]);
+            EmitRM(e, 4, 0x8D, RAX, index, -1, JitAbsAddr(instr));
+            EmitRR(e, 4, 0x0FB7, RAX, RAX);
+            EmitDynamicPages(c, access, mem);
+
+            if (page_cross_cycle)
+            {
+                EmitRM(e, 4, 0x8D, R9, index, -1, low);
+                EmitShiftImm(e, 5, R9, 8);
+                EmitRR(e, 4, 0x01, R9, REG_CYCLES);
+            }
+            break;
+        }
+        case IndirectX:
+            EmitMovImm64(e, RCX, (uintptr_t)ram);
+            EmitRM(e, 4, 0x8D, RSI, REG_X, -1, low);
+            EmitRR(e, 1, 0x0FB6, RSI, RSI);
+            EmitRM(e, 1, 0x0FB6, RAX, RCX, RSI, 0);
+            EmitRM(e, 4, 0x8D, RSI, RSI, -1, 1);
+            EmitRR(e, 1, 0x0FB6, RSI, RSI);
+            EmitRM(e, 1, 0x0FB6, RDX, RCX, RSI, 0);
+            EmitShiftImm(e, 4, RDX, 8);
+            EmitRR(e, 4, 0x09, RDX, RAX);
+            EmitDynamicPages(c, access, mem);
+            break;
+        case IndirectY:
+            EmitMovImm64(e, RCX, (uintptr_t)ram);
+            EmitRM(e, 1, 0x0FB6, RAX, RCX, -1, low);
+            EmitRM(e, 1, 0x0FB6, RDX, RCX, -1, (uint8_t)(low + 1));
+            EmitShiftImm(e, 4, RDX, 8);
+            EmitRR(e, 4, 0x09, RDX, RAX);
+            // The dummy read, on the page of the pointer before y is added
+            EmitPageIndex(e);
+            EmitRM(e, 8, 0x83, ALU_CMP, REG_SYSTEM, RDX, offsetof(System, read_pages) + offsetof(MemPage, data));
+            Emit8(e, 0);
+            EmitDeopt(c, CC_Z);
+            EmitRR(e, 1, 0x0FB6, R9, RAX);
+            EmitRR(e, 4, 0x01, REG_Y, R9);
+            EmitShiftImm(e, 5, R9, 8);
+            EmitRR(e, 4, 0x01, REG_Y, RAX);
+            EmitRR(e, 4, 0x0FB7, RAX, RAX);
+            EmitDynamicPages(c, access, mem);
+
+            if (page_cross_cycle)
+                EmitRR(e, 4, 0x01, R9, REG_CYCLES);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+static int JitOpReg(const JitOp op)
+{
+    switch (op)
+    {
+        case JIT_OP_LDX: case JIT_OP_STX: case JIT_OP_CPX:
+            return REG_X;
+        case JIT_OP_LDY: case JIT_OP_STY: case JIT_OP_CPY:
+            return REG_Y;
+        default:
+            return REG_A;
+    }
+}
+
+// The value read is in edx
+static void EmitReadOp(JitEmitter *e, const JitOp op)
+{
+    const int reg = JitOpReg(op);
+
+    switch (op)
+    {
+        case JIT_OP_LDA:
+        case JIT_OP_LDX:
+        case JIT_OP_LDY:
+            EmitRR(e, 4, 0x89, RDX, reg);
+            EmitSetNZ(e, reg);
+            break;
+        case JIT_OP_AND:
+            EmitRR(e, 1, 0x20, RDX, REG_A);
+            EmitSetNZ(e, REG_A);
+            break;
+        case JIT_OP_ORA:
+            EmitRR(e, 1, 0x08, RDX, REG_A);
+            EmitSetNZ(e, REG_A);
+            break;
+        case JIT_OP_EOR:
+            EmitRR(e, 1, 0x30, RDX, REG_A);
+            EmitSetNZ(e, REG_A);
+            break;
+        case JIT_OP_ADC:
+        case JIT_OP_SBC:
+            // mov r8d, edx so bus_data still gets the value read, not its complement
+            EmitRR(e, 4, 0x89, RDX, R8);
+            if (op == JIT_OP_SBC)
+                EmitRR(e, 1, 0xF6, 2, R8);
+            // bt ebx, 0 puts the 6502 carry in the host one
+            EmitRR(e, 4, 0x0FBA, 4, REG_P);
+            Emit8(e, 0);
+            EmitRR(e, 1, 0x10, R8, REG_A);
+            EmitRR(e, 1, 0x0F90 | CC_C, 0, RAX);
+            EmitRR(e, 1, 0x0F90 | CC_O, 0, RCX);
+            EmitRR(e, 4, 0x0FB6, RAX, RAX);
+            EmitRR(e, 4, 0x0FB6, RCX, RCX);
+            EmitShiftImm(e, 4, RCX, 6);
+            EmitRR(e, 4, 0x09, RCX, RAX);
+            EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~(FLAG_C_BIT | FLAG_V_BIT));
+            EmitRR(e, 4, 0x09, RAX, REG_P);
+            EmitSetNZ(e, REG_A);
+            break;
+        case JIT_OP_CMP:
+        case JIT_OP_CPX:
+        case JIT_OP_CPY:
+            // The carry is set when there's no borrow, reg >= operand
+            EmitRR(e, 4, 0x89, reg, R8);
+            EmitRR(e, 1, 0x28, RDX, R8);
+            EmitSetC(e, CC_NC);
+            EmitSetNZ(e, R8);
+            break;
+        case JIT_OP_BIT:
+            // z from a & operand, n and v straight from bits 7 and 6 of the operand
+            EmitRR(e, 1, 0x84, REG_A, RDX);
+            EmitRR(e, 1, 0x0F90 | CC_Z, 0, RAX);
+            EmitRR(e, 4, 0x0FB6, RAX, RAX);
+            EmitRR(e, 4, 0x01, RAX, RAX);
+            EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~(FLAG_N_BIT | FLAG_V_BIT | FLAG_Z_BIT));
+            EmitRR(e, 4, 0x09, RAX, REG_P);
+            EmitRR(e, 4, 0x89, RDX, RCX);
+            EmitAluImm8(e, 4, ALU_AND, RCX, FLAG_N_BIT | FLAG_V_BIT);
+            EmitRR(e, 4, 0x09, RCX, REG_P);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+// Shifts, rotates, increments and decrements of the byte in reg
+static void EmitModifyOp(JitEmitter *e, const JitOp op, const int reg)
+{
+    switch (op)
+    {
+        case JIT_OP_INC:
+        case JIT_OP_DEC:
+            EmitRR(e, 1, 0xFE, op == JIT_OP_DEC, reg);
+            break;
+        case JIT_OP_ASL:
+        case JIT_OP_LSR:
+        case JIT_OP_ROL:
+        case JIT_OP_ROR:
+        {
+            // rcl, rcr, shl, shr by one, the rotates go through the 6502 carry
+            static const int ext[] = { [JIT_OP_ROL] = 2, [JIT_OP_ROR] = 3, [JIT_OP_ASL] = 4, [JIT_OP_LSR] = 5 };
+            if (op == JIT_OP_ROL || op == JIT_OP_ROR)
+            {
+                EmitRR(e, 4, 0x0FBA, 4, REG_P);
+                Emit8(e, 0);
+            }
+            EmitRR(e, 1, 0xD0, ext[op], reg);
+            EmitSetC(e, CC_C);
+            break;
+        }
+        default:
+            assert(false);
+            break;
+    }
+
+    EmitSetNZ(e, reg);
+}
+
+static void EmitMemInstr(JitCompiler *c, const JitInstr *instr)
+{
+    JitEmitter *e = &c->e;
+    const JitAccess access = JitGetAccess(instr->op);
+    JitMem mem;
+
+    if (instr->handler->addr_mode == Immediate)
+    {
+        EmitMovImm32(e, RDX, instr->operand[0]);
+        EmitReadOp(e, instr->op);
+        EmitBusAddrImm(e, instr->pc + 1);
+        EmitBusDataImm(e, instr->operand[0]);
+        EmitAddCycles(e, 2);
+        return;
+    }
+
+    EmitOperand(c, instr, access, &mem);
+    EmitBusAddr(e, &mem);
+
+    switch (access)
+    {
+        case JIT_READ:
+            EmitRM(e, 1, 0x0FB6, RDX, RCX, mem.index, mem.disp);
+            EmitReadOp(e, instr->op);
+            EmitBusData(e, RDX);
+            break;
+        case JIT_WRITE:
+        {
+            const int reg = JitOpReg(instr->op);
+            EmitRM(e, 1, 0x88, reg, RDI, mem.index, mem.disp);
+            EmitBusData(e, reg);
+            break;
+        }
+        case JIT_MODIFY:
+            // The dummy write of the old value doesn't do anything to plain memory
+            EmitRM(e, 1, 0x0FB6, RDX, RCX, mem.index, mem.disp);
+            // EmitSetNZ clobbers rcx, the offset can't be in it
+            EmitModifyOp(e, instr->op, RDX);
+            EmitRM(e, 1, 0x88, RDX, RDI, mem.index, mem.disp);
+            EmitBusData(e, RDX);
+            break;
+    }
+
+    // The page cross cycle was counted with the operand
+    EmitAddCycles(e, instr->cycles - JitHasPageCrossCycle(instr));
+}
+
+// Implied and accumulator instructions, the second cycle is a dummy read of the next byte
+static void EmitImpliedInstr(JitCompiler *c, const JitInstr *instr)
+{
+    JitEmitter *e = &c->e;
+
+    switch (instr->op)
+    {
+        case JIT_OP_INX: EmitModifyOp(e, JIT_OP_INC, REG_X); break;
+        case JIT_OP_INY: EmitModifyOp(e, JIT_OP_INC, REG_Y); break;
+        case JIT_OP_DEX: EmitModifyOp(e, JIT_OP_DEC, REG_X); break;
+        case JIT_OP_DEY: EmitModifyOp(e, JIT_OP_DEC, REG_Y); break;
+        case JIT_OP_INC:
+        case JIT_OP_DEC:
+        case JIT_OP_ASL:
+        case JIT_OP_LSR:
+        case JIT_OP_ROL:
+        case JIT_OP_ROR:
+            EmitModifyOp(e, instr->op, REG_A);
+            break;
+        case JIT_OP_TAX:
+            EmitRR(e, 4, 0x89, REG_A, REG_X);
+            EmitSetNZ(e, REG_X);
+            break;
+        case JIT_OP_TAY:
+            EmitRR(e, 4, 0x89, REG_A, REG_Y);
+            EmitSetNZ(e, REG_Y);
+            break;
+        case JIT_OP_TXA:
+            EmitRR(e, 4, 0x89, REG_X, REG_A);
+            EmitSetNZ(e, REG_A);
+            break;
+        case JIT_OP_TYA:
+            EmitRR(e, 4, 0x89, REG_Y, REG_A);
+            EmitSetNZ(e, REG_A);
+            break;
+        case JIT_OP_TSX:
+            EmitRM(e, 8, 0x8B, RAX, RSP, -1, SLOT_CPU);
+            EmitRM(e, 1, 0x0FB6, REG_X, RAX, -1, offsetof(Cpu, sp));
+            EmitSetNZ(e, REG_X);
+            break;
+        case JIT_OP_TXS:
+            EmitRM(e, 8, 0x8B, RAX, RSP, -1, SLOT_CPU);
+            EmitRM(e, 1, 0x88, REG_X, RAX, -1, offsetof(Cpu, sp));
+            break;
+        case JIT_OP_CLC: EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~FLAG_C_BIT); break;
+        case JIT_OP_SEC: EmitAluImm8(e, 4, ALU_OR, REG_P, FLAG_C_BIT); break;
+        case JIT_OP_CLI: EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~FLAG_I_BIT); break;
+        case JIT_OP_SEI: EmitAluImm8(e, 4, ALU_OR, REG_P, FLAG_I_BIT); break;
+        case JIT_OP_CLV: EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~FLAG_V_BIT); break;
+        case JIT_OP_CLD: EmitAluImm8(e, 4, ALU_AND, REG_P, (uint8_t)~FLAG_D_BIT); break;
+        case JIT_OP_SED: EmitAluImm8(e, 4, ALU_OR, REG_P, FLAG_D_BIT); break;
+        case JIT_OP_NOP: break;
+        default:
+            assert(false);
+            break;
+    }
+
+    EmitBusAddrImm(e, instr->pc + 1);
+    EmitBusDataImm(e, c->page[(instr->pc + 1) & 0xFF]);
+    EmitAddCycles(e, 2);
+}
+
+// rcx = sp and rdx = the stack page
+static void EmitLoadStack(JitCompiler *c)
+{
+    JitEmitter *e = &c->e;
+    EmitRM(e, 8, 0x8B, RAX, RSP, -1, SLOT_CPU);
+    EmitRM(e, 1, 0x0FB6, RCX, RAX, -1, offsetof(Cpu, sp));
+    EmitMovImm64(e, RDX, (uintptr_t)c->system->sys_ram + STACK_START);
+}
+
+// cpu_addr = the stack address sp in rcx points at
+static void EmitStackAddr(JitEmitter *e)
+{
+    EmitRM(e, 4, 0x8D, RSI, RCX, -1, STACK_START);
+    EmitRM(e, 2, 0x89, RSI, REG_SYSTEM, -1, offsetof(System, cpu_addr));
+}
+
+static void EmitStackInstr(JitCompiler *c, const int k)
+{
+    JitEmitter *e = &c->e;
+    const JitInstr *instr = &c->instrs[k];
+    EmitLoadStack(c);
+
+    switch (instr->op)
+    {
+        case JIT_OP_PHA:
+        case JIT_OP_PHP:
+        {
+            int reg = REG_A;
+            if (instr->op == JIT_OP_PHP)
+            {
+                // Pushed with b and the unused bit set
+                EmitRR(e, 4, 0x89, REG_P, R8);
+                EmitAluImm8(e, 4, ALU_OR, R8, 0x30);
+                reg = R8;
+            }
+            EmitRM(e, 1, 0x88, reg, RDX, RCX, 0);
+            EmitBusData(e, reg);
+            EmitStackAddr(e);
+            EmitRM(e, 1, 0xFE, 1, RAX, -1, offsetof(Cpu, sp));
+            EmitAddCycles(e, 3);
+            break;
+        }
+        case JIT_OP_PLA:
+            EmitRR(e, 1, 0xFE, 0, RCX);
+            EmitRM(e, 1, 0x88, RCX, RAX, -1, offsetof(Cpu, sp));
+            EmitRM(e, 1, 0x0FB6, REG_A, RDX, RCX, 0);
+            EmitBusData(e, REG_A);
+            EmitStackAddr(e);
+            EmitSetNZ(e, REG_A);
+            EmitAddCycles(e, 4);
+            break;
+        case JIT_OP_PLP:
+        {
+            EmitRR(e, 1, 0xFE, 0, RCX);
+            EmitRM(e, 1, 0x88, RCX, RAX, -1, offsetof(Cpu, sp));
+            EmitRM(e, 1, 0x0FB6, R8, RDX, RCX, 0);
+            EmitBusData(e, R8);
+            EmitStackAddr(e);
+            EmitAddCycles(e, 4);
+
+            // b and the unused bit are kept
+            EmitRR(e, 4, 0x89, REG_P, RAX);
+            EmitAluImm8(e, 4, ALU_AND, R8, 0xCF);
+            EmitAluImm8(e, 4, ALU_AND, REG_P, 0x30);
+            EmitRR(e, 4, 0x09, R8, REG_P);
+
+            // Clearing i can let an irq through, the block is left for it like after CLI
+            EmitRR(e, 1, 0xF6, 0, RAX);
+            Emit8(e, FLAG_I_BIT);
+            uint8_t *was_clear = EmitJcc(e, CC_Z);
+            EmitRR(e, 1, 0xF6, 0, REG_P);
+            Emit8(e, FLAG_I_BIT);
+            uint8_t *still_set = EmitJcc(e, CC_NZ);
+            EmitMovImm32(e, RDX, (uint16_t)(instr->pc + 1));
+            EmitExit(c, k + 1);
+            PatchJump(was_clear, e->pos);
+            PatchJump(still_set, e->pos);
+            break;
+        }
+        default:
+            assert(false);
+            break;
+    }
+}
+
+// Index of the instruction at pc in the block, -1 if there isn't one
+static int JitFindInstr(const JitCompiler *c, const uint16_t pc)
+{
+    for (int k = 0; k < c->num_instrs; k++)
+    {
+        if (c->instrs[k].pc == pc)
+            return k;
+    }
+
+    return -1;
+}
+
+// Jumps back to instruction j go round again natively while the budget lasts. The exits count
+// instructions from the start of the block by index, so the ones already run are added now
+static void EmitLoop(JitCompiler *c, const int k, const int j)
+{
+    JitEmitter *e = &c->e;
+
+    EmitRM(e, 8, 0x8B, RAX, RSP, -1, SLOT_CPU);
+    EmitRM(e, 8, 0x83, ALU_ADD, RAX, -1, offsetof(Cpu, instructions));
+    Emit8(e, k + 1 - j);
+    EmitRM(e, 8, 0x8D, RAX, REG_CYCLES, -1, c->remaining[j]);
+    EmitRM(e, 8, 0x3B, RAX, RSP, -1, SLOT_BUDGET);
+    uint8_t *leave = EmitJcc(e, CC_A);
+    PatchJump(EmitJmp(e), c->resume[j]);
+    PatchJump(leave, e->pos);
+    EmitMovImm32(e, RDX, c->instrs[j].pc);
+    EmitExit(c, j);
+}
+
+// Jumps forward to instruction j, the ones skipped over are taken off the count
+static void EmitSkip(JitCompiler *c, const int k, const int j)
+{
+    JitEmitter *e = &c->e;
+
+    if (j > k + 1)
+    {
+        EmitRM(e, 8, 0x8B, RAX, RSP, -1, SLOT_CPU);
+        EmitRM(e, 8, 0x83, ALU_SUB, RAX, -1, offsetof(Cpu, instructions));
+        Emit8(e, j - k - 1);
+    }
+
+    c->skips[c->num_skips] = EmitJmp(e);
+    c->skip_targets[c->num_skips++] = j;
+}
+
+static void EmitJumpTo(JitCompiler *c, const int k, const uint16_t target)
+{
+    const int j = JitFindInstr(c, target);
+
+    if (j < 0)
+    {
+        EmitMovImm32(&c->e, RDX, target);
+        EmitExit(c, k + 1);
+    }
+    else if (j <= k)
+    {
+        EmitLoop(c, k, j);
+    }
+    else
+    {
+        EmitSkip(c, k, j);
+    }
+}
+
+// Not taken it carries on with the next instruction
+static void EmitBranch(JitCompiler *c, const int k)
+{
+    static const struct { uint8_t flag; bool set; } conditions[8] =
+    {
+        { FLAG_N_BIT, false }, { FLAG_N_BIT, true }, // BPL, BMI
+        { FLAG_V_BIT, false }, { FLAG_V_BIT, true }, // BVC, BVS
+        { FLAG_C_BIT, false }, { FLAG_C_BIT, true }, // BCC, BCS
+        { FLAG_Z_BIT, false }, { FLAG_Z_BIT, true }, // BNE, BEQ
+    };
+
+    JitEmitter *e = &c->e;
+    const JitInstr *instr = &c->instrs[k];
+    const uint16_t target = JitBranchTarget(instr);
+    const uint8_t opcode = c->page[instr->pc & 0xFF];
+    const uint16_t next_pc = instr->pc + 2;
+
+    // test bl, flag
+    EmitRR(e, 1, 0xF6, 0, REG_P);
+    Emit8(e, conditions[opcode >> 5].flag);
+    uint8_t *not_taken = EmitJcc(e, conditions[opcode >> 5].set ? CC_Z : CC_NZ);
+
+    if ((target ^ next_pc) & 0xFF00)
+    {
+        // Dummy reads of the target on the wrong page and then the right one
+        EmitCheckPage(c, (target + PAGE_SIZE) >> 8);
+        EmitLoadPage(e, RAX, false, target >> 8);
+        EmitDeopt(c, CC_Z);
+        EmitRM(e, 1, 0x0FB6, RDX, RAX, -1, target & 0xFF);
+        EmitBusData(e, RDX);
+        EmitBusAddrImm(e, target);
+        EmitAddCycles(e, 4);
+    }
+    else
+    {
+        EmitBusAddrImm(e, next_pc);
+        EmitBusDataImm(e, c->page[next_pc & 0xFF]);
+        EmitAddCycles(e, 3);
+    }
+    EmitJumpTo(c, k, target);
+
+    PatchJump(not_taken, e->pos);
+    EmitBusAddrImm(e, instr->pc + 1);
+    EmitBusDataImm(e, instr->operand[0]);
+    EmitAddCycles(e, 2);
+}
+
+static void EmitJsr(JitCompiler *c, const int k)
+{
+    JitEmitter *e = &c->e;
+    const JitInstr *instr = &c->instrs[k];
+    const uint16_t ret = instr->pc + 2;
+
+    EmitLoadStack(c);
+    EmitRM(e, 1, 0xC6, 0, RDX, RCX, 0);
+    Emit8(e, ret >> 8);
+    EmitRR(e, 1, 0xFE, 1, RCX);
+    EmitRM(e, 1, 0xC6, 0, RDX, RCX, 0);
+    Emit8(e, ret & 0xFF);
+    EmitRR(e, 1, 0xFE, 1, RCX);
+    EmitRM(e, 1, 0x88, RCX, RAX, -1, offsetof(Cpu, sp));
+    // The last cycle fetches the high byte of the address
+    EmitBusAddrImm(e, ret);
+    EmitBusDataImm(e, instr->operand[1]);
+    EmitAddCycles(e, 6);
+    EmitMovImm32(e, RDX, JitAbsAddr(instr));
+    EmitExit(c, k + 1);
+}
+
+static void EmitRts(JitCompiler *c, const int k)
+{
+    JitEmitter *e = &c->e;
+
+    EmitLoadStack(c);
+    EmitRR(e, 1, 0xFE, 0, RCX);
+    EmitRM(e, 1, 0x0FB6, RSI, RDX, RCX, 0);
+    EmitRR(e, 1, 0xFE, 0, RCX);
+    EmitRM(e, 1, 0x0FB6, RDI, RDX, RCX, 0);
+    EmitShiftImm(e, 4, RDI, 8);
+    EmitRR(e, 4, 0x09, RDI, RSI);
+
+    // The dummy read of the return address before it's incremented
+    EmitRR(e, 4, 0x89, RSI, RDX);
+    EmitShiftImm(e, 5, RDX, MEM_PAGE_SHIFT);
+    EmitRR(e, 4, 0x69, RDX, RDX);
+    Emit32(e, sizeof(MemPage));
+    EmitLoadPage(e, R8, false, -1);
+    EmitDeopt(c, CC_Z);
+
+    EmitRM(e, 1, 0x88, RCX, RAX, -1, offsetof(Cpu, sp));
+    EmitRR(e, 1, 0x0FB6, RDI, RSI);
+    EmitRM(e, 1, 0x0FB6, RDX, R8, RDI, 0);
+    EmitBusData(e, RDX);
+    EmitRM(e, 2, 0x89, RSI, REG_SYSTEM, -1, offsetof(System, cpu_addr));
+    EmitAddCycles(e, 6);
+    EmitRM(e, 4, 0x8D, RDX, RSI, -1, 1);
+    EmitRR(e, 4, 0x0FB7, RDX, RDX);
+    EmitExit(c, k + 1);
+}
+
+// Hands the instruction over to the interpreter, then carries on with the block after it if
+// nothing stops that
+static void EmitStub(JitCompiler *c, const int k)
+{
+    JitEmitter *e = &c->e;
+    const JitInstr *instr = &c->instrs[k];
+
+    EmitMovImm32(e, RDX, instr->pc);
+    EmitMovImm32(e, RCX, k + 1);
+    EmitMovImm32(e, R8, (uint16_t)(instr->pc + instr->handler->bytes));
+    EmitMovImm32(e, R9, c->remaining[k + 1]);
+    c->interprets[c->num_interprets++] = EmitCallRel(e);
+    PatchJump(EmitJmp(e), c->resume[k + 1]);
+}
+
+// What every exit jumps to, the cycles are ticked and the block is left at the pc in edx
+static void EmitExitTail(JitCompiler *c)
+{
+    JitEmitter *e = &c->e;
+
+    for (int i = 0; i < c->num_exits; i++)
+    {
+        PatchJump(c->exits[i], e->pos);
+    }
+
+    EmitStoreRegs(e, SLOT_CPU);
+    EmitRM(e, 8, 0x8B, RDI, RSP, -1, SLOT_CPU);
+    EmitRR(e, 8, 0x89, REG_CYCLES, RSI);
+    EmitCall(e, (uintptr_t)JitExit);
+    EmitEpilogue(e);
+}
+
+// What every stub calls with the arguments of JitInterpret after the first two. It returns to
+// the stub with the new budget if the block carries on, otherwise it leaves the block
+static void EmitInterpretTail(JitCompiler *c)
+{
+    JitEmitter *e = &c->e;
+
+    for (int i = 0; i < c->num_interprets; i++)
+    {
+        PatchJump(c->interprets[i], e->pos);
+    }
+
+    // The stub's return address is on top of the frame, and under it the stack has to be
+    // 16 byte aligned for the call
+    EmitStoreRegs(e, SLOT_CPU + 8);
+    EmitRM(e, 8, 0x8B, RDI, RSP, -1, SLOT_CPU + 8);
+    EmitRR(e, 8, 0x89, REG_CYCLES, RSI);
+    EmitAluImm8(e, 8, ALU_SUB, RSP, 8);
+    EmitCall(e, (uintptr_t)JitInterpret);
+    EmitAluImm8(e, 8, ALU_ADD, RSP, 8);
+    EmitRR(e, 8, 0x85, RAX, RAX);
+    uint8_t *leave = EmitJcc(e, CC_Z);
+
+    EmitRM(e, 8, 0x89, RAX, RSP, -1, SLOT_BUDGET + 8);
+    EmitLoadRegs(e, SLOT_CPU + 8);
+    EmitRR(e, 4, 0x31, REG_CYCLES, REG_CYCLES);
+    Emit8(e, 0xC3);
+
+    PatchJump(leave, e->pos);
+    EmitAluImm8(e, 8, ALU_ADD, RSP, 8);
+    EmitEpilogue(e);
+}
+
+static void JitFlush(Jit *jit)
+{
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    jit->code_used = 0;
+}
+
+// Only the pages being written are made writable, and never while they're executable
+static bool JitProtect(Jit *jit, uint8_t *start, const size_t size, const int prot)
+{
+    const uintptr_t mask = jit->page_size - 1;
+    uint8_t *first = (uint8_t *)((uintptr_t)start & ~mask);
+    uint8_t *last = (uint8_t *)(((uintptr_t)start + size + mask) & ~mask);
+
+    if (mprotect(first, last - first, prot) != 0)
+    {
+        printf("Failed to change the protection of the jit's code\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool JitDecode(JitCompiler *c, const uint16_t start_pc)
+{
+    uint16_t pc = start_pc;
+
+    // Blocks stay in the page they start in, so every byte of them is from c->page
+    while (c->num_instrs < JIT_MAX_BLOCK_INSTRS && (pc & 0xFF) <= PAGE_SIZE - 3)
+    {
+        const uint8_t opcode = c->page[pc & 0xFF];
+        JitInstr *instr = &c->instrs[c->num_instrs++];
+
+        instr->handler = CPU_GetOpcode(opcode);
+        instr->op = JitGetOp(instr->handler);
+        instr->pc = pc;
+        instr->operand[0] = c->page[(pc + 1) & 0xFF];
+        instr->operand[1] = c->page[(pc + 2) & 0xFF];
+        instr->cycles = JitIsNative(c, instr) ? JitMaxCycles(instr) : 0;
+
+        if (JitEndsBlock(opcode))
+            break;
+
+        pc += instr->handler->bytes;
+    }
+
+    if (c->num_instrs == 0)
+        return false;
+
+    // Branches forward in the block can carry on either way, jumps back are checked against
+    // the budget each time round
+    c->remaining[c->num_instrs] = 0;
+    for (int k = c->num_instrs - 1; k >= 0; k--)
+    {
+        const JitInstr *instr = &c->instrs[k];
+        uint32_t next = c->remaining[k + 1];
+
+        if (instr->op == JIT_OP_BRANCH)
+        {
+            const int j = JitFindInstr(c, JitBranchTarget(instr));
+            if (j > k)
+                next = MAX(next, c->remaining[j]);
+        }
+
+        c->remaining[k] = instr->cycles ? instr->cycles + next : 0;
+    }
+
+    return true;
+}
+
+// Each instruction's registers, flags and memory accesses are done inline with its operands
+// resolved at compile time wherever they can be. The block only runs when the budget covers
+// all of it, which means no event, interrupt or dma can happen in it, so the cycles are only
+// counted and ticked in one go when the block is left. Branches within the block and loops
+// back in it stay native, loops check the budget each time round. What can't be done natively
+// (io registers, mapper ports, BRK and the like) goes to a stub that ticks the cycles so far
+// and runs the instruction through the interpreter, then picks the block back up
+static JitBlockFn JitCompile(Jit *jit, Cpu *cpu, uint32_t *cycles)
+{
+    System *system = cpu->system;
+    JitCompiler compiler = { 0 };
+    JitCompiler *c = &compiler;
+
+    c->system = system;
+    c->page = system->read_pages[cpu->pc >> MEM_PAGE_SHIFT].data;
+
+    // The zero page and the stack are accessed straight from system ram
+    if (!JitIsFixedRam(system, 0) || !JitIsFixedRam(system, 1) ||
+        system->read_pages[0].data != system->sys_ram || system->read_pages[1].data != system->sys_ram + STACK_START)
+        return NULL;
+
+    if (!JitDecode(c, cpu->pc))
+        return NULL;
+
+    if (jit->code_used + JIT_BLOCK_CODE_SIZE > JIT_CODE_SIZE)
+        JitFlush(jit);
+
+    uint8_t *start = jit->code + jit->code_used;
+    if (!JitProtect(jit, start, JIT_BLOCK_CODE_SIZE, PROT_READ | PROT_WRITE))
+        return NULL;
+
+    JitEmitter *e = &c->e;
+    e->pos = start;
+
+    EmitPush(e, RBX);
+    EmitPush(e, RBP);
+    EmitPush(e, R12);
+    EmitPush(e, R13);
+    EmitPush(e, R14);
+    EmitPush(e, R15);
+    EmitAluImm8(e, 8, ALU_SUB, RSP, FRAME_SIZE);
+    EmitRM(e, 8, 0x89, RDI, RSP, -1, SLOT_CPU);
+    EmitRM(e, 8, 0x89, RSI, RSP, -1, SLOT_BUDGET);
+    EmitRM(e, 8, 0x8B, REG_SYSTEM, RDI, -1, offsetof(Cpu, system));
+    EmitLoadRegs(e, SLOT_CPU);
+    EmitRR(e, 4, 0x31, REG_CYCLES, REG_CYCLES);
+
+    for (int k = 0; k < c->num_instrs; k++)
+    {
+        const JitInstr *instr = &c->instrs[k];
+        c->current = k;
+        c->resume[k] = e->pos;
+
+        if (!instr->cycles)
+        {
+            c->deopts[k][c->num_deopts[k]++] = EmitJmp(e);
+            continue;
+        }
+
+        switch (instr->op)
+        {
+            case JIT_OP_BRANCH: EmitBranch(c, k); break;
+            case JIT_OP_JSR: EmitJsr(c, k); break;
+            case JIT_OP_RTS: EmitRts(c, k); break;
+            case JIT_OP_JMP:
+                EmitBusAddrImm(e, instr->pc + 2);
+                EmitBusDataImm(e, instr->operand[1]);
+                EmitAddCycles(e, 3);
+                EmitJumpTo(c, k, JitAbsAddr(instr));
+                break;
+            case JIT_OP_PHA:
+            case JIT_OP_PHP:
+            case JIT_OP_PLA:
+            case JIT_OP_PLP:
+                EmitStackInstr(c, k);
+                break;
+            default:
+                if (JitIsMemOp(instr))
+                    EmitMemInstr(c, instr);
+                else
+                    EmitImpliedInstr(c, instr);
+                break;
+        }
+    }
+
+    const JitInstr *last = &c->instrs[c->num_instrs - 1];
+    c->resume[c->num_instrs] = e->pos;
+    EmitMovImm32(e, RDX, (uint16_t)(last->pc + last->handler->bytes));
+    EmitExit(c, c->num_instrs);
+
+    for (int i = 0; i < c->num_skips; i++)
+    {
+        PatchJump(c->skips[i], c->resume[c->skip_targets[i]]);
+    }
+
+    for (int k = 0; k < c->num_instrs; k++)
+    {
+        if (!c->num_deopts[k])
+            continue;
+
+        for (int i = 0; i < c->num_deopts[k]; i++)
+        {
+            PatchJump(c->deopts[k][i], e->pos);
+        }
+        EmitStub(c, k);
+    }
+    EmitExitTail(c);
+    EmitInterpretTail(c);
+
+    assert(e->pos <= start + JIT_BLOCK_CODE_SIZE);
+    __builtin___clear_cache((char *)start, (char *)e->pos);
+    if (!JitProtect(jit, start, JIT_BLOCK_CODE_SIZE, PROT_READ | PROT_EXEC))
+        return NULL;
+
+    jit->code_used += e->pos - start;
+    // Even a block that starts with a stub needs some budget, there's no interrupt pending then
+    *cycles = MAX(c->remaining[0], 1);
+
+    // Data to function pointer casts aren't allowed in iso c, same trick as dlsym
+    JitBlockFn fn;
+    memcpy(&fn, &start, sizeof(fn));
+    return fn;
+}
+
+Jit *JIT_Create(void)
+{
+    Jit *jit = calloc(1, sizeof(*jit));
+    if (jit == NULL)
+    {
+        printf("Failed to allocate the jit\n");
+        return NULL;
+    }
+
+    // Mapped writable only, JitCompile flips the pages it writes to executable once it's done
+    void *code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        printf("Failed to map memory for the jit's code\n");
+        free(jit);
+        return NULL;
+    }
+
+    jit->code = code;
+    jit->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    return jit;
+}
+
+void JIT_Destroy(Jit *jit)
+{
+    if (jit == NULL)
+        return;
+
+    munmap(jit->code, JIT_CODE_SIZE);
+    free(jit);
+}
+
+// Runs the compiled block at pc, returns false if there isn't one (yet) or there isn't enough
+// budget to run it and the interpreter has to run the next instruction
+bool JIT_Run(Jit *jit, Cpu *cpu)
+{
+    System *system = cpu->system;
+    const PrgRom *rom = &system->cart->prg_rom;
+    const uint8_t *page = system->read_pages[cpu->pc >> MEM_PAGE_SHIFT].data;
+
+    // Only code in prg rom is compiled, anything running from ram is left to the interpreter
+    if ((uintptr_t)page < (uintptr_t)rom->data || (uintptr_t)page >= (uintptr_t)rom->data + rom->size)
+        return false;
+
+    const uint32_t rom_addr = (uint32_t)(page - rom->data) + (cpu->pc & 0xFF);
+    const uint32_t hash = ((rom_addr ^ (uint32_t)cpu->pc << 16) * 2654435761u) >> (32 - JIT_CACHE_BITS);
+    JitBlock *block = &jit->blocks[hash];
+
+    if (block->pc != cpu->pc || block->rom_addr != rom_addr)
+    {
+        // The old block's code is left where it is until the next flush
+        *block = (JitBlock){ .pc = cpu->pc, .rom_addr = rom_addr };
+    }
+
+    if (block->code == NULL)
+    {
+        if (block->hits == JIT_NEVER || ++block->hits < JIT_HOT_THRESHOLD)
+            return false;
+
+        // Compiling can flush the cache, block is filled in again afterwards
+        uint32_t cycles = 0;
+        const JitBlockFn code = JitCompile(jit, cpu, &cycles);
+        *block = (JitBlock){ .code = code, .pc = cpu->pc, .rom_addr = rom_addr, .cycles = cycles,
+                             .hits = code ? 0 : JIT_NEVER };
+
+        if (code == NULL)
+            return false;
+    }
+
+    const uint64_t budget = JitBudget(cpu);
+    if (budget < block->cycles)
+        return false;
+
+    jit->code_page = page;
+    block->code(cpu, budget);
+    return true;
+}
+
+#else
+
+Jit *JIT_Create(void)
+{
+    printf("The jit isn't supported on this platform\n");
+    return NULL;
+}
+
+void JIT_Destroy(Jit *jit)
+{
+    UNUSED(jit);
+}
+
+bool JIT_Run(Jit *jit, Cpu *cpu)
+{
+    UNUSED(jit);
+    UNUSED(cpu);
+    return false;
+}
+
+#endif
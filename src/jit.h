@@ -0,0 +1,23 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+
+#include "cpu.h"
+
+// Experimental, translates hot runs of prg rom code into native x86-64 code with the
+// registers and flags kept in host registers. Only built for x86-64 with the System V abi
+// and the flags stored in status, JIT_Create returns NULL everywhere else
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(CPU_LAZY_FLAGS)
+#define JIT_SUPPORTED
+#endif
+
+#define JIT_MAX_BLOCK_INSTRS 32
+
+typedef struct Jit Jit;
+
+Jit *JIT_Create(void);
+void JIT_Destroy(Jit *jit);
+bool JIT_Run(Jit *jit, Cpu *cpu);
+
+#endif
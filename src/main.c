@@ -5,6 +5,8 @@
 
 #include "system.h"
 #include <SDL3/SDL.h>
+#include <soxr.h>
+#include "rewind.h"
 #include "nones.h"
 #include "utils.h"
 
@@ -30,7 +32,13 @@ static void Help(void)
            "  --sdl-audio-driver=\"driver-name\"   Set the preferred audio driver for SDL to use\n"
            "  --ppu-warmup                       Enable the ppu warm up delay found on the NES-001(Will break some famicom games)\n"
            "  --apu-swap-duty-cycles             Enable the use of swapped duty cycles for the square/pulse channels(Needed for older famiclone games)\n"
-           "  --sample-rate=\"sample-rate-mode\"   Set the audio device sample-rate: 0 = 44100Hz (default), 1 = 48000Hz, 2 = 96000Hz, 3 = 192000Hz\n");
+           "  --sample-rate=\"sample-rate-mode\"   Set the audio device sample-rate: 0 = 44100Hz (default), 1 = 48000Hz, 2 = 96000Hz, 3 = 192000Hz\n"
+           "  --run-ahead=\"num-frames\"           Show the frame this many frames ahead of the emulated one to cut input latency (0 - 4, default 0)\n"
+           "  --run-ahead-instance               Run ahead on a second system instead of saving and restoring the state\n"
+           "  --fast-forward                     Always run in fast forward\n"
+           "  --fast-forward-speed=\"multiplier\"  Speed of fast forward compared to real time, 0 runs as fast as possible (0 or 1 - 16, default 0)\n"
+           "  --palette=\"file.pal\"               Use the colors from a .pal file instead of the built in palette\n"
+           "  --audio-latency=\"ms\"               Audio latency to aim for in milliseconds (10 - 250, default 50)\n");
 }
 
 static const int sample_rates[] = 
@@ -54,7 +62,13 @@ int main(int argc, char **argv)
     bool ppu_warmup = false;
     bool swap_duty_cycles = false;
     bool override_audio_driver = false;
+    int run_ahead = 0;
+    bool run_ahead_instance = false;
+    bool fast_forward = false;
+    float fast_forward_speed = 0.0f;
     char audio_driver[128] = {"\0"};
+    const char *palette_path = NULL;
+    int audio_latency = NONES_AUDIO_DEFAULT_LATENCY;
 
     for (int i = 1; i < argc; i++)
     {
@@ -79,6 +93,38 @@ int main(int argc, char **argv)
         if (!strcmp((argv[i]), "--apu-swap-duty-cycles"))
             swap_duty_cycles = true;
 
+        if (!strcmp((argv[i]), "--run-ahead-instance"))
+            run_ahead_instance = true;
+
+        if (!strcmp((argv[i]), "--fast-forward"))
+            fast_forward = true;
+
+        if (strstr((argv[i]), "--fast-forward-speed="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            fast_forward_speed = strtof(delim_pos + 1, &end);
+            if ((fast_forward_speed != 0.0f && (fast_forward_speed < 1.0f || fast_forward_speed > FAST_FORWARD_MAX_SPEED)) || *end != '\0')
+            {
+                printf("Invalid fast forward speed! (0 or 1 - %d)\n", (int)FAST_FORWARD_MAX_SPEED);
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--run-ahead="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            run_ahead = (int)strtol(delim_pos + 1, &end, 10);
+            if (run_ahead < 0 || run_ahead > SYSTEM_MAX_RUN_AHEAD || *end != '\0')
+            {
+                printf("Invalid run ahead frame count! (0 - %d)\n", SYSTEM_MAX_RUN_AHEAD);
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
         if (strstr((argv[i]), "--sample-rate="))
         {
             char *delim_pos = strchr(argv[i], '=');
@@ -98,6 +144,22 @@ int main(int argc, char **argv)
             }
         }
 
+        if (strstr((argv[i]), "--audio-latency="))
+        {
+            char *delim_pos = strchr(argv[i], '=');
+            char *end;
+            audio_latency = (int)strtol(delim_pos + 1, &end, 10);
+            if (audio_latency < NONES_AUDIO_MIN_LATENCY || audio_latency > NONES_AUDIO_MAX_LATENCY || *end != '\0')
+            {
+                printf("Invalid audio latency! (%d - %d)\n", NONES_AUDIO_MIN_LATENCY, NONES_AUDIO_MAX_LATENCY);
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (strstr((argv[i]), "--palette="))
+            palette_path = strchr(argv[i], '=') + 1;
+
         if (strstr((argv[i]), "--sdl-audio-driver="))
         {
             char *delim_pos = strchr(argv[i], '=');
@@ -113,7 +175,8 @@ int main(int argc, char **argv)
     const int sample_rate = sample_rates[sample_rate_mode];
 
     Nones nones;
-    NonesRun(&nones, ppu_warmup, swap_duty_cycles, sample_rate, 
-            argv[1], override_audio_driver ? audio_driver : NULL);
+    NonesRun(&nones, ppu_warmup, swap_duty_cycles, sample_rate,
+            argv[1], override_audio_driver ? audio_driver : NULL, run_ahead, run_ahead_instance,
+            fast_forward, fast_forward_speed, palette_path, audio_latency);
     return EXIT_SUCCESS;
 }
@@ -14,19 +14,6 @@
 
 #include "utils.h"
 
-Mmc1 mmc1;
-Mmc2 mmc2;
-Mmc3 mmc3;
-Mmc5 mmc5;
-UxRom ux_rom;
-AxRom ax_rom;
-CnRom cn_rom;
-ColorDreams color_dreams;
-Nina nina;
-BnRom bn_rom;
-Nanjing nanjing;
-Camerica camerica;
-
 static const uint16_t mmc1_chr_bank_sizes[2] = 
 {
     0x2000, 0x1000
@@ -37,6 +24,13 @@ static uint8_t NromReadPrgRom(Cart *cart, uint16_t addr)
     return CartReadPrgRom(cart, addr);
 }
 
+// Mappers that only switch whole prg rom banks give the rom address an access lands on,
+// so the bus can map those pages straight onto the selected banks
+static uint8_t BankedReadPrgRom(Cart *cart, const uint16_t addr)
+{
+    return CartReadPrgRom(cart, cart->PrgAddrFn(cart, addr));
+}
+
 static void ChrWriteGeneric(Cart *cart, const uint16_t addr, const uint8_t data)
 {
     CartWriteChr(cart, addr, data);
@@ -53,91 +47,95 @@ static uint32_t GetPrgBankAddr(const int bank, const uint16_t addr, const uint16
 }
 
 // Prg bank mode 0 & 1: switch 32 KB at $8000, ignoring low bit of bank number;
-static uint8_t Mmc1PrgReadMode01(Cart *cart, int bank, const uint16_t addr)
+static uint32_t Mmc1PrgAddrMode01(int bank, const uint16_t addr)
 {
-    return CartReadPrgRom(cart, GetPrgBankAddr(bank, addr, PRG_BANK_SIZE_32KIB));
+    return GetPrgBankAddr(bank, addr, PRG_BANK_SIZE_32KIB);
 }
 
 // Prg bank mode 2: fix first bank at $8000 and switch 16 KB bank at $C000;
-static uint8_t Mmc1PrgReadMode2(Cart *cart, int bank, const uint16_t addr)
+static uint32_t Mmc1PrgAddrMode2(int bank, const uint16_t addr)
 {
     switch ((addr >> 13) & 0x3)
     {
         case 0:
         case 1:
-            return CartReadPrgRom(cart, GetPrgBankAddr(0, addr, PRG_BANK_SIZE_16KIB));
+            return GetPrgBankAddr(0, addr, PRG_BANK_SIZE_16KIB);
         case 2:
         case 3:
-            return CartReadPrgRom(cart, GetPrgBankAddr(bank, addr, PRG_BANK_SIZE_16KIB));
+            return GetPrgBankAddr(bank, addr, PRG_BANK_SIZE_16KIB);
     }
 
     return 0;
 }
 
 // Prg bank mode 3: fix last bank at $C000 and switch 16 KB bank at $8000);
-static uint8_t Mmc1PrgReadMode3(Cart *cart, int bank, const uint16_t addr)
+static uint32_t Mmc1PrgAddrMode3(Cart *cart, int bank, const uint16_t addr)
 {
     switch ((addr >> 13) & 0x3)
     {
         case 0:
         case 1:
-            return CartReadPrgRom(cart, GetPrgBankAddr(bank, addr, PRG_BANK_SIZE_16KIB));
+            return GetPrgBankAddr(bank, addr, PRG_BANK_SIZE_16KIB);
         case 2:
         case 3:
-            return CartReadPrgRom(cart, GetPrgBankAddr(cart->prg_rom.num_banks - 1, addr, PRG_BANK_SIZE_16KIB));
+            return GetPrgBankAddr(cart->prg_rom.num_banks - 1, addr, PRG_BANK_SIZE_16KIB);
     }
 
     return 0;
 }
 
-static uint8_t Mmc3ReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t Mmc3PrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    if (mmc3.bank_sel.prg_rom_bank_mode)
+    Mmc3 *mmc3 = &cart->mapper->mmc3;
+
+    if (mmc3->bank_sel.prg_rom_bank_mode)
     {
         switch ((addr >> 13) & 0x3)
         {
             case 0:
                 // Read from second to last bank
-                return CartReadPrgRom(cart, GetPrgBankAddr(cart->prg_rom.num_banks - 2, addr, PRG_BANK_SIZE_8KIB));
+                return GetPrgBankAddr(cart->prg_rom.num_banks - 2, addr, PRG_BANK_SIZE_8KIB);
             case 1:
-                return CartReadPrgRom(cart, GetPrgBankAddr(mmc3.regs[7], addr, PRG_BANK_SIZE_8KIB));
+                return GetPrgBankAddr(mmc3->regs[7], addr, PRG_BANK_SIZE_8KIB);
             case 2:
-                return CartReadPrgRom(cart, GetPrgBankAddr(mmc3.regs[6], addr, PRG_BANK_SIZE_8KIB));
+                return GetPrgBankAddr(mmc3->regs[6], addr, PRG_BANK_SIZE_8KIB);
             case 3:
                 // Read from the last bank
-                return CartReadPrgRom(cart, GetPrgBankAddr(cart->prg_rom.num_banks - 1, addr, PRG_BANK_SIZE_8KIB));
+                return GetPrgBankAddr(cart->prg_rom.num_banks - 1, addr, PRG_BANK_SIZE_8KIB);
         }
     }
 
     switch ((addr >> 13) & 0x3)
     {
         case 0:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc3.regs[6], addr, PRG_BANK_SIZE_8KIB));
+            return GetPrgBankAddr(mmc3->regs[6], addr, PRG_BANK_SIZE_8KIB);
         case 1:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc3.regs[7], addr, PRG_BANK_SIZE_8KIB));
+            return GetPrgBankAddr(mmc3->regs[7], addr, PRG_BANK_SIZE_8KIB);
         case 2:
             // Read from second to last bank
-            return CartReadPrgRom(cart, GetPrgBankAddr(cart->prg_rom.num_banks - 2, addr, PRG_BANK_SIZE_8KIB));
+            return GetPrgBankAddr(cart->prg_rom.num_banks - 2, addr, PRG_BANK_SIZE_8KIB);
         case 3:
             // Read from the last bank
-            return CartReadPrgRom(cart, GetPrgBankAddr(cart->prg_rom.num_banks - 1, addr, PRG_BANK_SIZE_8KIB));
+            return GetPrgBankAddr(cart->prg_rom.num_banks - 1, addr, PRG_BANK_SIZE_8KIB);
     }
 
     return 0;
 }
 
-static uint8_t Mmc2ReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t Mmc2PrgRomAddr(Cart *cart, const uint16_t addr)
 {
+    Mmc2 *mmc2 = &cart->mapper->mmc2;
+
     const int reg_index = (addr >> 13) & 3;
 
     if (!reg_index)
     {
-        return CartReadPrgRom(cart, GetPrgBankAddr(mmc2.prg_bank.select, addr, PRG_BANK_SIZE_8KIB));
+        return GetPrgBankAddr(mmc2->prg_bank.select, addr, PRG_BANK_SIZE_8KIB);
     }
     else
     {
         // Read from the last three banks
-        return CartReadPrgRom(cart, GetPrgBankAddr(cart->prg_rom.num_banks - (4 - reg_index), addr, PRG_BANK_SIZE_8KIB));
+        return GetPrgBankAddr(cart->prg_rom.num_banks - (4 - reg_index), addr, PRG_BANK_SIZE_8KIB);
     }
 }
 
@@ -146,9 +144,11 @@ static uint8_t Mmc2ReadPrgRom(Cart *cart, const uint16_t addr)
 // CPU $8000-$FFFF: 32 KB switchable PRG ROM bank
 static uint8_t Mmc5PrgReadMode0(Cart *cart, const uint16_t addr)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     const int reg_index = 0;
     //printf("Mmc5 mode 0: Reading from addr: 0x%X\n", addr);
-    return CartReadPrgRom(cart, GetPrgBankAddr(mmc5.prg_bank[reg_index].raw >> 1, addr, PRG_BANK_SIZE_32KIB));
+    return CartReadPrgRom(cart, GetPrgBankAddr(mmc5->prg_bank[reg_index].raw >> 1, addr, PRG_BANK_SIZE_32KIB));
 }
 
 // PRG mode 1
@@ -157,14 +157,16 @@ static uint8_t Mmc5PrgReadMode0(Cart *cart, const uint16_t addr)
 // CPU $C000-$FFFF: 16 KB switchable PRG ROM bank
 static uint8_t Mmc5PrgReadMode1(Cart *cart, const uint16_t addr)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     switch ((addr >> 13) & 0x3)
     {
         case 0:
         case 1:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5.prg_bank[2].raw >> 1, addr, PRG_BANK_SIZE_16KIB));
+            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5->prg_bank[2].raw >> 1, addr, PRG_BANK_SIZE_16KIB));
         case 2:
         case 3:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5.prg_bank[4].raw >> 1, addr, PRG_BANK_SIZE_16KIB));
+            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5->prg_bank[4].raw >> 1, addr, PRG_BANK_SIZE_16KIB));
     }
 
     return 0;
@@ -177,15 +179,17 @@ static uint8_t Mmc5PrgReadMode1(Cart *cart, const uint16_t addr)
 // CPU $E000-$FFFF: 8 KB switchable PRG ROM bank
 static uint8_t Mmc5PrgReadMode2(Cart *cart, const uint16_t addr)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     switch ((addr >> 13) & 0x3)
     {
         case 0:
         case 1:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5.prg_bank[2].raw >> 1, addr, PRG_BANK_SIZE_16KIB));
+            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5->prg_bank[2].raw >> 1, addr, PRG_BANK_SIZE_16KIB));
         case 2:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5.prg_bank[3].raw, addr, PRG_BANK_SIZE_8KIB));
+            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5->prg_bank[3].raw, addr, PRG_BANK_SIZE_8KIB));
         case 3:
-            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5.prg_bank[4].raw, addr, PRG_BANK_SIZE_8KIB));
+            return CartReadPrgRom(cart, GetPrgBankAddr(mmc5->prg_bank[4].raw, addr, PRG_BANK_SIZE_8KIB));
     }
 
     return 0;
@@ -199,8 +203,10 @@ static uint8_t Mmc5PrgReadMode2(Cart *cart, const uint16_t addr)
 // CPU $E000-$FFFF: 8 KB switchable PRG ROM bank
 static uint8_t Mmc5PrgReadMode3(Cart *cart, const uint16_t addr)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     const int reg_index = ((addr >> 13) & 7) - 3;
-    Mmc5PrgBankReg *reg = &mmc5.prg_bank[reg_index];
+    Mmc5PrgBankReg *reg = &mmc5->prg_bank[reg_index];
 
     if ((reg_index && reg->rom) || reg_index == 4)
     {
@@ -225,7 +231,9 @@ static uint8_t Mmc5PrgReadMode3(Cart *cart, const uint16_t addr)
 
 static uint8_t Mmc5ReadPrgRom(Cart *cart, const uint16_t addr)
 {
-    switch (mmc5.prg_mode)
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    switch (mmc5->prg_mode)
     {
         case 0:
             return Mmc5PrgReadMode0(cart, addr);
@@ -237,7 +245,7 @@ static uint8_t Mmc5ReadPrgRom(Cart *cart, const uint16_t addr)
             return Mmc5PrgReadMode3(cart, addr);
     }
 
-    printf("MMC5 PRG MODE NOT IMPLEMNENTD: %d\n", mmc5.prg_mode);
+    printf("MMC5 PRG MODE NOT IMPLEMNENTD: %d\n", mmc5->prg_mode);
     return 0;
 }
 
@@ -249,8 +257,10 @@ static uint8_t Mmc5ReadPrgRom(Cart *cart, const uint16_t addr)
 // CPU $E000-$FFFF: 8 KB switchable PRG ROM bank
 static void Mmc5PrgWriteMode3(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     const int reg_index = ((addr >> 13) & 7) - 3;
-    Mmc5PrgBankReg *reg = &mmc5.prg_bank[reg_index];
+    Mmc5PrgBankReg *reg = &mmc5->prg_bank[reg_index];
 
     if ((reg_index && reg->rom) || reg_index == 4)
         return;
@@ -274,53 +284,58 @@ static void Mmc5PrgWriteMode3(Cart *cart, const uint16_t addr, const uint8_t dat
 
 static void Mmc5WritePrgRam(Cart *cart, const uint16_t addr, const uint8_t data)
 {
-    if (mmc5.prg_ram_protect1 != 0x2 || mmc5.prg_ram_protect2 != 0x1)
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    if (mmc5->prg_ram_protect1 != 0x2 || mmc5->prg_ram_protect2 != 0x1)
         return;
 
-    switch (mmc5.prg_mode)
+    switch (mmc5->prg_mode)
     {
         case 3:
             Mmc5PrgWriteMode3(cart, addr, data);
             break;
         default:
-            printf("MMC5 PRG RAM MODE NOT IMPLEMNENTED: %d\n", mmc5.prg_mode);
+            printf("MMC5 PRG RAM MODE NOT IMPLEMNENTED: %d\n", mmc5->prg_mode);
             break;
     }
 }
 
-static uint8_t Mmc1ReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t Mmc1PrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    // Should this be in BusRead instead?
-    mmc1.consec_write = false;
+    Mmc1 *mmc1 = &cart->mapper->mmc1;
 
-    switch (mmc1.control.prg_rom_bank_mode)
+    switch (mmc1->control.prg_rom_bank_mode)
     {
         case 0:
         case 1:
-            return Mmc1PrgReadMode01(cart, mmc1.prg_bank.select >> 1, addr);
+            return Mmc1PrgAddrMode01(mmc1->prg_bank.select >> 1, addr);
         case 2:
-            return Mmc1PrgReadMode2(cart, mmc1.prg_bank.select, addr);
+            return Mmc1PrgAddrMode2(mmc1->prg_bank.select, addr);
         case 3:
-            return Mmc1PrgReadMode3(cart, mmc1.prg_bank.select, addr);
+            return Mmc1PrgAddrMode3(cart, mmc1->prg_bank.select, addr);
     }
 
     return 0;
 }
 
-static uint8_t UxRomReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t UxRomPrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    // UxROM prg reads are just like mmc1's prg mode 3
-    return Mmc1PrgReadMode3(cart, ux_rom.bank & 0x7, addr);
+    UxRom *ux_rom = &cart->mapper->ux_rom;
+
+    // UxROM prg banking is just like mmc1's prg mode 3
+    return Mmc1PrgAddrMode3(cart, ux_rom->bank & 0x7, addr);
 }
 
-static uint8_t CarmericaReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t CarmericaPrgRomAddr(Cart *cart, const uint16_t addr)
 {
+    Camerica *camerica = &cart->mapper->camerica;
+
     uint32_t final_addr = 0;
     switch ((addr >> 13) & 0x3)
     {
         case 0:
         case 1:
-            final_addr = GetPrgBankAddr(camerica.inner_bank, addr, PRG_BANK_SIZE_16KIB);
+            final_addr = GetPrgBankAddr(camerica->inner_bank, addr, PRG_BANK_SIZE_16KIB);
             break;
         case 2:
         case 3:
@@ -328,38 +343,48 @@ static uint8_t CarmericaReadPrgRom(Cart *cart, const uint16_t addr)
             break;
     }
 
-    return CartReadPrgRom(cart, final_addr);
+    return final_addr;
 }
 
-static uint8_t AxRomReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t AxRomPrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    const uint32_t final_addr = GetPrgBankAddr(ax_rom.bank, addr, PRG_BANK_SIZE_32KIB);
-    return CartReadPrgRom(cart, final_addr);
+    AxRom *ax_rom = &cart->mapper->ax_rom;
+
+    const uint32_t final_addr = GetPrgBankAddr(ax_rom->bank, addr, PRG_BANK_SIZE_32KIB);
+    return final_addr;
 }
 
-static uint8_t ColorDreamsReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t ColorDreamsPrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    const uint32_t final_addr = GetPrgBankAddr(color_dreams.prg_bank, addr, PRG_BANK_SIZE_32KIB);
-    return CartReadPrgRom(cart, final_addr);
+    ColorDreams *color_dreams = &cart->mapper->color_dreams;
+
+    const uint32_t final_addr = GetPrgBankAddr(color_dreams->prg_bank, addr, PRG_BANK_SIZE_32KIB);
+    return final_addr;
 }
 
-static uint8_t NinaReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t NinaPrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    const uint32_t final_addr = GetPrgBankAddr(nina.prg_bank, addr, PRG_BANK_SIZE_32KIB);
-    return CartReadPrgRom(cart, final_addr);
+    Nina *nina = &cart->mapper->nina;
+
+    const uint32_t final_addr = GetPrgBankAddr(nina->prg_bank, addr, PRG_BANK_SIZE_32KIB);
+    return final_addr;
 }
 
-static uint8_t BnRomReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t BnRomPrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    const uint32_t final_addr = GetPrgBankAddr(bn_rom.bank, addr, PRG_BANK_SIZE_32KIB);
-    return CartReadPrgRom(cart, final_addr);
+    BnRom *bn_rom = &cart->mapper->bn_rom;
+
+    const uint32_t final_addr = GetPrgBankAddr(bn_rom->bank, addr, PRG_BANK_SIZE_32KIB);
+    return final_addr;
 }
 
-static uint8_t NanjingReadPrgRom(Cart *cart, const uint16_t addr)
+static uint32_t NanjingPrgRomAddr(Cart *cart, const uint16_t addr)
 {
-    const int bank = nanjing.prg_high_reg << 4 | nanjing.prg_low_reg.prg_bank_low;
+    Nanjing *nanjing = &cart->mapper->nanjing;
+
+    const int bank = nanjing->prg_high_reg << 4 | nanjing->prg_low_reg.prg_bank_low;
     uint32_t final_addr = GetPrgBankAddr(bank , addr, PRG_BANK_SIZE_32KIB);
-    return CartReadPrgRom(cart, final_addr);
+    return final_addr;
 }
 
 static uint8_t NromReadChrRom(Cart *cart, const uint16_t addr)
@@ -369,13 +394,15 @@ static uint8_t NromReadChrRom(Cart *cart, const uint16_t addr)
 
 static uint8_t Mmc1ReadChrRom(Cart *cart, const uint16_t addr)
 {
-    uint32_t bank_size = mmc1_chr_bank_sizes[mmc1.control.chr_rom_bank_mode];
+    Mmc1 *mmc1 = &cart->mapper->mmc1;
+
+    uint32_t bank_size = mmc1_chr_bank_sizes[mmc1->control.chr_rom_bank_mode];
 
     // Select chr bank (5-bit value, max 32 banks)
-    uint32_t bank = (addr < 0x1000 || !mmc1.control.chr_rom_bank_mode) ? mmc1.chr_bank0 : mmc1.chr_bank1;
+    uint32_t bank = (addr < 0x1000 || !mmc1->control.chr_rom_bank_mode) ? mmc1->chr_bank0 : mmc1->chr_bank1;
 
     // Ignore low bit in 8 Kib mode
-    bank >>= !mmc1.control.chr_rom_bank_mode;
+    bank >>= !mmc1->control.chr_rom_bank_mode;
 
     // If CHR is only 8 KiB, the bank number is ANDed with 1
     if (cart->chr_rom.size == 0x2000)
@@ -387,8 +414,10 @@ static uint8_t Mmc1ReadChrRom(Cart *cart, const uint16_t addr)
     return CartReadChr(cart, final_addr);
 }
 
-static void Mmc2UpdateLatches(uint16_t addr, const bool read)
+static void Mmc2UpdateLatches(Cart *cart, uint16_t addr, const bool read)
 {
+    Mmc2 *mmc2 = &cart->mapper->mmc2;
+
     if (!read)
         return;
 
@@ -396,10 +425,10 @@ static void Mmc2UpdateLatches(uint16_t addr, const bool read)
     switch (addr) 
     {
         case 0xFD8:
-            mmc2.latches[0] = 0;
+            mmc2->latches[0] = 0;
             break;
         case 0xFE8:
-            mmc2.latches[0] = 1;
+            mmc2->latches[0] = 1;
             break;
         case 0x1FD8:
         case 0x1FD9:
@@ -409,7 +438,7 @@ static void Mmc2UpdateLatches(uint16_t addr, const bool read)
         case 0x1FDD:
         case 0x1FDE:
         case 0x1FDF:
-            mmc2.latches[1] = 2;
+            mmc2->latches[1] = 2;
             break;
         case 0x1FE8:
         case 0x1FE9:
@@ -419,45 +448,49 @@ static void Mmc2UpdateLatches(uint16_t addr, const bool read)
         case 0x1FED:
         case 0x1FEE:
         case 0x1FEF:
-            mmc2.latches[1] = 3;
+            mmc2->latches[1] = 3;
             break;
     }
 }
 
-static uint32_t GetMmc2ChrAddr(uint16_t addr, bool read)
+static uint32_t GetMmc2ChrAddr(Cart *cart, uint16_t addr, bool read)
 {
+    Mmc2 *mmc2 = &cart->mapper->mmc2;
+
     const bool latch_index = addr > 0x1000;
-    uint32_t final_addr = ((mmc2.chr_bank_regs[mmc2.latches[latch_index]].bank * 0x1000) + (addr & 0xFFF));
-    Mmc2UpdateLatches(addr, read);
+    uint32_t final_addr = ((mmc2->chr_bank_regs[mmc2->latches[latch_index]].bank * 0x1000) + (addr & 0xFFF));
+    Mmc2UpdateLatches(cart, addr, read);
 
     return final_addr;
 }
 
 static uint8_t Mmc2ReadChr(Cart *cart, const uint16_t addr)
 {
-    return CartReadChr(cart, GetMmc2ChrAddr(addr, true));
+    return CartReadChr(cart, GetMmc2ChrAddr(cart, addr, true));
 }
 
 static void Mmc2WriteChr(Cart *cart, const uint16_t addr, const uint8_t data)
 {
-    CartWriteChr(cart, GetMmc2ChrAddr(addr, false), data);
+    CartWriteChr(cart, GetMmc2ChrAddr(cart, addr, false), data);
 }
 
-static uint32_t GetMmc3ChrAddr(const uint16_t addr)
+static uint32_t GetMmc3ChrAddr(Cart *cart, const uint16_t addr)
 {
-    const uint32_t effective_addr = addr ^ (mmc3.bank_sel.chr_a12_invert * 0x1000);
+    Mmc3 *mmc3 = &cart->mapper->mmc3;
+
+    const uint32_t effective_addr = addr ^ (mmc3->bank_sel.chr_a12_invert * 0x1000);
 
     // Branch version
     //uint32_t final_addr = 0;
     //if (effective_addr < 0x1000)
     //{
     //    // Reg 0 or 1
-    //    final_addr = ((mmc3.regs[effective_addr >> 11] * 0x800) + (effective_addr & 0x7FF));
+    //    final_addr = ((mmc3->regs[effective_addr >> 11] * 0x800) + (effective_addr & 0x7FF));
     //}
     //else
     //{
     //    // Reg 2–5
-    //    final_addr = ((mmc3.regs[(effective_addr >> 10) - 2] * 0x400) + (effective_addr & 0x3FF));
+    //    final_addr = ((mmc3->regs[(effective_addr >> 10) - 2] * 0x400) + (effective_addr & 0x3FF));
     //}
 
     // Branchless
@@ -467,30 +500,31 @@ static uint32_t GetMmc3ChrAddr(const uint16_t addr)
     uint32_t bank_size = 1 << shift;
 
     uint32_t index = (effective_addr >> shift) - offset;
-    uint32_t bank_base = mmc3.regs[index] << shift;
+    uint32_t bank_base = mmc3->regs[index] << shift;
     return bank_base | (effective_addr & (bank_size - 1));
 }
 
 static uint8_t Mmc3ReadChr(Cart *cart, const uint16_t addr)
 {
-    return CartReadChr(cart, GetMmc3ChrAddr(addr));
+    return CartReadChr(cart, GetMmc3ChrAddr(cart, addr));
 }
 
 static void Mmc3WriteChr(Cart *cart, const uint16_t addr, const uint8_t data)
 {
-    CartWriteChr(cart, GetMmc3ChrAddr(addr), data);
+    CartWriteChr(cart, GetMmc3ChrAddr(cart, addr), data);
 }
 
 // CHR mode 0
 // PPU $0000-$1FFF: 8 KB switchable CHR bank
 static uint32_t Mmc5ChrReadMode0(Cart *cart, uint16_t addr)
 {
-    UNUSED(cart);
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     int reg_index = 7;
-    if (mmc5.sprite_mode && mmc5.sub_mode && !mmc5.matches)
+    if (mmc5->sprite_mode && mmc5->sub_mode && !mmc5->matches)
         reg_index = 11;
 
-    return ((mmc5.chr_bank[reg_index] * 0x2000) + (addr & 0x1FFF));
+    return ((mmc5->chr_bank[reg_index] * 0x2000) + (addr & 0x1FFF));
 }
 
 // CHR mode 1
@@ -498,12 +532,13 @@ static uint32_t Mmc5ChrReadMode0(Cart *cart, uint16_t addr)
 // PPU $1000-$1FFF: 4 KB switchable CHR bank
 static uint32_t Mmc5ChrReadMode1(Cart *cart, uint16_t addr)
 {
-    UNUSED(cart);
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     int reg_index = addr < 0x1000 ? 3 : 7;
-    if (mmc5.sprite_mode && mmc5.sub_mode && !mmc5.matches)
+    if (mmc5->sprite_mode && mmc5->sub_mode && !mmc5->matches)
         reg_index = 11;
 
-    return ((mmc5.chr_bank[reg_index] * 0x1000) + (addr & 0xFFF));
+    return ((mmc5->chr_bank[reg_index] * 0x1000) + (addr & 0xFFF));
 }
 
 // CHR mode 2:
@@ -513,10 +548,11 @@ static uint32_t Mmc5ChrReadMode1(Cart *cart, uint16_t addr)
 // PPU $1800-$1FFF: 2 KB switchable CHR bank
 static uint32_t Mmc5ChrReadMode2(Cart *cart, uint16_t addr)
 {
-    UNUSED(cart);
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     int reg_index = 2 * (addr >> 11) + 1;
 
-    if (mmc5.sprite_mode && mmc5.sub_mode && !mmc5.matches)
+    if (mmc5->sprite_mode && mmc5->sub_mode && !mmc5->matches)
     {
         switch (reg_index)
         {
@@ -531,7 +567,7 @@ static uint32_t Mmc5ChrReadMode2(Cart *cart, uint16_t addr)
         }
     }
 
-    return ((mmc5.chr_bank[reg_index] * 0x800) + (addr & 0x7FF));
+    return ((mmc5->chr_bank[reg_index] * 0x800) + (addr & 0x7FF));
 }
 
 // CHR mode 3:
@@ -545,10 +581,11 @@ static uint32_t Mmc5ChrReadMode2(Cart *cart, uint16_t addr)
 // PPU $1C00-$1FFF: 1 KB switchable CHR bank;
 static uint32_t Mmc5ChrReadMode3(Cart *cart, uint16_t addr)
 {
-    UNUSED(cart);
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     int reg_index = addr >> 10;
 
-    if (mmc5.sprite_mode && mmc5.sub_mode && !mmc5.matches)
+    if (mmc5->sprite_mode && mmc5->sub_mode && !mmc5->matches)
     {
         switch (reg_index)
         {
@@ -571,18 +608,20 @@ static uint32_t Mmc5ChrReadMode3(Cart *cart, uint16_t addr)
         }
     }
 
-    return ((mmc5.chr_bank[reg_index] * 0x400) + (addr & 0x3FF));
+    return ((mmc5->chr_bank[reg_index] * 0x400) + (addr & 0x3FF));
 }
 
 static int32_t GetMmc5ChrAddr(Cart *cart, const uint16_t addr)
 {
-    if (mmc5.ext_ram_mode == 1 && mmc5.sub_mode && !mmc5.matches)
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    if (mmc5->ext_ram_mode == 1 && mmc5->sub_mode && !mmc5->matches)
     {
-        uint16_t bank = (mmc5.chr_high << 2 | (mmc5.ext_ram[SystemGetPpu()->v.raw & 0x3FF] & 0x3F));
+        uint16_t bank = (mmc5->chr_high << 2 | (mmc5->ext_ram[cart->system->ppu->v.raw & 0x3FF] & 0x3F));
         return ((bank * 0x1000) + (addr & 0xFFF));
     }
 
-    switch (mmc5.chr_mode)
+    switch (mmc5->chr_mode)
     {
         case 0:
             return Mmc5ChrReadMode0(cart, addr);
@@ -594,13 +633,15 @@ static int32_t GetMmc5ChrAddr(Cart *cart, const uint16_t addr)
             return Mmc5ChrReadMode3(cart, addr);
     }
 
-    printf("Unimpl CHR mode %d\n", mmc5.chr_mode);
+    printf("Unimpl CHR mode %d\n", mmc5->chr_mode);
     return 0;
 }
 
 static uint8_t Mmc5ReadChr(Cart *cart, const uint16_t addr)
 {
-    mmc5.prev_addr = addr;
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    mmc5->prev_addr = addr;
     return CartReadChr(cart, GetMmc5ChrAddr(cart, addr));
 }
 
@@ -611,117 +652,131 @@ static void Mmc5WriteChr(Cart *cart, const uint16_t addr, const uint8_t data)
 
 static uint8_t CnromReadChrRom(Cart *cart, const uint16_t addr)
 {
-    return CartReadChr(cart, ((cn_rom.chr_bank * 0x2000) + (addr & 0x1FFF)));
+    CnRom *cn_rom = &cart->mapper->cn_rom;
+
+    return CartReadChr(cart, ((cn_rom->chr_bank * 0x2000) + (addr & 0x1FFF)));
 }
 
 static uint8_t ColorDreamsReadChrRom(Cart *cart, const uint16_t addr)
 {
-    return CartReadChr(cart, ((color_dreams.chr_bank * 0x2000) + (addr & 0x1FFF)));
+    ColorDreams *color_dreams = &cart->mapper->color_dreams;
+
+    return CartReadChr(cart, ((color_dreams->chr_bank * 0x2000) + (addr & 0x1FFF)));
 }
 
 static uint8_t NinaReadChrRom(Cart *cart, const uint16_t addr)
 {
-    const int bank = addr < 0x1000 ? nina.chr_bank0 : nina.chr_bank1;
+    Nina *nina = &cart->mapper->nina;
+
+    const int bank = addr < 0x1000 ? nina->chr_bank0 : nina->chr_bank1;
     //printf("BANK: %d ADDR: 0x%X\n", bank, addr);
     return CartReadChr(cart, ((bank * 0x1000) + (addr & 0xFFF)));
 }
 
-static uint16_t GetNanjingChrAddr(const uint16_t addr)
+static uint16_t GetNanjingChrAddr(Cart *cart, const uint16_t addr)
 {
+    Nanjing *nanjing = &cart->mapper->nanjing;
+
     uint16_t final_addr = addr;
-    if (nanjing.prg_low_reg.chr_ram_auto_switch && addr < 0x1000)
+    if (nanjing->prg_low_reg.chr_ram_auto_switch && addr < 0x1000)
     {
-        final_addr = (SystemGetPpuA9() * 0x1000) + (addr & 0xFFF);
+        final_addr = (SystemGetPpuA9(cart->system) * 0x1000) + (addr & 0xFFF);
     }
     return final_addr;
 }
 
 static uint8_t NanjingReadChrRom(Cart *cart, const uint16_t addr)
 {
-    return CartReadChr(cart, GetNanjingChrAddr(addr));
+    return CartReadChr(cart, GetNanjingChrAddr(cart, addr));
 }
 
 static void NanjingWriteChr(Cart *cart, const uint16_t addr, const uint8_t data)
 {
-    CartWriteChr(cart, GetNanjingChrAddr(addr), data);
+    CartWriteChr(cart, GetNanjingChrAddr(cart, addr), data);
 }
 
-static void Mmc1SetArrangement(const int arrangement)
+static void Mmc1SetArrangement(Cart *cart, const int arrangement)
 {
     switch (arrangement)
     {
         case 0:
         case 1:
-            PpuSetArrangement(NAMETABLE_SINGLE_SCREEN, arrangement);
+            PpuSetArrangement(cart->system->ppu, NAMETABLE_SINGLE_SCREEN, arrangement);
             break;
         case 2:
         case 3:
-            PpuSetArrangement((arrangement - 1) & 1, 0);
+            PpuSetArrangement(cart->system->ppu, (arrangement - 1) & 1, 0);
             break;
     }
 }
 
-static void Mmc1RegWrite(const uint16_t addr, const uint8_t data)
+static void Mmc1RegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Mmc1 *mmc1 = &cart->mapper->mmc1;
+    const uint64_t cycle = cart->system->cpu->cycles;
+
     if ((data >> 7) & 1)
     {
         DEBUG_LOG("Mmc1 reset request from addr: 0x%04X\n", addr);
 
         // Mmc1 reset
-        mmc1.shift.raw = 0x10;
-        mmc1.shift_count = 0;
+        mmc1->shift.raw = 0x10;
+        mmc1->shift_count = 0;
         // Set last bank at $C000 and switch 16 KB bank at $8000
-        mmc1.control.prg_rom_bank_mode = 0x3;
-        mmc1.consec_write = true;
+        mmc1->control.prg_rom_bank_mode = 0x3;
+        mmc1->last_write_cycle = cycle;
         return;
     }
 
-    if (mmc1.consec_write)
+    // Writes on back to back cycles (the dummy write of a read-modify-write) are ignored
+    if (cycle == mmc1->last_write_cycle + 1)
         return;
 
-    mmc1.consec_write = true;
-    mmc1.shift.raw >>= 1;
-    mmc1.shift.bit4 = data & 1;
-    mmc1.shift_count++;
+    mmc1->last_write_cycle = cycle;
+    mmc1->shift.raw >>= 1;
+    mmc1->shift.bit4 = data & 1;
+    mmc1->shift_count++;
 
-    if (mmc1.shift_count != 5)
+    if (mmc1->shift_count != 5)
         return;
 
-    const uint8_t reg = mmc1.shift.raw;
+    const uint8_t reg = mmc1->shift.raw;
     switch ((addr >> 13) & 0x3)
     {
         case 0:
-            mmc1.control.raw = reg;
-            Mmc1SetArrangement(mmc1.control.name_table_setup);
-            //printf("Set nametable mode to: %d\n", mmc1.control.name_table_setup);
-            //printf("Set prg rom bank mode to: %d\n", mmc1.control.prg_rom_bank_mode);
-            DEBUG_LOG("Set chr bank mode to %d\n", mmc1.control.chr_rom_bank_mode);
+            mmc1->control.raw = reg;
+            Mmc1SetArrangement(cart, mmc1->control.name_table_setup);
+            //printf("Set nametable mode to: %d\n", mmc1->control.name_table_setup);
+            //printf("Set prg rom bank mode to: %d\n", mmc1->control.prg_rom_bank_mode);
+            DEBUG_LOG("Set chr bank mode to %d\n", mmc1->control.chr_rom_bank_mode);
             break;
         case 1:
-            mmc1.chr_bank0 = reg;
-            DEBUG_LOG("Set chr rom bank0 index to %d\n", mmc1.chr_bank0);
+            mmc1->chr_bank0 = reg;
+            DEBUG_LOG("Set chr rom bank0 index to %d\n", mmc1->chr_bank0);
             break;
         case 2:
-            mmc1.chr_bank1 = reg;
-            DEBUG_LOG("Set chr rom bank1 index to %d\n", mmc1.chr_bank1);
+            mmc1->chr_bank1 = reg;
+            DEBUG_LOG("Set chr rom bank1 index to %d\n", mmc1->chr_bank1);
             break;
         case 3:
-            mmc1.prg_bank.raw = reg;
-            DEBUG_LOG("Set prg rom bank index to %d\n", mmc1.prg_bank.select);
+            mmc1->prg_bank.raw = reg;
+            DEBUG_LOG("Set prg rom bank index to %d\n", mmc1->prg_bank.select);
             break;
     }
-    mmc1.shift.raw = 0x10;
-    mmc1.shift_count = 0;
+    mmc1->shift.raw = 0x10;
+    mmc1->shift_count = 0;
 }
 
-static void Mmc2RegWrite(const uint16_t addr, const uint8_t data)
+static void Mmc2RegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Mmc2 *mmc2 = &cart->mapper->mmc2;
+
     const int region = (addr >> 12) & 7;
     switch (region)
     {
         case 2:
         {
-            mmc2.prg_bank.raw = data;
+            mmc2->prg_bank.raw = data;
             break;
         }
         case 3:
@@ -729,51 +784,53 @@ static void Mmc2RegWrite(const uint16_t addr, const uint8_t data)
         case 5:
         case 6:
         {
-            mmc2.chr_bank_regs[(region + 1) & 3].raw = data;
+            mmc2->chr_bank_regs[(region + 1) & 3].raw = data;
             break;
         }
         case 7:
         {
-            mmc2.arrangement = data;
-            PpuSetArrangement(mmc2.arrangement ^ 1, 0);
+            mmc2->arrangement = data;
+            PpuSetArrangement(cart->system->ppu, mmc2->arrangement ^ 1, 0);
             break;
         }
     }
 }
 
-static void Mmc3RegWriteOdd(const uint16_t addr, const uint8_t data)
+static void Mmc3RegWriteOdd(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Mmc3 *mmc3 = &cart->mapper->mmc3;
+
     switch ((addr >> 13) & 0x3)
     {
         // Bank data ($8001-$9FFF, odd)
         case 0:
         {
             uint8_t effective_data = data;
-            if (mmc3.bank_sel.reg == 0x6 || mmc3.bank_sel.reg == 0x7)
+            if (mmc3->bank_sel.reg == 0x6 || mmc3->bank_sel.reg == 0x7)
             {
                 effective_data &= 0x3F;
             }
-            else if (mmc3.bank_sel.reg == 0x0 || mmc3.bank_sel.reg == 0x1)
+            else if (mmc3->bank_sel.reg == 0x0 || mmc3->bank_sel.reg == 0x1)
             {
                 effective_data >>= 1;
             }
-            mmc3.regs[mmc3.bank_sel.reg] = effective_data;
+            mmc3->regs[mmc3->bank_sel.reg] = effective_data;
         
-            //printf("Set MMC3 reg %d bank value 0x%X\n", mmc3.bank_sel.reg, effective_data);
+            //printf("Set MMC3 reg %d bank value 0x%X\n", mmc3->bank_sel.reg, effective_data);
             break;
         }
         // PRG RAM protect ($A001-$BFFF, odd)
         case 1:
-            mmc3.prg_ram_protect.raw = data;
+            mmc3->prg_ram_protect.raw = data;
             break;
         // IRQ reload ($C001-$DFFF, odd)
         case 2:
-            mmc3.irq_counter = 0;
-            mmc3.irq_reload = true;
+            mmc3->irq_counter = 0;
+            mmc3->irq_reload = true;
             break;
         // IRQ enable ($E001-$FFFF, odd)
         case 3:
-            mmc3.irq_enable = true;
+            mmc3->irq_enable = true;
             break;
         default:
             printf("Unknown MMC3 Write from odd addr: 0x%X data: 0x%X\n", addr, data);
@@ -781,31 +838,33 @@ static void Mmc3RegWriteOdd(const uint16_t addr, const uint8_t data)
     }
 }
 
-static void Mmc3RegWriteEven(const uint16_t addr, const uint8_t data)
+static void Mmc3RegWriteEven(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Mmc3 *mmc3 = &cart->mapper->mmc3;
+
     switch ((addr >> 13) & 0x3)
     {
         // Bank select ($8000-$9FFE, even)
         case 0:
-            mmc3.bank_sel.raw = data;
+            mmc3->bank_sel.raw = data;
             //printf("MMC3 Set bank selection: reg %d, prg_rom_bank_mode:%d, chr_a12_invert: %d\n",
-            //        mmc3.bank_sel.reg, mmc3.bank_sel.prg_rom_bank_mode, mmc3.bank_sel.chr_a12_invert);
+            //        mmc3->bank_sel.reg, mmc3->bank_sel.prg_rom_bank_mode, mmc3->bank_sel.chr_a12_invert);
             break;
         // Nametable arrangement ($A000-$BFFE, even)
         case 1:
-            mmc3.name_table_arrgmnt = data & 1;
-            PpuSetArrangement(mmc3.name_table_arrgmnt ^ 1, 0);
-            //printf("Set MMC3 nametable mirroring mode: %d\n", !mmc3.name_table_arrgmnt);
+            mmc3->name_table_arrgmnt = data & 1;
+            PpuSetArrangement(cart->system->ppu, mmc3->name_table_arrgmnt ^ 1, 0);
+            //printf("Set MMC3 nametable mirroring mode: %d\n", !mmc3->name_table_arrgmnt);
             break;
         // IRQ latch ($C000-$DFFE, even)
         case 2:
-            mmc3.irq_latch = data;
+            mmc3->irq_latch = data;
             //printf("Set MMC3 irq_latch: %d\n", data);
             break;
         // IRQ disable ($E000-$FFFE, even)
         case 3:
-            mmc3.irq_enable = false;
-            mmc3.irq_pending = false;
+            mmc3->irq_enable = false;
+            mmc3->irq_pending = false;
             //printf("Set MMC3 interrupts off: 0x%X\n", data);
             break;
         default:
@@ -814,83 +873,95 @@ static void Mmc3RegWriteEven(const uint16_t addr, const uint8_t data)
     }
 }
 
-static void Mmc3RegWrite(const uint16_t addr, const uint8_t data)
+static void Mmc3RegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
     if (addr & 1)
     {
-        Mmc3RegWriteOdd(addr, data);
+        Mmc3RegWriteOdd(cart, addr, data);
     }
     else
     {
-        Mmc3RegWriteEven(addr, data);
+        Mmc3RegWriteEven(cart, addr, data);
     }
 }
 
-static void UxRomRegWrite(const uint16_t addr, const uint8_t data)
+static void UxRomRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    UxRom *ux_rom = &cart->mapper->ux_rom;
+
     UNUSED(addr);
 
-    ux_rom.bank = data;
+    ux_rom->bank = data;
     DEBUG_LOG("Set prg rom bank index to %d\n", data & 0x7);
 }
 
-static void CamericaRomRegWrite(const uint16_t addr, const uint8_t data)
+static void CamericaRomRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Camerica *camerica = &cart->mapper->camerica;
+
     switch ((addr >> 13) & 0x3)
     {
         case 0:
         {
-            camerica.mirroring = data >> 4;
+            camerica->mirroring = data >> 4;
             if (addr >> 12 == 9)
-                PpuSetArrangement(NAMETABLE_SINGLE_SCREEN, camerica.mirroring);
+                PpuSetArrangement(cart->system->ppu, NAMETABLE_SINGLE_SCREEN, camerica->mirroring);
             break;
         }
 
         case 2:
         case 3:
-            camerica.inner_bank = data & 0xF;
+            camerica->inner_bank = data & 0xF;
             break;
     }
 }
 
-static void AxRomRegWrite(const uint16_t addr, const uint8_t data)
+static void AxRomRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    AxRom *ax_rom = &cart->mapper->ax_rom;
+
     UNUSED(addr);
 
-    ax_rom.raw = data;
-    PpuSetArrangement(2, ax_rom.page);
+    ax_rom->raw = data;
+    PpuSetArrangement(cart->system->ppu, 2, ax_rom->page);
 }
 
-static void CnRomRegWrite(const uint16_t addr, const uint8_t data)
+static void CnRomRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    CnRom *cn_rom = &cart->mapper->cn_rom;
+
     UNUSED(addr);
 
-    cn_rom.raw = data;
+    cn_rom->raw = data;
 }
 
-static void ColorDreamsRegWrite(const uint16_t addr, const uint8_t data)
+static void ColorDreamsRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    ColorDreams *color_dreams = &cart->mapper->color_dreams;
+
     UNUSED(addr);
 
-    color_dreams.raw = data;
+    color_dreams->raw = data;
 }
 
-static void NinaRegWrite(const uint16_t addr, const uint8_t data)
+static void NinaRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Nina *nina = &cart->mapper->nina;
+
     switch (addr)
     {
         // PRG Bank Select ($7FFD, write);
         case 0x7FFD:
             //printf("PRG BANK addr: 0x%X data: 0x%X\n", addr, data);
-            nina.prg_bank = data;
+            nina->prg_bank = data;
             break;
         // CHR Bank Select 0 ($7FFE, write)
         case 0x7FFE:
-            nina.chr_bank0 = data;
+            nina->chr_bank0 = data;
             break;
         // CHR Bank Select 1 ($7FFF, write)
         case 0x7FFF:
-            nina.chr_bank1 = data;
+            nina->chr_bank1 = data;
             break;
         default:
             //printf("UNK addr: 0x%X\n", addr);
@@ -898,42 +969,46 @@ static void NinaRegWrite(const uint16_t addr, const uint8_t data)
     }
 }
 
-static void BnRomRegWrite(const uint16_t addr, const uint8_t data)
+static void BnRomRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    BnRom *bn_rom = &cart->mapper->bn_rom;
+
     UNUSED(addr);
     // TODO: Bus conflict like this?
     // data &= cart->prg_rom.data[addr];
-    bn_rom.bank = data;
+    bn_rom->bank = data;
 }
 
-static void NanjingRegWrite(const uint16_t addr, const uint8_t data)
+static void NanjingRegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Nanjing *nanjing = &cart->mapper->nanjing;
+
     switch (addr)
     {
         // PRG Bank Low/CHR-RAM Switch ($5000, write);
         case 0x5000:
             //printf("PRG BANK LOW addr: 0x%X data: 0x%X\n", addr, data);
-            nanjing.prg_low_reg.raw = data;
+            nanjing->prg_low_reg.raw = data;
             break;
         // Feedback Write ($5100-$5101, write)
         case 0x5100:
             //printf("NANJING Feedback Write addr: 0x%X data: %X\n", addr, data);
-            nanjing.feedback.raw = data;
-            nanjing.feedback.flip_latch = 0;
+            nanjing->feedback.raw = data;
+            nanjing->feedback.flip_latch = 0;
             break;
         case 0x5101:
             //printf("NANJING Feedback Write addr: 0x%X data: %X\n", addr, data);
-            nanjing.feedback.latch ^= data & 1;
+            nanjing->feedback.latch ^= data & 1;
             break;
         // PRG Bank High ($5200, write)
         case 0x5200:
             //printf("PRG BANK HIGH addr: 0x%X data: 0x%X\n", addr, data);
-            nanjing.prg_high_reg = data;
+            nanjing->prg_high_reg = data;
             break;
         // Mode ($5300, write))
         case 0x5300:
             //printf("NANJING Mode addr: 0x%X data: 0x%X\n", addr, data);
-            nanjing.mode.raw = data;
+            nanjing->mode.raw = data;
             break;
         default:
             //printf("UNK addr: 0x%X\n", addr);
@@ -947,159 +1022,169 @@ static const uint8_t mmc5_length_counter_table[] =
     12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
 };
 
-static uint8_t Mmc5ReadStatus(void)
+static uint8_t Mmc5ReadStatus(Cart *cart)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     ApuStatus status = {
-        .pulse1 = mmc5.audio.pulse1.length_counter != 0,
-        .pulse2 = mmc5.audio.pulse2.length_counter != 0,
+        .pulse1 = mmc5->audio.pulse1.length_counter != 0,
+        .pulse2 = mmc5->audio.pulse2.length_counter != 0,
     };
 
     return status.raw;
 }
 
-static void Mmc5WriteStatus(const uint8_t data)
+static void Mmc5WriteStatus(Cart *cart, const uint8_t data)
 {
-    mmc5.audio.status.raw = data;
-    mmc5.audio.pulse1.length_counter *= mmc5.audio.status.pulse1;
-    mmc5.audio.pulse2.length_counter *= mmc5.audio.status.pulse2;
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    mmc5->audio.status.raw = data;
+    mmc5->audio.pulse1.length_counter *= mmc5->audio.status.pulse1;
+    mmc5->audio.pulse2.length_counter *= mmc5->audio.status.pulse2;
 }
 
-static uint8_t Mmc5ReadPCMIrq(void)
+static uint8_t Mmc5ReadPCMIrq(Cart *cart)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     Mmc5PcmIrqMode pcm_irq = {
-        .enable = mmc5.pcm_irq.enable & mmc5.irq_trip
+        .enable = mmc5->pcm_irq.enable & mmc5->irq_trip
     };
 
-    mmc5.irq_trip = false;
+    mmc5->irq_trip = false;
 
     return pcm_irq.raw;
 }
 
-static void Mmc5DacWrite(const uint8_t data)
+static void Mmc5DacWrite(Cart *cart, const uint8_t data)
 {
-    if (mmc5.pcm_irq.mode)
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    if (mmc5->pcm_irq.mode)
         return;
 
     if (!data)
     {
-        mmc5.irq_trip = true;
+        mmc5->irq_trip = true;
         return;
     }
 
-    mmc5.irq_trip = false;
-    mmc5.audio.pcm_data = data;
+    mmc5->irq_trip = false;
+    mmc5->audio.pcm_data = data;
 }
 
-static void Mmc5RegWrite(const uint16_t addr, const uint8_t data)
+static void Mmc5RegWrite(Cart *cart, const uint16_t addr, const uint8_t data)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     switch (addr)
     {
         // 8x16 mode enable ($2000 = PPUCTRL)
         case PPU_CTRL_REG:
-            mmc5.sprite_mode = (data >> 5) & 1;
+            mmc5->sprite_mode = (data >> 5) & 1;
             break;
         // PPU Data Substitution Enable ($2001 = PPUMASK)
         case PPU_MASK_REG:
-            mmc5.sub_mode = (data >> 3) & 3;
+            mmc5->sub_mode = (data >> 3) & 3;
             break;
         case OAM_DMA_REG:
-            //printf("Resetting MMC5 Scanline counter! %d -> 0\n", mmc5.scanline);
-            mmc5.scanline = 0;
+            //printf("Resetting MMC5 Scanline counter! %d -> 0\n", mmc5->scanline);
+            mmc5->scanline = 0;
             break;
         // MMC5 audio regs $5000 --> $5015
         case 0x5000:
-            mmc5.audio.pulse1.reg.raw = data;
+            mmc5->audio.pulse1.reg.raw = data;
             break;
         case 0x5002:
-            mmc5.audio.pulse1.timer_period.low = data;
+            mmc5->audio.pulse1.timer_period.low = data;
             break;
         case 0x5003:
-            mmc5.audio.pulse1.timer_period.high = data & 0x7;
-            mmc5.audio.pulse1.length_counter_load = data >> 3;
-            mmc5.audio.pulse1.length_counter = mmc5_length_counter_table[mmc5.audio.pulse1.length_counter_load] * mmc5.audio.status.pulse1;
-            mmc5.audio.pulse1.envelope.start = true;
-            mmc5.audio.pulse1.duty_step = 0;
+            mmc5->audio.pulse1.timer_period.high = data & 0x7;
+            mmc5->audio.pulse1.length_counter_load = data >> 3;
+            mmc5->audio.pulse1.length_counter = mmc5_length_counter_table[mmc5->audio.pulse1.length_counter_load] * mmc5->audio.status.pulse1;
+            mmc5->audio.pulse1.envelope.start = true;
+            mmc5->audio.pulse1.duty_step = 0;
             break;
         case 0x5004:
-            mmc5.audio.pulse2.reg.raw = data;
+            mmc5->audio.pulse2.reg.raw = data;
             break;
         case 0x5006:
-            mmc5.audio.pulse2.timer_period.low = data;
+            mmc5->audio.pulse2.timer_period.low = data;
             break;
         case 0x5007:
-            mmc5.audio.pulse2.timer_period.high = data & 0x7;
-            mmc5.audio.pulse2.length_counter_load = data >> 3;
-            mmc5.audio.pulse2.length_counter = mmc5_length_counter_table[mmc5.audio.pulse2.length_counter_load] * mmc5.audio.status.pulse2;
-            mmc5.audio.pulse2.envelope.start = true;
-            mmc5.audio.pulse2.duty_step = 0;
+            mmc5->audio.pulse2.timer_period.high = data & 0x7;
+            mmc5->audio.pulse2.length_counter_load = data >> 3;
+            mmc5->audio.pulse2.length_counter = mmc5_length_counter_table[mmc5->audio.pulse2.length_counter_load] * mmc5->audio.status.pulse2;
+            mmc5->audio.pulse2.envelope.start = true;
+            mmc5->audio.pulse2.duty_step = 0;
             break;
         case 0x5010:
-            mmc5.pcm_irq.raw = data;
+            mmc5->pcm_irq.raw = data;
             break;
         case 0x5011:
-            Mmc5DacWrite(data);
+            Mmc5DacWrite(cart, data);
             break;
         // Status (read/write)
         case 0x5015:
-            Mmc5WriteStatus(data);
+            Mmc5WriteStatus(cart, data);
             break;
         // PRG mode ($5100)
         case 0x5100:
-            mmc5.prg_mode = data;
+            mmc5->prg_mode = data;
             //printf("Mmc5 PRG Mode addr: 0x%X data: 0x%X\n", addr, data);
             break;
         // CHR mode ($5101)
         case 0x5101:
-            mmc5.chr_mode = data;
+            mmc5->chr_mode = data;
             //printf("Mmc5 CHR Mode addr: 0x%X data: 0x%X\n", addr, data);
             break;
         // PRG RAM Protect 1 ($5102)
         case 0x5102:
-            mmc5.prg_ram_protect1 = data;
+            mmc5->prg_ram_protect1 = data;
             //printf("Mmc5 Prg Ram Protect1 data: 0x%X\n", data);
             break;
         // PRG RAM Protect 2 ($5103)
         case 0x5103:
-            mmc5.prg_ram_protect2 = data;
+            mmc5->prg_ram_protect2 = data;
             //printf("Mmc5 Prg Ram Protect2 data: 0x%X\n", data);
             break;
         // Internal extended RAM mode ($5104)
         case 0x5104:
-            mmc5.ext_ram_mode = data;
+            mmc5->ext_ram_mode = data;
             //printf("MMC5 Ext-ram mode addr: 0x%X data: 0x%X\n", addr, data);
             break;
         // Nametable mapping ($5105)
         case 0x5105:
-            mmc5.mapping.raw = data;
-            PpuSetNameTable(0, mmc5.mapping.nt0_mode);
-            PpuSetNameTable(1, mmc5.mapping.nt1_mode);
-            PpuSetNameTable(2, mmc5.mapping.nt2_mode);
-            PpuSetNameTable(3, mmc5.mapping.nt3_mode);
+            mmc5->mapping.raw = data;
+            PpuSetNameTable(cart->system->ppu, 0, mmc5->mapping.nt0_mode, mmc5->ext_ram);
+            PpuSetNameTable(cart->system->ppu, 1, mmc5->mapping.nt1_mode, mmc5->ext_ram);
+            PpuSetNameTable(cart->system->ppu, 2, mmc5->mapping.nt2_mode, mmc5->ext_ram);
+            PpuSetNameTable(cart->system->ppu, 3, mmc5->mapping.nt3_mode, mmc5->ext_ram);
             break;
         // Fill-mode tile ($5106)
         case 0x5106:
-            mmc5.fillmode_tile = data;
+            mmc5->fillmode_tile = data;
             //printf("MMC5 Fill-Mode Tile: %d\n", data);
             break;
         // Fill-mode color ($5107)
         case 0x5107:
-            mmc5.fillmode_color = data;
+            mmc5->fillmode_color = data;
             //printf("MMC5 Fill-Mode Color: %d\n", data);
             break;
         case 0x5113:
-            mmc5.prg_bank[0].raw = data;
+            mmc5->prg_bank[0].raw = data;
             break;
         case 0x5114:
-            mmc5.prg_bank[1].raw = data;
+            mmc5->prg_bank[1].raw = data;
             break;
         case 0x5115:
-            mmc5.prg_bank[2].raw = data;
+            mmc5->prg_bank[2].raw = data;
             break;
         case 0x5116:
-            mmc5.prg_bank[3].raw = data;
+            mmc5->prg_bank[3].raw = data;
             break;
         case 0x5117:
-            mmc5.prg_bank[4].raw = data;
+            mmc5->prg_bank[4].raw = data;
             break;
         case 0x5120:
         case 0x5121:
@@ -1114,12 +1199,12 @@ static void Mmc5RegWrite(const uint16_t addr, const uint8_t data)
         case 0x512A:
         case 0x512B:
             //printf("MMC5 Set chr bank: %d data %d\n", addr - 0x5120, data);
-            mmc5.chr_bank[addr & 0xF] = (mmc5.chr_high << 2) | data;
+            mmc5->chr_bank[addr & 0xF] = (mmc5->chr_high << 2) | data;
             break;
         // Upper CHR Bank bits ($5130)
         case 0x5130:
             //printf("MMC5 Set upper chr bank bits data: %X\n", data);
-            mmc5.chr_high = data;
+            mmc5->chr_high = data;
             break;
         // Vertical Split Mode ($5200)
         case 0x5200:
@@ -1127,75 +1212,79 @@ static void Mmc5RegWrite(const uint16_t addr, const uint8_t data)
             break;
         // IRQ Scanline Compare Value ($5203)
         case 0x5203:
-            mmc5.target_scanline = data;
-            //printf("MMC5 Set target scanline: %d\n", mmc5.target_scanline);
+            mmc5->target_scanline = data;
+            //printf("MMC5 Set target scanline: %d\n", mmc5->target_scanline);
             break;
         // Scanline IRQ Status ($5204, write)
         case 0x5204:
-            mmc5.irq_enable = data >> 7;
-            //printf("MMC5 Irq enable: %d\n", mmc5.irq_enable);
+            mmc5->irq_enable = data >> 7;
+            //printf("MMC5 Irq enable: %d\n", mmc5->irq_enable);
             break;
         case 0x5205:
-            mmc5.multiplier[0] = data;
+            mmc5->multiplier[0] = data;
             break;
         case 0x5206:
-            mmc5.multiplier[1] = data;
+            mmc5->multiplier[1] = data;
             break;
         default:
             if (addr >= 0x5C00)
             {
-                mmc5.ext_ram[addr & 0x3FF] = data;
+                mmc5->ext_ram[addr & 0x3FF] = data;
             }
             //printf("MMC5 UNK addr: 0x%X\n", addr);
             break;
     }
 }
 
-static uint8_t Mmc5RegRead(const uint16_t addr)
+static uint8_t Mmc5RegRead(Cart *cart, const uint16_t addr)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     switch (addr)
     {
         case 0x5010:
-            return Mmc5ReadPCMIrq();
+            return Mmc5ReadPCMIrq(cart);
 
         // Status (read/write)
         case 0x5015:
-            return Mmc5ReadStatus();
+            return Mmc5ReadStatus(cart);
 
         case 0x5204:
         {
-            Mmc5IrqStatusReg status = mmc5.irq_status;
-            mmc5.irq_status.pending = false;
+            Mmc5IrqStatusReg status = mmc5->irq_status;
+            mmc5->irq_status.pending = false;
             return status.raw;
         }
 
         case 0x5205:
-            return ((uint16_t)(mmc5.multiplier[0] * mmc5.multiplier[1])) & 0xFF;
+            return ((uint16_t)(mmc5->multiplier[0] * mmc5->multiplier[1])) & 0xFF;
 
         case 0x5206:
-            return ((uint16_t)(mmc5.multiplier[0] * mmc5.multiplier[1])) >> 8;
+            return ((uint16_t)(mmc5->multiplier[0] * mmc5->multiplier[1])) >> 8;
 
         case 0xFFFA:
         case 0xFFFB:
         {
-            mmc5.irq_status.in_frame = 0;
-            mmc5.prev_addr = 0;
+            mmc5->irq_status.in_frame = 0;
+            mmc5->prev_addr = 0;
             return 0;
         }
         default:
             if (addr >= 0x5C00)
             {
-                return mmc5.ext_ram[addr & 0x3FF];
+                return mmc5->ext_ram[addr & 0x3FF];
             }
     }
 
-    return SystemReadOpenBus();
+    return SystemReadOpenBus(cart->system);
 }
 
-static uint8_t NanjingRegRead(const uint16_t addr)
+static uint8_t NanjingRegRead(Cart *cart, const uint16_t addr)
 {
+    Nanjing *nanjing = &cart->mapper->nanjing;
+
     UNUSED(addr);
-    return ~nanjing.feedback.raw;
+    return ~nanjing->feedback.raw;
 }
 
 uint8_t MapperReadPrgRom(Cart *cart, const uint16_t addr)
@@ -1203,6 +1292,15 @@ uint8_t MapperReadPrgRom(Cart *cart, const uint16_t addr)
     return cart->PrgReadFn(cart, addr);
 }
 
+// Returns the prg rom backing the page at addr, or NULL if the mapper needs a handler for it
+uint8_t *MapperGetPrgRomPage(Cart *cart, const uint16_t addr)
+{
+    if (!cart->PrgAddrFn)
+        return NULL;
+
+    return &cart->prg_rom.data[cart->PrgAddrFn(cart, addr & 0xFF00) & cart->prg_rom.mask];
+}
+
 uint8_t MapperReadChrRom(Cart *cart, const uint16_t addr)
 {
     return cart->ChrReadFn(cart, addr);
@@ -1210,7 +1308,7 @@ uint8_t MapperReadChrRom(Cart *cart, const uint16_t addr)
 
 uint8_t MapperReadReg(Cart *cart, const uint16_t addr)
 {
-    return cart->RegReadFn(addr);
+    return cart->RegReadFn(cart, addr);
 }
 
 void MapperWritePrgRam(Cart *cart, const uint16_t addr, const uint8_t data)
@@ -1225,111 +1323,117 @@ void MapperWriteChrRam(Cart *cart, const uint16_t addr, const uint8_t data)
 
 void MapperWriteReg(Cart *cart, const uint16_t addr, uint8_t data)
 {
-    cart->RegWriteFn(addr, data);
+    cart->RegWriteFn(cart, addr, data);
 }
 
 void Mmc3ClockIrqCounter(Cart *cart)
 {
-    UNUSED(cart);
+    Mmc3 *mmc3 = &cart->mapper->mmc3;
 
-    if (!mmc3.irq_counter || mmc3.irq_reload)
+    if (!mmc3->irq_counter || mmc3->irq_reload)
     {
-        mmc3.irq_counter = mmc3.irq_latch;
+        mmc3->irq_counter = mmc3->irq_latch;
     }
     else
     {
-        mmc3.irq_counter--;
+        mmc3->irq_counter--;
     }
 
-    if (!mmc3.irq_counter && mmc3.irq_enable)
+    if (!mmc3->irq_counter && mmc3->irq_enable)
     {
-        //printf("MMC3 IRQ pending on Line: %d Cycle: %d\n", SystemGetPpu()->scanline, SystemGetPpu()->cycle_counter);
-        mmc3.irq_pending = true;
+        //printf("MMC3 IRQ pending on Line: %d Cycle: %d\n", cart->system->ppu->scanline, cart->system->ppu->cycle_counter);
+        mmc3->irq_pending = true;
     }
 
-    if (mmc3.irq_reload)
+    if (mmc3->irq_reload)
     {
-        mmc3.irq_reload = false;
+        mmc3->irq_reload = false;
     }
 }
 
-static void Mmc5ClockIrq(const uint16_t addr)
+static void Mmc5ClockIrq(Cart *cart, const uint16_t addr)
 {
-    if (((addr >> 12) == 2) && mmc5.prev_addr == addr)
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    if (((addr >> 12) == 2) && mmc5->prev_addr == addr)
     {
-        mmc5.prev_addr = addr;
-        if (++mmc5.matches != 2)
+        mmc5->prev_addr = addr;
+        if (++mmc5->matches != 2)
             return;
         // If the "in-frame" flag (register $5204) was clear,
         // it becomes set, and the internal 8-bit scanline counter is reset to zero;
         // but if it was already set, the scanline counter is incremented, then compared against the value written to $5203.
         // If they match, the "irq pending" flag is set. 
-        if (!mmc5.irq_status.in_frame)
+        if (!mmc5->irq_status.in_frame)
         {
-            //printf("MMC5 In frame: %d\n", mmc5.scanline);
-            mmc5.irq_status.in_frame = 1;
-            mmc5.scanline = 0;
+            //printf("MMC5 In frame: %d\n", mmc5->scanline);
+            mmc5->irq_status.in_frame = 1;
+            mmc5->scanline = 0;
         }
         else
         {
-            if (++mmc5.scanline && mmc5.scanline == mmc5.target_scanline)
+            if (++mmc5->scanline && mmc5->scanline == mmc5->target_scanline)
             {
-                mmc5.irq_status.pending = 1;
+                mmc5->irq_status.pending = 1;
             }
         }
     }
     else
     {
-        mmc5.prev_addr = addr;
-        mmc5.matches = 0;
+        mmc5->prev_addr = addr;
+        mmc5->matches = 0;
     }
 }
 
-static int Mmc5GetNTMapping(Ppu *ppu)
+static int Mmc5GetNTMapping(Cart *cart, Ppu *ppu)
 {
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
     switch (ppu->v.scrolling.name_table_sel)
     {
         case 0:
-            return mmc5.mapping.nt0_mode;
+            return mmc5->mapping.nt0_mode;
         case 1:
-            return mmc5.mapping.nt1_mode;
+            return mmc5->mapping.nt1_mode;
         case 2:
-            return mmc5.mapping.nt2_mode;
+            return mmc5->mapping.nt2_mode;
         case 3:
-            return mmc5.mapping.nt3_mode;
+            return mmc5->mapping.nt3_mode;
     }
 
     return 0;
 }
 
-uint8_t Mmc5ReadNameTable(Ppu *ppu, const uint16_t addr)
+uint8_t Mmc5ReadNameTable(Cart *cart, Ppu *ppu, const uint16_t addr)
 {
-    Mmc5ClockIrq(addr);
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    Mmc5ClockIrq(cart, addr);
 
     const bool tile_fetch = (addr & 0x3FF) < 0x3C0;
 
-    if (mmc5.ext_ram_mode == 1 && mmc5.sub_mode && !mmc5.matches && !tile_fetch)
+    if (mmc5->ext_ram_mode == 1 && mmc5->sub_mode && !mmc5->matches && !tile_fetch)
     {
-        uint8_t attrib = (mmc5.ext_ram[SystemGetPpu()->v.raw & 0x3FF] >> 6) & 0x3;
+        uint8_t attrib = (mmc5->ext_ram[ppu->v.raw & 0x3FF] >> 6) & 0x3;
         // Duplicate the 2-bit attrib color 4 times to cover the full 8 bits
         return attrib * 0x55;
     }
 
-    const int nt_mapping_mode = Mmc5GetNTMapping(ppu);
+    const int nt_mapping_mode = Mmc5GetNTMapping(cart, ppu);
 
-    if (nt_mapping_mode == 2 && mmc5.ext_ram_mode >= 0x2)
+    if (nt_mapping_mode == 2 && mmc5->ext_ram_mode >= 0x2)
     {
         printf("Ext-Ram NT override\n");
         return 0;
     }
     else if (nt_mapping_mode == 3 && tile_fetch)
     {
-        return mmc5.fillmode_tile;
+        return mmc5->fillmode_tile;
     }
-    else if (nt_mapping_mode == 3 && mmc5.ext_ram_mode != 0x1 && !tile_fetch)
+    else if (nt_mapping_mode == 3 && mmc5->ext_ram_mode != 0x1 && !tile_fetch)
     {
         // Duplicate the 2-bit attrib color 4 times to cover the full 8 bits
-        return mmc5.fillmode_color * 0x55;
+        return mmc5->fillmode_color * 0x55;
     }
 
     return PpuNametableRead(ppu, addr);
@@ -1349,142 +1453,200 @@ static const uint8_t mmc5_duty_cycle_table[4][8] =
     { 1, 0, 0, 1, 1, 1, 1, 1 }
 };
 
-void Mmc5ClockAudioTimers(void)
+void Mmc5ClockAudioTimers(Cart *cart)
 {
-    mmc5.audio.pulse1.output = 0;
-    mmc5.audio.pulse2.output = 0;
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    mmc5->audio.pulse1.output = 0;
+    mmc5->audio.pulse2.output = 0;
 
-    if (mmc5.audio.pulse1.timer.raw > 0)
-        --mmc5.audio.pulse1.timer.raw;
+    if (mmc5->audio.pulse1.timer.raw > 0)
+        --mmc5->audio.pulse1.timer.raw;
     else
     {
-        mmc5.audio.pulse1.timer.raw = mmc5.audio.pulse1.timer_period.raw;
-        mmc5.audio.pulse1.duty_step = (mmc5.audio.pulse1.duty_step - 1) & 7;
+        mmc5->audio.pulse1.timer.raw = mmc5->audio.pulse1.timer_period.raw;
+        mmc5->audio.pulse1.duty_step = (mmc5->audio.pulse1.duty_step - 1) & 7;
     }
 
-    if (mmc5.audio.pulse2.timer.raw > 0)
-        --mmc5.audio.pulse2.timer.raw;
+    if (mmc5->audio.pulse2.timer.raw > 0)
+        --mmc5->audio.pulse2.timer.raw;
     else
     {
-        mmc5.audio.pulse2.timer.raw = mmc5.audio.pulse2.timer_period.raw;
-        mmc5.audio.pulse2.duty_step = (mmc5.audio.pulse2.duty_step - 1) & 7;
+        mmc5->audio.pulse2.timer.raw = mmc5->audio.pulse2.timer_period.raw;
+        mmc5->audio.pulse2.duty_step = (mmc5->audio.pulse2.duty_step - 1) & 7;
     }
 
-    if (mmc5.audio.pulse1.length_counter)
+    if (mmc5->audio.pulse1.length_counter)
     {
-        mmc5.audio.pulse1.output = mmc5_duty_cycle_table[mmc5.audio.pulse1.reg.duty][mmc5.audio.pulse1.duty_step];
+        mmc5->audio.pulse1.output = mmc5_duty_cycle_table[mmc5->audio.pulse1.reg.duty][mmc5->audio.pulse1.duty_step];
     }
 
-    if (mmc5.audio.pulse2.length_counter)
+    if (mmc5->audio.pulse2.length_counter)
     {
-        mmc5.audio.pulse2.output = mmc5_duty_cycle_table[mmc5.audio.pulse2.reg.duty][mmc5.audio.pulse2.duty_step];
+        mmc5->audio.pulse2.output = mmc5_duty_cycle_table[mmc5->audio.pulse2.reg.duty][mmc5->audio.pulse2.duty_step];
     }
 }
 
-static void Mmc5ClockEnvelopes(void)
+static void Mmc5ClockEnvelopes(Cart *cart)
 {
-    ApuClockEnvelope(&mmc5.audio.pulse1.envelope, mmc5.audio.pulse1.reg.volume_env, mmc5.audio.pulse1.reg.counter_halt);
-    ApuClockEnvelope(&mmc5.audio.pulse2.envelope, mmc5.audio.pulse2.reg.volume_env, mmc5.audio.pulse2.reg.counter_halt);
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    ApuClockEnvelope(&mmc5->audio.pulse1.envelope, mmc5->audio.pulse1.reg.volume_env, mmc5->audio.pulse1.reg.counter_halt);
+    ApuClockEnvelope(&mmc5->audio.pulse2.envelope, mmc5->audio.pulse2.reg.volume_env, mmc5->audio.pulse2.reg.counter_halt);
 
-    //printf("Pulse 1 envelope counter: %d\n", mmc5.audio.pulse1.envelope.counter);
-    //printf("Pulse 1 envelope decay counter: %d\n", mmc5.audio.pulse1.envelope.decay_counter);
-    //printf("Pulse 2 envelope counter: %d\n", mmc5.audio.pulse2.envelope.counter);
-    //printf("Pulse 2 envelope decay counter: %d\n", mmc5.audio.pulse2.envelope.decay_counter);
+    //printf("Pulse 1 envelope counter: %d\n", mmc5->audio.pulse1.envelope.counter);
+    //printf("Pulse 1 envelope decay counter: %d\n", mmc5->audio.pulse1.envelope.decay_counter);
+    //printf("Pulse 2 envelope counter: %d\n", mmc5->audio.pulse2.envelope.counter);
+    //printf("Pulse 2 envelope decay counter: %d\n", mmc5->audio.pulse2.envelope.decay_counter);
 
-    if (mmc5.audio.pulse1.reg.constant_volume)
-        mmc5.audio.pulse1.volume = mmc5.audio.pulse1.reg.volume_env;
+    if (mmc5->audio.pulse1.reg.constant_volume)
+        mmc5->audio.pulse1.volume = mmc5->audio.pulse1.reg.volume_env;
     else
-        mmc5.audio.pulse1.volume = mmc5.audio.pulse1.envelope.decay_counter;
+        mmc5->audio.pulse1.volume = mmc5->audio.pulse1.envelope.decay_counter;
 
-    if (mmc5.audio.pulse2.reg.constant_volume)
-        mmc5.audio.pulse2.volume = mmc5.audio.pulse2.reg.volume_env;
+    if (mmc5->audio.pulse2.reg.constant_volume)
+        mmc5->audio.pulse2.volume = mmc5->audio.pulse2.reg.volume_env;
     else
-        mmc5.audio.pulse2.volume = mmc5.audio.pulse2.envelope.decay_counter;
+        mmc5->audio.pulse2.volume = mmc5->audio.pulse2.envelope.decay_counter;
 }
 
-static void Mmc5ClockLengthCounters(void)
+static void Mmc5ClockLengthCounters(Cart *cart)
 {
-    if (mmc5.audio.pulse1.length_counter && !mmc5.audio.pulse1.reg.counter_halt)
-        --mmc5.audio.pulse1.length_counter;
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
 
-    if (mmc5.audio.pulse2.length_counter && !mmc5.audio.pulse2.reg.counter_halt)
-        --mmc5.audio.pulse2.length_counter;
+    if (mmc5->audio.pulse1.length_counter && !mmc5->audio.pulse1.reg.counter_halt)
+        --mmc5->audio.pulse1.length_counter;
+
+    if (mmc5->audio.pulse2.length_counter && !mmc5->audio.pulse2.reg.counter_halt)
+        --mmc5->audio.pulse2.length_counter;
 }
 
-void Mmc5ClockAudio(void)
+void Mmc5ClockAudio(Cart *cart)
 {
-    if (mmc5.audio.timer > 0)
-        --mmc5.audio.timer;
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    if (mmc5->audio.timer > 0)
+        --mmc5->audio.timer;
     else
     {
-        mmc5.audio.timer = 7457;
-        Mmc5ClockEnvelopes();
-        Mmc5ClockLengthCounters();
+        mmc5->audio.timer = 7457;
+        Mmc5ClockEnvelopes(cart);
+        Mmc5ClockLengthCounters(cart);
     }
 }
 
-float Mmc5GetMixedAudio(void)
+float Mmc5GetMixedAudio(Cart *cart)
 {
-    const float square1 = ((mmc5.audio.pulse1.output * mmc5.audio.pulse1.volume) / 15.0) - 0.5;
-    const float square2 = ((mmc5.audio.pulse2.output * mmc5.audio.pulse2.volume) / 15.0) - 0.5;
-    const float pcm = ((mmc5.audio.pcm_data) / 255.0) - 0.5;
+    Mmc5 *mmc5 = &cart->mapper->mmc5;
+
+    const float square1 = ((mmc5->audio.pulse1.output * mmc5->audio.pulse1.volume) / 15.0) - 0.5;
+    const float square2 = ((mmc5->audio.pulse2.output * mmc5->audio.pulse2.volume) / 15.0) - 0.5;
+    const float pcm = ((mmc5->audio.pcm_data) / 255.0) - 0.5;
     return (square1 + square2 + pcm) * 0.12;
 }
 
-bool PollMapperIrq(void)
+bool PollMapperIrq(Cart *cart)
 {
-    return mmc3.irq_pending | (mmc5.irq_status.pending & mmc5.irq_enable);
+    Mapper *mapper = cart->mapper;
+
+    return mapper->mmc3.irq_pending | (mapper->mmc5.irq_status.pending & mapper->mmc5.irq_enable);
+}
+
+// Fewest times the ppu has to clock the mmc3 or mmc5 irq before it fires, or 0 if it can't fire
+// until a register write changes that
+int MapperIrqClocksLeft(Cart *cart)
+{
+    Mapper *mapper = cart->mapper;
+
+    switch (cart->mapper_num)
+    {
+        case MAPPER_MMC3:
+        {
+            if (!mapper->mmc3.irq_enable)
+                return 0;
+
+            // The latch gets loaded on the first clock and only fires right away if it's 0
+            if (!mapper->mmc3.irq_counter || mapper->mmc3.irq_reload)
+                return mapper->mmc3.irq_latch + 1;
+
+            return mapper->mmc3.irq_counter;
+        }
+        case MAPPER_MMC5:
+        {
+            Mmc5 *mmc5 = &mapper->mmc5;
+
+            if (!mmc5->irq_enable || !mmc5->target_scanline)
+                return 0;
+
+            // Out of the frame the first clock resets the counter, which the nmi vector read
+            // can do at any time so it might happen before the counter gets to the target
+            const int clocks = mmc5->target_scanline + 1;
+            if (!mmc5->irq_status.in_frame)
+                return clocks;
+
+            return MIN(clocks, (uint8_t)(mmc5->target_scanline - mmc5->scanline - 1) + 1);
+        }
+        default:
+            return 0;
+    }
 }
 
 void MapperReset(Cart *cart)
 {
+    Mapper *mapper = cart->mapper;
+
     switch (cart->mapper_num)
     {
         case MAPPER_MMC5:
-            mmc5.irq_enable = 0;
+            mapper->mmc5.irq_enable = 0;
             break;
         case MAPPER_NANJING:
-            nanjing.feedback.raw = 0;
-            nanjing.mode.raw = 0;
+            mapper->nanjing.feedback.raw = 0;
+            mapper->nanjing.mode.raw = 0;
             break;
         default:
             break;
     }
 }
 
-void MapperInit(Cart *cart)
+void MapperInit(Arena *arena, Cart *cart)
 {
+    Mapper *mapper = ArenaPush(arena, sizeof(Mapper));
+    cart->mapper = mapper;
+
     switch (cart->mapper_num)
     {
         case MAPPER_NROM:
             cart->PrgReadFn = NromReadPrgRom;
             cart->ChrReadFn = NromReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_DIRECT_READ);
             break;
         case MAPPER_MMC1:
-            mmc1.control.prg_rom_bank_mode = 3;
-            cart->PrgReadFn = Mmc1ReadPrgRom;
+            mapper->mmc1.control.prg_rom_bank_mode = 3;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = Mmc1PrgRomAddr;
             cart->ChrReadFn = Mmc1ReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = Mmc1RegWrite;
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_16KIB);
             break;
         case MAPPER_UXROM:
-            cart->PrgReadFn = UxRomReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = UxRomPrgRomAddr;
             cart->ChrReadFn = NromReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = UxRomRegWrite;
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_16KIB);
             break;
         case MAPPER_CNROM:
@@ -1492,113 +1654,121 @@ void MapperInit(Cart *cart)
             cart->ChrReadFn = CnromReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = CnRomRegWrite;
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_DIRECT_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             break;
         case MAPPER_MMC3:
-            cart->PrgReadFn = Mmc3ReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = Mmc3PrgRomAddr;
             cart->ChrReadFn = Mmc3ReadChr;
             cart->ChrWriteFn = Mmc3WriteChr;
             cart->RegWriteFn = Mmc3RegWrite;
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_8KIB);
             break;
         case MAPPER_MMC5:
-            mmc5.prg_mode = 3;
-            mmc5.chr_mode = 3;
-            mmc5.prg_bank[4].raw = 0xFF;
+            mapper->mmc5.prg_mode = 3;
+            mapper->mmc5.chr_mode = 3;
+            mapper->mmc5.prg_bank[4].raw = 0xFF;
             cart->PrgReadFn = Mmc5ReadPrgRom;
             cart->ChrReadFn = Mmc5ReadChr;
             cart->ChrWriteFn = Mmc5WriteChr;
             cart->PrgWriteFn = Mmc5WritePrgRam;
             cart->RegWriteFn = Mmc5RegWrite;
             cart->RegReadFn = Mmc5RegRead;
-            SystemAddMemMapRead(0x5000, 0x5FFF, MEM_REG_READ);
-            SystemAddMemMapRead(0xFFFA, 0xFFFB, MEM_REG_READ);
-            SystemAddMemMapRead(0x6000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(PPU_CTRL_REG, PPU_STATUS_REG, MEM_REG_WRITE);
-            SystemAddMemMapWrite(OAM_DMA_REG, OAM_DMA_REG, MEM_REG_WRITE);
-            SystemAddMemMapWrite(0x5000, 0x5FFF, MEM_REG_WRITE);
-            SystemAddMemMapWrite(0x6000, 0xDFFF, MEM_PRG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x5000, 0x5FFF, MEM_REG_READ);
+            SystemAddMemMapRead(cart->system, 0xFFFA, 0xFFFB, MEM_REG_READ);
+            SystemAddMemMapRead(cart->system, 0x6000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, PPU_CTRL_REG, PPU_STATUS_REG, MEM_REG_WRITE);
+            SystemAddMemMapWrite(cart->system, OAM_DMA_REG, OAM_DMA_REG, MEM_REG_WRITE);
+            SystemAddMemMapWrite(cart->system, 0x5000, 0x5FFF, MEM_REG_WRITE);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0xDFFF, MEM_PRG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_16KIB);
             break;
         case MAPPER_AXROM:
-            cart->PrgReadFn = AxRomReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = AxRomPrgRomAddr;
             cart->ChrReadFn = NromReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = AxRomRegWrite;
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_32KIB);
             break;
         case MAPPER_MMC2:
-            cart->PrgReadFn = Mmc2ReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = Mmc2PrgRomAddr;
             cart->ChrReadFn = Mmc2ReadChr;
             cart->ChrWriteFn = Mmc2WriteChr;
             cart->RegWriteFn = Mmc2RegWrite;
-            mmc2.latches[0] = 0;
-            mmc2.latches[1] = 2;
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0xA000, 0xFFFF, MEM_REG_WRITE);
+            mapper->mmc2.latches[0] = 0;
+            mapper->mmc2.latches[1] = 2;
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0xA000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_8KIB);
             break;
         case MAPPER_COLORDREAMS:
-            cart->PrgReadFn = ColorDreamsReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = ColorDreamsPrgRomAddr;
             cart->ChrReadFn = ColorDreamsReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = ColorDreamsRegWrite;
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_32KIB);
             break;
         case MAPPER_BNROM_NINA:
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_32KIB);
             if (cart->chr_rom.size > 0x2000)
             {
-                cart->PrgReadFn = NinaReadPrgRom;
+                cart->PrgReadFn = BankedReadPrgRom;
+                cart->PrgAddrFn = NinaPrgRomAddr;
                 cart->ChrReadFn = NinaReadChrRom;
                 cart->ChrWriteFn = ChrWriteGeneric;
                 cart->RegWriteFn = NinaRegWrite;
-                SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-                SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-                SystemAddMemMapWrite(0x7FFD, 0x7FFF, MEM_REG_WRITE);
-                SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
+                SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+                SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+                SystemAddMemMapWrite(cart->system, 0x7FFD, 0x7FFF, MEM_REG_WRITE);
+                SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
                 break;
             }
-            cart->PrgReadFn = BnRomReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = BnRomPrgRomAddr;
             cart->ChrReadFn = NromReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = BnRomRegWrite;
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             break;
         case MAPPER_CAMERICA:
-            cart->PrgReadFn = CarmericaReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = CarmericaPrgRomAddr;
             cart->ChrReadFn = NromReadChrRom;
             cart->ChrWriteFn = ChrWriteGeneric;
             cart->RegWriteFn = CamericaRomRegWrite;
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
-            SystemAddMemMapWrite(0x8000, 0xFFFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapWrite(cart->system, 0x8000, 0xFFFF, MEM_REG_WRITE);
             cart->prg_rom.num_banks = GetNumPrgRomBanks(cart->prg_rom.size, PRG_BANK_SIZE_16KIB);
             break;
         case MAPPER_NANJING:
-            cart->PrgReadFn = NanjingReadPrgRom;
+            cart->PrgReadFn = BankedReadPrgRom;
+            cart->PrgAddrFn = NanjingPrgRomAddr;
             cart->ChrReadFn = NanjingReadChrRom;
             cart->ChrWriteFn = NanjingWriteChr;
             cart->RegWriteFn = NanjingRegWrite;
             cart->RegReadFn = NanjingRegRead;
-            SystemAddMemMapRead(0x5000, 0x5FFF, MEM_REG_READ);
-            SystemAddMemMapWrite(0x5000, 0x5FFF, MEM_REG_WRITE);
-            SystemAddMemMapRead(0x6000, 0x7FFF, MEM_SWRAM_READ);
-            SystemAddMemMapWrite(0x6000, 0x7FFF, MEM_SWRAM_WRITE);
-            SystemAddMemMapRead(0x8000, 0xFFFF, MEM_PRG_READ);
+            SystemAddMemMapRead(cart->system, 0x5000, 0x5FFF, MEM_REG_READ);
+            SystemAddMemMapWrite(cart->system, 0x5000, 0x5FFF, MEM_REG_WRITE);
+            SystemAddMemMapRead(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_READ);
+            SystemAddMemMapWrite(cart->system, 0x6000, 0x7FFF, MEM_SWRAM_WRITE);
+            SystemAddMemMapRead(cart->system, 0x8000, 0xFFFF, MEM_PRG_READ);
             break;
         default:
             printf("Bad Mapper type!: %d\n", cart->mapper_num);
@@ -69,7 +69,7 @@ typedef struct
     Mmc1LoadReg load;
     Mmc1ControlReg control;
     Mmc1PrgBankReg prg_bank;
-    bool consec_write;
+    uint64_t last_write_cycle;
     // Select 4 KB or 8 KB CHR bank at PPU $0000 (low bit ignored in 8 KB mode)
     uint8_t chr_bank0 : 5;
     // Select 4 KB CHR bank at PPU $1000 (ignored in 8 KB mode)
@@ -414,6 +414,23 @@ typedef struct
     uint8_t inner_bank : 4;
 } Camerica;
 
+// Board state, owned by the cart so every system gets its own copy
+typedef struct Mapper
+{
+    Mmc1 mmc1;
+    Mmc2 mmc2;
+    Mmc3 mmc3;
+    Mmc5 mmc5;
+    UxRom ux_rom;
+    AxRom ax_rom;
+    CnRom cn_rom;
+    ColorDreams color_dreams;
+    Nina nina;
+    BnRom bn_rom;
+    Nanjing nanjing;
+    Camerica camerica;
+} Mapper;
+
 typedef enum
 {
     PRG_BANK_SIZE_8KIB = 0x2000,
@@ -453,7 +470,15 @@ typedef enum
     MEM_SWRAM_READ, 
     MEM_REG_WRITE,
     MEM_SWRAM_WRITE,
-    MEM_PRG_WRITE
+    MEM_PRG_WRITE,
+    // Unbanked PRG ROM, read straight out of the cart through the page table
+    MEM_PRG_DIRECT_READ,
+    // Console side mappings, registered by the system itself
+    MEM_RAM_READ,
+    MEM_RAM_WRITE,
+    MEM_PPU_READ,
+    MEM_PPU_WRITE,
+    MEM_IO_WRITE
 } MemOperation;
 
 typedef struct
@@ -465,6 +490,7 @@ typedef struct
 } MemMap;
 
 uint8_t MapperReadPrgRom(Cart *cart, const uint16_t addr);
+uint8_t *MapperGetPrgRomPage(Cart *cart, const uint16_t addr);
 uint8_t MapperReadChrRom(Cart *cart, const uint16_t addr);
 uint8_t MapperReadReg(Cart *cart, const uint16_t addr);
 void MapperWritePrgRam(Cart *cart, const uint16_t addr, const uint8_t data);
@@ -472,25 +498,13 @@ void MapperWriteChrRam(Cart *cart, const uint16_t addr, const uint8_t data);
 void MapperWriteReg(Cart *cart, const uint16_t addr, uint8_t data);
 
 void Mmc3ClockIrqCounter(Cart *cart);
-void Mmc5ClockAudio(void);
-void Mmc5ClockAudioTimers(void);
-float Mmc5GetMixedAudio(void);
-uint8_t Mmc5ReadNameTable(Ppu *ppu, const uint16_t addr);
-bool PollMapperIrq(void);
+void Mmc5ClockAudio(Cart *cart);
+void Mmc5ClockAudioTimers(Cart *cart);
+float Mmc5GetMixedAudio(Cart *cart);
+uint8_t Mmc5ReadNameTable(Cart *cart, Ppu *ppu, const uint16_t addr);
+bool PollMapperIrq(Cart *cart);
+int MapperIrqClocksLeft(Cart *cart);
 void MapperReset(Cart *cart);
-void MapperInit(Cart *cart);
-
-extern Mmc1 mmc1;
-extern Mmc2 mmc2;
-extern Mmc3 mmc3;
-extern Mmc5 mmc5;
-extern UxRom ux_rom;
-extern AxRom ax_rom;
-extern CnRom cn_rom;
-extern ColorDreams color_dreams;
-extern Nina nina;
-extern BnRom bn_rom;
-extern Nanjing nanjing;
-extern Camerica camerica;
+void MapperInit(Arena *arena, Cart *cart);
 
 #endif
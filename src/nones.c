@@ -7,41 +7,101 @@
 #include <stdalign.h>
 
 #include <SDL3/SDL.h>
+#include <soxr.h>
 
 #include "system.h"
 #include "cart.h"
+#include "rewind.h"
 #include "nones.h"
+#include "utils.h"
 
-static SDL_AudioStream *stream = NULL;
+// Called by the apu on the emulation thread once it has a full frame of mixed audio,
+// the block is only copied into the queue, resampling it is left to the audio thread
+static void NonesQueueAudio(void *userdata, const float *samples, const int num_samples)
+{
+    Nones *nones = userdata;
+    NonesAudioQueue *queue = &nones->audio_queue;
+
+    // Audio played backwards is just noise
+    if (nones->rewinding)
+        return;
+
+    const int head = SDL_GetAtomicInt(&queue->head);
+    const int next = (head + 1) % NONES_AUDIO_QUEUE_SIZE;
+
+    // Only full when audio is made faster than it plays (uncapped fast forward), it's dropped
+    if (next == SDL_GetAtomicInt(&queue->tail))
+        return;
+
+    memcpy(&queue->blocks[head * queue->block_len], samples, num_samples * sizeof(float));
+    SDL_SetAtomicInt(&queue->head, next);
+    SDL_SignalSemaphore(nones->audio_ready);
+}
 
-void NonesPutSoundData(int16_t *buffer, const int buffer_size)
+static int SDLCALL NonesResampleAudio(void *userdata)
 {
-    // SDL buffer size is 5x the size of the sample buffer
-    const int minimum_audio = (5 * buffer_size);
-    if (SDL_GetAudioStreamQueued(stream) < minimum_audio)
+    Nones *nones = userdata;
+    NonesAudioQueue *queue = &nones->audio_queue;
+    const size_t output_len = nones->audio_buffer_size / sizeof(int16_t);
+    const double target = nones->audio_target;
+
+    while (SDL_GetAtomicInt(&nones->running))
     {
-        SDL_PutAudioStreamData(stream, buffer, buffer_size);
+        // Times out now and then to see if it's time to stop
+        SDL_WaitSemaphoreTimeout(nones->audio_ready, 100);
+
+        int tail = SDL_GetAtomicInt(&queue->tail);
+        while (tail != SDL_GetAtomicInt(&queue->head))
+        {
+            int queued = SDL_GetAudioStreamQueued(nones->stream) / (int)sizeof(int16_t);
+
+            // Ran dry (just started, paused or rewinding), the rate nudge would take seconds to
+            // build the queue back up so it's topped up with silence instead
+            if (queued == 0)
+            {
+                SDL_PutAudioStreamData(nones->stream, nones->audio_silence, nones->audio_target * sizeof(int16_t));
+                queued = nones->audio_target;
+            }
+
+            // Anything that far over the target is dropped before it's resampled
+            if (queued < NONES_AUDIO_MAX_QUEUED * nones->audio_target)
+            {
+                // The host clock and the audio device's never quite agree, so the ratio is
+                // steered by how far the queue is from the target: over it less audio comes
+                // out, under it more
+                const double error = MAX(-1.0, MIN(1.0, (target - queued) / target));
+                soxr_set_io_ratio(nones->soxr, nones->audio_ratio / (1.0 + NONES_AUDIO_MAX_RATE_DELTA * error), output_len / 2);
+
+                size_t odone;
+                soxr_process(nones->soxr, &queue->blocks[tail * queue->block_len], queue->block_len,
+                             NULL, nones->audio_buffer, output_len, &odone);
+                SDL_PutAudioStreamData(nones->stream, nones->audio_buffer, (int)(odone * sizeof(int16_t)));
+            }
+
+            tail = (tail + 1) % NONES_AUDIO_QUEUE_SIZE;
+            SDL_SetAtomicInt(&queue->tail, tail);
+        }
     }
+
+    return 0;
 }
 
-static void NonesDrawDebugInfo(Nones *nones, NonesInfo *info)
+static void NonesDrawDebugInfo(Nones *nones, NonesInfo *info, const NonesFrame *frame)
 {
-    if (!nones->debug_info)
+    if (!nones->input.debug_info)
         return;
 
     SDL_SetRenderDrawColor(nones->renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
-    snprintf(info->cpu_msg, sizeof(info->cpu_msg), "A:%02X X:%02X Y:%02X S:%02X P:%02X", nones->system->cpu->a,
-             nones->system->cpu->x, nones->system->cpu->y, nones->system->cpu->sp, nones->system->cpu->status.raw);
-
-    SDL_RenderDebugText(nones->renderer, 2, 1, info->cpu_msg);
-    SDL_RenderDebugText(nones->renderer, 2, 9, nones->system->cpu->debug_msg);
+    SDL_RenderDebugText(nones->renderer, 2, 1, frame->cpu_msg);
+    SDL_RenderDebugText(nones->renderer, 2, 9, frame->debug_msg);
 
     ++info->frames;
     if (SDL_GetTicks() - info->timer >= 1000)
     {
+        const int updates = SDL_SetAtomicInt(&nones->updates, 0);
         snprintf(info->fps_msg, sizeof(info->fps_msg), "FPS:%lu", info->frames);
-        snprintf(info->ups_msg, sizeof(info->ups_msg), "UPS:%lu", info->updates);
-        info->updates = info->frames = 0;
+        snprintf(info->ups_msg, sizeof(info->ups_msg), "UPS:%d", updates);
+        info->frames = 0;
         info->timer += 1000;
     }
 
@@ -74,66 +134,113 @@ static void NonesUpdateJoyStick(Nones *nones, SDL_Joystick *joystick, bool playe
     {
         if (axis_y <= -16000)
         {
-            nones->buttons[joystick_button_table[player2][0]] = true;
+            nones->input.buttons[joystick_button_table[player2][0]] = true;
         }
         else if (axis_y >= 16000)
         {
-            nones->buttons[joystick_button_table[player2][1]] = true;
+            nones->input.buttons[joystick_button_table[player2][1]] = true;
         }
     
         if (axis_x <= -16000)
         {
-            nones->buttons[joystick_button_table[player2][2]] = true;
+            nones->input.buttons[joystick_button_table[player2][2]] = true;
         }
         else if (axis_x >= 16000)
         {
-            nones->buttons[joystick_button_table[player2][3]] = true;
+            nones->input.buttons[joystick_button_table[player2][3]] = true;
         }
     }
 }
 
+// Queues the input as of the last poll along with a command for the emulation thread
+static void NonesPushInput(Nones *nones, const NonesCommand command)
+{
+    NonesInputQueue *queue = &nones->input_queue;
+    const int head = SDL_GetAtomicInt(&queue->head);
+    const int next = (head + 1) % NONES_INPUT_QUEUE_SIZE;
+
+    // Only full if the emulation thread is stuck, the input is sent again on the next poll
+    if (next == SDL_GetAtomicInt(&queue->tail))
+        return;
+
+    queue->entries[head] = nones->input;
+    queue->entries[head].command = command;
+    SDL_SetAtomicInt(&queue->head, next);
+}
+
+static bool NonesPopInput(Nones *nones, NonesInput *input)
+{
+    NonesInputQueue *queue = &nones->input_queue;
+    const int tail = SDL_GetAtomicInt(&queue->tail);
+
+    if (tail == SDL_GetAtomicInt(&queue->head))
+        return false;
+
+    *input = queue->entries[tail];
+    SDL_SetAtomicInt(&queue->tail, (tail + 1) % NONES_INPUT_QUEUE_SIZE);
+    return true;
+}
+
+// Hands the finished back frame over and takes the shared one to fill next
+static void NonesPublishFrame(NonesTripleBuffer *frames)
+{
+    frames->back = SDL_SetAtomicInt(&frames->middle, frames->back | NONES_FRAME_FRESH) & ~NONES_FRAME_FRESH;
+}
+
+// Returns the newest frame if there's been one since the last call, NULL otherwise
+static const NonesFrame *NonesTakeFrame(NonesTripleBuffer *frames)
+{
+    if (!(SDL_GetAtomicInt(&frames->middle) & NONES_FRAME_FRESH))
+        return NULL;
+
+    frames->front = SDL_SetAtomicInt(&frames->middle, frames->front) & ~NONES_FRAME_FRESH;
+    return &frames->frames[frames->front];
+}
+
 static void NonesHandleInput(Nones *nones)
 {
     const bool *kb_state  = SDL_GetKeyboardState(NULL);
 
-    nones->buttons[0] = kb_state[SDL_SCANCODE_SPACE];
-    nones->buttons[1] = kb_state[SDL_SCANCODE_LSHIFT];
-    nones->buttons[2] = kb_state[SDL_SCANCODE_UP] || kb_state[SDL_SCANCODE_W];
-    nones->buttons[3] = kb_state[SDL_SCANCODE_DOWN] || kb_state[SDL_SCANCODE_S];
-    nones->buttons[4] = kb_state[SDL_SCANCODE_LEFT] || kb_state[SDL_SCANCODE_A];
-    nones->buttons[5] = kb_state[SDL_SCANCODE_RIGHT] || kb_state[SDL_SCANCODE_D];
-    nones->buttons[6] = kb_state[SDL_SCANCODE_RETURN];
-    nones->buttons[7] = kb_state[SDL_SCANCODE_TAB];
+    nones->input.buttons[0] = kb_state[SDL_SCANCODE_SPACE];
+    nones->input.buttons[1] = kb_state[SDL_SCANCODE_LSHIFT];
+    nones->input.buttons[2] = kb_state[SDL_SCANCODE_UP] || kb_state[SDL_SCANCODE_W];
+    nones->input.buttons[3] = kb_state[SDL_SCANCODE_DOWN] || kb_state[SDL_SCANCODE_S];
+    nones->input.buttons[4] = kb_state[SDL_SCANCODE_LEFT] || kb_state[SDL_SCANCODE_A];
+    nones->input.buttons[5] = kb_state[SDL_SCANCODE_RIGHT] || kb_state[SDL_SCANCODE_D];
+    nones->input.buttons[6] = kb_state[SDL_SCANCODE_RETURN];
+    nones->input.buttons[7] = kb_state[SDL_SCANCODE_TAB];
+    nones->input.rewinding = kb_state[SDL_SCANCODE_BACKSPACE];
+    nones->input.fast_forward = (nones->fast_forward_locked || kb_state[SDL_SCANCODE_GRAVE]) && !nones->input.rewinding;
 
     if (nones->gamepad1)
     {
-        nones->buttons[0] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_EAST);
-        nones->buttons[1] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_SOUTH);
-        nones->buttons[2] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_UP);
-        nones->buttons[3] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_DOWN);
-        nones->buttons[4] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_LEFT);
-        nones->buttons[5] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_RIGHT);
-        nones->buttons[6] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_START);
-        nones->buttons[7] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_BACK);
+        nones->input.buttons[0] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_EAST);
+        nones->input.buttons[1] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_SOUTH);
+        nones->input.buttons[2] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_UP);
+        nones->input.buttons[3] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_DOWN);
+        nones->input.buttons[4] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_LEFT);
+        nones->input.buttons[5] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_DPAD_RIGHT);
+        nones->input.buttons[6] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_START);
+        nones->input.buttons[7] |= SDL_GetGamepadButton(nones->gamepad1, SDL_GAMEPAD_BUTTON_BACK);
 
         NonesUpdateJoyStick(nones, nones->joystick1, false);
     }
 
     if (nones->gamepad2)
     {
-        nones->buttons[8]  = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_EAST);
-        nones->buttons[9]  = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_SOUTH);
-        nones->buttons[10] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_UP);
-        nones->buttons[11] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_DOWN);
-        nones->buttons[12] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_LEFT);
-        nones->buttons[13] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_RIGHT);
-        nones->buttons[14] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_START);
-        nones->buttons[15] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_BACK);
+        nones->input.buttons[8]  = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_EAST);
+        nones->input.buttons[9]  = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_SOUTH);
+        nones->input.buttons[10] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_UP);
+        nones->input.buttons[11] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_DOWN);
+        nones->input.buttons[12] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_LEFT);
+        nones->input.buttons[13] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_DPAD_RIGHT);
+        nones->input.buttons[14] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_START);
+        nones->input.buttons[15] = SDL_GetGamepadButton(nones->gamepad2, SDL_GAMEPAD_BUTTON_BACK);
 
         NonesUpdateJoyStick(nones, nones->joystick2, true);
     }
 
-    SystemUpdateJPButtons(nones->system, nones->buttons);
+    NonesPushInput(nones, NONES_COMMAND_NONE);
 
     nones->quit |= kb_state[SDL_SCANCODE_ESCAPE];
 
@@ -153,7 +260,8 @@ static void NonesHandleInput(Nones *nones)
 static void NonesInit(Nones *nones, const char *path, const char *audio_driver, const int sample_rate)
 {
     memset(nones, 0, sizeof(*nones));
-    nones->arena = ArenaCreate(1024 * 1024 * 3);
+    // Bigger than the other frontends' for the 3 rgba frames handed to the render thread
+    nones->arena = ArenaCreate(1024 * 1024 * 4);
     nones->system = SystemCreate(nones->arena);
 
     if (SystemLoadCart(nones->arena, nones->system, path))
@@ -226,8 +334,8 @@ static void NonesInit(Nones *nones, const char *path, const char *audio_driver,
     spec.format = SDL_AUDIO_S16;
     spec.freq = sample_rate;
 
-    stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
-    if (!stream)
+    nones->stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
+    if (!nones->stream)
     {
         SDL_Log("Couldn't create audio stream: %s", SDL_GetError());
         SDL_DestroyRenderer(nones->renderer);
@@ -237,7 +345,7 @@ static void NonesInit(Nones *nones, const char *path, const char *audio_driver,
         exit(EXIT_FAILURE);
     }
 
-    SDL_ResumeAudioStreamDevice(stream);
+    SDL_ResumeAudioStreamDevice(nones->stream);
 
     //SDL_SetRenderLogicalPresentation(nones->renderer, SCREEN_WIDTH, SCREEN_WIDTH,  SDL_LOGICAL_PRESENTATION_INTEGER_SCALE);
     SDL_SetRenderScale(nones->renderer, 2, 2);
@@ -252,6 +360,20 @@ static void NonesInit(Nones *nones, const char *path, const char *audio_driver,
 
 static void NonesShutdown(Nones *nones)
 {
+    SDL_SetAtomicInt(&nones->running, 0);
+
+    if (nones->emu_thread)
+        SDL_WaitThread(nones->emu_thread, NULL);
+
+    if (nones->audio_thread)
+    {
+        SDL_SignalSemaphore(nones->audio_ready);
+        SDL_WaitThread(nones->audio_thread, NULL);
+    }
+
+    if (nones->audio_ready)
+        SDL_DestroySemaphore(nones->audio_ready);
+
     SystemShutdown(nones->system);
 
     // Handles textures as well, so no need to call SDL_DestroyTexture here
@@ -262,10 +384,22 @@ static void NonesShutdown(Nones *nones)
         SDL_CloseGamepad(nones->gamepad1);
     if (nones->gamepad2)
         SDL_CloseGamepad(nones->gamepad2);
-    SDL_DestroyAudioStream(stream);
+    SDL_DestroyAudioStream(nones->stream);
     SDL_DestroyWindow(nones->window);
     SDL_Quit();
 
+    if (nones->soxr)
+        soxr_delete(nones->soxr);
+
+    if (nones->rewind_arena)
+        ArenaDestroy(nones->rewind_arena);
+
+    if (nones->ahead)
+        SystemShutdown(nones->ahead);
+
+    if (nones->ahead_arena)
+        ArenaDestroy(nones->ahead_arena);
+
     ArenaDestroy(nones->arena);
 }
 
@@ -274,44 +408,299 @@ static void NonesReset(Nones *nones)
     SystemReset(nones->system);
 }
 
+static void NonesInitRunAhead(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sample_rate,
+                              const char *path, const int run_ahead, const bool run_ahead_instance)
+{
+    nones->run_ahead = run_ahead;
+    if (!run_ahead)
+        return;
+
+    nones->ahead_state_size = SystemStateSize(nones->system);
+    nones->ahead_state = ArenaPush(nones->arena, nones->ahead_state_size);
+
+    if (!run_ahead_instance)
+        return;
+
+    // Same cart and settings as the main system so its states load, it never outputs audio
+    nones->ahead_arena = ArenaCreate(1024 * 1024 * 3);
+    nones->ahead = SystemCreate(nones->ahead_arena);
+
+    if (SystemLoadCart(nones->ahead_arena, nones->ahead, path))
+    {
+        printf("Failed to load the cart for run ahead, falling back to saving and restoring\n");
+        ArenaDestroy(nones->ahead_arena);
+        nones->ahead_arena = NULL;
+        nones->ahead = NULL;
+        return;
+    }
+
+    uint16_t *buffers[2];
+    const uint32_t buffer_size = (SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint16_t));
+    buffers[0] = ArenaPush(nones->ahead_arena, buffer_size);
+    buffers[1] = ArenaPush(nones->ahead_arena, buffer_size);
+
+    SystemInit(nones->ahead, nones->ahead_arena, ppu_warmup, swap_duty_cycles, sample_rate, APU_SYNTH_BLIP, buffers, buffer_size);
+}
+
+static void NonesInitAudio(Nones *nones, const int audio_latency)
+{
+    Apu *apu = nones->system->apu;
+    soxr_error_t error;
+
+    soxr_quality_spec_t q_spec = soxr_quality_spec(SOXR_HQ, SOXR_VR);
+    soxr_io_spec_t io_spec = soxr_io_spec(SOXR_FLOAT32_I, SOXR_INT16_I);
+
+    // Frames are paced at the console's rate, so the apu's samples come at its input_rate
+    nones->audio_ratio = apu->mixer.input_rate / apu->mixer.sample_rate;
+
+    // With SOXR_VR the rates only give the highest ratio that will be set
+    nones->soxr = soxr_create(nones->audio_ratio * (1.0 + 2 * NONES_AUDIO_MAX_RATE_DELTA), 1,
+                              1, &error, &io_spec, &q_spec, NULL);
+    if (error)
+    {
+        printf("Failed to create the audio resampler: %s\n", error);
+        NonesShutdown(nones);
+        exit(EXIT_FAILURE);
+    }
+
+    soxr_set_io_ratio(nones->soxr, nones->audio_ratio, 0);
+
+    // A block resamples to about output_len, the rest is room for the nudge
+    // and whatever soxr held back from the block before
+    nones->audio_buffer_size = 2 * apu->mixer.output_len * sizeof(int16_t);
+    nones->audio_buffer = ArenaPush(nones->arena, nones->audio_buffer_size);
+
+    nones->audio_target = (int)(audio_latency * apu->mixer.sample_rate / 1000);
+    nones->audio_silence = ArenaPush(nones->arena, nones->audio_target * sizeof(int16_t));
+    memset(nones->audio_silence, 0, nones->audio_target * sizeof(int16_t));
+
+    // The apu always hands over input_len samples at a time
+    nones->audio_queue.block_len = apu->mixer.input_len;
+    nones->audio_queue.blocks = ArenaPush(nones->arena, NONES_AUDIO_QUEUE_SIZE * apu->mixer.input_size);
+    nones->audio_ready = SDL_CreateSemaphore(0);
+
+    SystemSetAudioCallback(nones->system, NonesQueueAudio, nones);
+}
+
+// Runs everything queued up by the render thread since the last frame, on the emulation thread
+static void NonesApplyInput(Nones *nones)
+{
+    NonesInput input;
+    while (NonesPopInput(nones, &input))
+    {
+        switch (input.command)
+        {
+            case NONES_COMMAND_NONE:
+                break;
+            case NONES_COMMAND_RESET:
+                NonesReset(nones);
+                break;
+            case NONES_COMMAND_PAUSE:
+                SystemUpdateState(nones->system, PAUSED);
+                break;
+            case NONES_COMMAND_STEP_FRAME:
+                SystemUpdateState(nones->system, STEP_FRAME);
+                break;
+            case NONES_COMMAND_STEP_INSTR:
+                SystemUpdateState(nones->system, STEP_INSTR);
+                break;
+        }
+
+        nones->debug_info = input.debug_info;
+        nones->rewinding = input.rewinding;
+
+        if (input.fast_forward != nones->fast_forward)
+        {
+            // With a set speed the audio is played back faster to keep up (pitch and all),
+            // uncapped there's no rate to match so it's dropped instead
+            const bool stretch = input.fast_forward && nones->fast_forward_speed > 0.0f;
+            SDL_SetAudioStreamFrequencyRatio(nones->stream, stretch ? nones->fast_forward_speed : 1.0f);
+            nones->fast_forward = input.fast_forward;
+        }
+
+        SystemUpdateJPButtons(nones->system, input.buttons);
+    }
+}
+
+// Converts the frame into the back of the triple buffer and hands it to the render thread
+static void NonesSendFrame(Nones *nones, const uint16_t *frame)
+{
+    NonesFrame *back = &nones->frames.frames[nones->frames.back];
+    const Cpu *cpu = nones->system->cpu;
+
+    SystemConvertFrame(nones->system, frame, back->pixels, SCREEN_WIDTH * sizeof(uint32_t), PPU_PIXEL_RGBA8888);
+
+    if (nones->debug_info)
+    {
+        snprintf(back->cpu_msg, sizeof(back->cpu_msg), "A:%02X X:%02X Y:%02X S:%02X P:%02X",
+                 cpu->a, cpu->x, cpu->y, cpu->sp, CPU_GetStatus(cpu));
+        memcpy(back->debug_msg, cpu->debug_msg, sizeof(back->debug_msg));
+    }
+
+    NonesPublishFrame(&nones->frames);
+}
+
+static int SDLCALL NonesEmulate(void *userdata)
+{
+    Nones *nones = userdata;
+
+    // frames_output of the last front buffer sent to the render thread
+    uint64_t frames_sent = UINT64_MAX;
+
+    uint64_t current_time = SDL_GetTicksNS();
+    uint64_t accumulator = 0;
+
+    float accum_delta = FRAME_TIME_NS;
+    uint64_t run_time = 0;
+
+    while (SDL_GetAtomicInt(&nones->running))
+    {
+        const uint64_t start_time = SDL_GetTicksNS();
+        const uint64_t delta_time = start_time - current_time;
+        current_time = start_time;
+
+        NonesApplyInput(nones);
+
+        const bool uncapped = nones->fast_forward && nones->fast_forward_speed <= 0.0f;
+        const uint64_t deadline = start_time + FAST_FORWARD_BUDGET_NS;
+        accumulator += nones->fast_forward ? (uint64_t)(delta_time * nones->fast_forward_speed) : delta_time;
+
+        bool ran_frame = false;
+        while (uncapped || accumulator >= accum_delta)
+        {
+            // Only the last frame before a frame is sent is seen, the frame after this one is
+            // drawn unless another one is sure to run after it
+            const uint64_t run_start = SDL_GetTicksNS();
+            const bool more_frames = uncapped ? run_start + 2 * run_time < deadline : accumulator >= 3 * accum_delta;
+            SystemSetFrameOutput(nones->system, !more_frames);
+
+            // Each frame while rewinding goes back a snapshot and runs one frame from there
+            // to have a picture, the snapshots are interval frames apart so it plays
+            // backwards faster than real time
+            if (nones->rewinding)
+                RewindStep(nones->rewind, nones->system);
+
+            SystemRun(nones->system, nones->debug_info);
+
+            if (!nones->rewinding && nones->system->state == RUNNING)
+                RewindCapture(nones->rewind, nones->system);
+
+            run_time = SDL_GetTicksNS() - run_start;
+
+            if (!uncapped)
+                accumulator -= accum_delta;
+
+            SDL_AddAtomicInt(&nones->updates, 1);
+            ran_frame = true;
+
+            // Uncapped, a frame is sent every budget's worth of frames, whatever is left over
+            // is dropped so there isn't a burst of frames once fast forward stops
+            if (nones->fast_forward && (SDL_GetTicksNS() >= deadline || nones->system->state != RUNNING))
+            {
+                accumulator = 0;
+                break;
+            }
+        }
+
+        // Only the newest frame is run ahead of, and not while rewinding so the snapshots
+        // are the frames actually shown. Frames only go to the render thread when they're new
+        const uint16_t *frame = NULL;
+        if (ran_frame && nones->run_ahead && !nones->rewinding && nones->system->state == RUNNING)
+        {
+            frame = SystemRunAhead(nones->system, nones->ahead, nones->ahead_state,
+                                   nones->ahead_state_size, nones->run_ahead);
+        }
+        else if (nones->system->ppu->frames_output != frames_sent)
+        {
+            frame = nones->system->ppu->buffers[1];
+        }
+
+        frames_sent = nones->system->ppu->frames_output;
+
+        if (frame != NULL)
+            NonesSendFrame(nones, frame);
+
+        const uint64_t frame_time = SDL_GetTicksNS() - start_time;
+        if (frame_time < FRAME_CAP_NS && !uncapped)
+        {
+            SDL_DelayNS(FRAME_CAP_NS - frame_time);
+        }
+    }
+
+    return 0;
+}
+
+static void NonesInitFrames(Nones *nones)
+{
+    NonesTripleBuffer *frames = &nones->frames;
+    const uint32_t frame_size = SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t);
+
+    for (int i = 0; i < 3; i++)
+    {
+        frames->frames[i].pixels = ArenaPush(nones->arena, frame_size);
+    }
+
+    frames->back = 0;
+    SDL_SetAtomicInt(&frames->middle, 1);
+    frames->front = 2;
+
+    // Black until the first frame comes in
+    SDL_UpdateTexture(nones->texture, NULL, frames->frames[frames->front].pixels, SCREEN_WIDTH * sizeof(uint32_t));
+}
+
 void NonesRun(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sample_rate,
-              const char *path, const char *audio_driver)
+              const char *path, const char *audio_driver, const int run_ahead, const bool run_ahead_instance,
+              const bool fast_forward, const float fast_forward_speed, const char *palette_path,
+              const int audio_latency)
 {
     NonesInit(nones, path, audio_driver, sample_rate);
+    nones->fast_forward_locked = fast_forward;
+    nones->fast_forward_speed = fast_forward_speed;
 
     // Allocate pixel buffers (back and front)
-    uint32_t *buffers[2];
-    const uint32_t buffer_size = (SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+    uint16_t *buffers[2];
+    const uint32_t buffer_size = (SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint16_t));
     buffers[0] = ArenaPush(nones->arena, buffer_size);
     buffers[1] = ArenaPush(nones->arena, buffer_size);
 
-    SystemInit(nones->system,nones->arena, ppu_warmup, swap_duty_cycles, sample_rate, buffers, buffer_size);
+    SystemInit(nones->system,nones->arena, ppu_warmup, swap_duty_cycles, sample_rate, APU_SYNTH_BLIP, buffers, buffer_size);
+    NonesInitAudio(nones, audio_latency);
+    NonesInitFrames(nones);
+
+    // Sized after the cart is loaded, the state size depends on the mapper and its ram
+    const size_t state_size = SystemStateSize(nones->system);
+    nones->rewind_arena = ArenaCreate(REWIND_DEFAULT_SIZE + state_size * 4 + 4096);
+    nones->rewind = RewindCreate(nones->rewind_arena, nones->system, REWIND_DEFAULT_SIZE, REWIND_DEFAULT_INTERVAL);
+
+    NonesInitRunAhead(nones, ppu_warmup, swap_duty_cycles, sample_rate, path, run_ahead, run_ahead_instance);
+
+    // Falls back to the built in palette if the file couldn't be loaded
+    if (palette_path != NULL && !SystemLoadPalette(nones->system, palette_path) && nones->ahead != NULL)
+        SystemLoadPalette(nones->ahead, palette_path);
+
+    SDL_SetAtomicInt(&nones->running, 1);
+    nones->audio_thread = SDL_CreateThread(NonesResampleAudio, "audio", nones);
+    nones->emu_thread = SDL_CreateThread(NonesEmulate, "emulation", nones);
+    if (!nones->audio_thread || !nones->emu_thread)
+    {
+        SDL_Log("Couldn't create the emulation threads: %s", SDL_GetError());
+        NonesShutdown(nones);
+        exit(EXIT_FAILURE);
+    }
+
     SDL_Event event;
-    void *raw_pixels;
-    int raw_pitch;
+    const NonesFrame *frame = &nones->frames.frames[nones->frames.front];
 
     NonesInfo info = {
-        .cpu_msg = {'\0'},
         .fps_msg = {'\0'},
         .ups_msg = {'\0'},
         .frames = 0,
-        .updates = 0,
         .timer = SDL_GetTicks(),
     };
 
-    uint64_t previous_time = 0;
-    uint64_t current_time = 0;
-    uint64_t accumulator = 0;
-
-    float accum_delta = FRAME_TIME_NS;
-
     while (!nones->quit)
     {
         uint64_t start_time = SDL_GetTicksNS();
-        previous_time = current_time;
-        current_time = start_time;
-        uint64_t delta_time = current_time - previous_time;
-        accumulator += delta_time;
 
         while (SDL_PollEvent(&event))
         {
@@ -324,19 +713,19 @@ void NonesRun(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sa
                     switch (event.key.key)
                     {
                         case SDLK_F1:
-                            nones->debug_info = !nones->debug_info;
+                            nones->input.debug_info = !nones->input.debug_info;
                             break;
                         case SDLK_F2:
-                            NonesReset(nones);
+                            NonesPushInput(nones, NONES_COMMAND_RESET);
                             break;
                         case SDLK_F6:
-                            SystemUpdateState(nones->system, PAUSED);
+                            NonesPushInput(nones, NONES_COMMAND_PAUSE);
                             break;
                         case SDLK_F10:
-                            SystemUpdateState(nones->system, STEP_FRAME);
+                            NonesPushInput(nones, NONES_COMMAND_STEP_FRAME);
                             break;
                         case SDLK_F11:
-                            SystemUpdateState(nones->system, STEP_INSTR);
+                            NonesPushInput(nones, NONES_COMMAND_STEP_INSTR);
                             break;
                     }
                     break;
@@ -345,25 +734,22 @@ void NonesRun(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sa
 
         NonesHandleInput(nones);
 
-        while (accumulator >= accum_delta)
+        // The texture keeps the last frame, it's only uploaded to again when there's a new one
+        const NonesFrame *new_frame = NonesTakeFrame(&nones->frames);
+        if (new_frame != NULL)
         {
-            SystemRun(nones->system, nones->debug_info);
-
-            accumulator -= accum_delta;
-            ++info.updates;
+            frame = new_frame;
+            SDL_UpdateTexture(nones->texture, NULL, frame->pixels, SCREEN_WIDTH * sizeof(uint32_t));
         }
 
-        SDL_LockTexture(nones->texture, NULL, &raw_pixels, &raw_pitch);
-        memcpy(raw_pixels, nones->system->ppu->buffers[1], buffer_size);
-        SDL_UnlockTexture(nones->texture);
-
         SDL_RenderClear(nones->renderer);
         SDL_RenderTexture(nones->renderer, nones->texture, NULL, NULL);
 
-        NonesDrawDebugInfo(nones, &info);
+        NonesDrawDebugInfo(nones, &info, frame);
 
         SDL_RenderPresent(nones->renderer);
 
+        // Vsync paces this loop, the cap only matters when it's off
         uint64_t frame_time = SDL_GetTicksNS() - start_time;
         if (frame_time < FRAME_CAP_NS)
         {
@@ -373,4 +759,3 @@ void NonesRun(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sa
 
     NonesShutdown(nones);
 }
-
@@ -1,32 +1,113 @@
 #ifndef NONES_H
 #define NONES_H
 
-//#define SCREEN_WIDTH 340
-//#define SCREEN_HEIGHT 260
-#define SCREEN_WIDTH 256
-#define SCREEN_HEIGHT 240
-#define FRAMERATE 60
+// Rate of the NTSC console, frames are paced to it so games and audio run at their real speed
+#define FRAMERATE 60.098477556112265
 #define FRAMECAP 500
-//#define FRAMERATE 60.098477556112265
 #define FRAME_TIME_MS (1000.0 / FRAMERATE)
 #define FRAME_CAP_MS (1000.0 / FRAMECAP)
 #define FRAME_TIME_NS (1000000000.0 / FRAMERATE)
 #define FRAME_CAP_NS (1000000000.0 / FRAMECAP)
+// Uncapped fast forward runs frames for this long before presenting,
+// the rest of the display frame is left for presenting and vsync
+#define FAST_FORWARD_BUDGET_NS (FRAME_TIME_NS * 0.75)
+#define FAST_FORWARD_MAX_SPEED 16.0f
+// One slot is always left empty to tell a full queue from an empty one
+#define NONES_INPUT_QUEUE_SIZE 64
+// Blocks of mixed audio (a frame's worth each) the audio thread can fall behind by
+#define NONES_AUDIO_QUEUE_SIZE 8
+// Audio latency (in milliseconds) the resampler steers towards by default
+#define NONES_AUDIO_DEFAULT_LATENCY 50
+#define NONES_AUDIO_MIN_LATENCY 10
+#define NONES_AUDIO_MAX_LATENCY 250
+// Most the resampling ratio is nudged either way to keep the queued audio at the target,
+// 0.5% is too little of a pitch change to hear
+#define NONES_AUDIO_MAX_RATE_DELTA 0.005
+// Audio queued past this many times the target is dropped, only happens when it's made
+// faster than it plays (uncapped fast forward)
+#define NONES_AUDIO_MAX_QUEUED 3
+// Set on the shared frame's index while the render thread hasn't taken it yet
+#define NONES_FRAME_FRESH 4
 
 typedef struct
 {
-    char cpu_msg[128];
     char fps_msg[8];
     char ups_msg[8];
     uint64_t frames;
-    uint64_t updates;
     uint64_t timer;
 } NonesInfo;
 
-typedef struct {
+typedef enum
+{
+    NONES_COMMAND_NONE,
+    NONES_COMMAND_RESET,
+    NONES_COMMAND_PAUSE,
+    NONES_COMMAND_STEP_FRAME,
+    NONES_COMMAND_STEP_INSTR
+} NonesCommand;
+
+// Everything the emulation thread needs from the keyboard and gamepads
+typedef struct
+{
     bool buttons[16];
+    bool rewinding;
+    bool fast_forward;
+    bool debug_info;
+    NonesCommand command;
+} NonesInput;
+
+// The render thread is the only writer of head and the emulation thread the only writer of tail
+typedef struct
+{
+    NonesInput entries[NONES_INPUT_QUEUE_SIZE];
+    SDL_AtomicInt head;
+    SDL_AtomicInt tail;
+} NonesInputQueue;
+
+// Mixed audio on its way from the emulation thread to the audio thread, which resamples it
+// and queues it with SDL. Same single producer, single consumer setup as the input queue
+typedef struct
+{
+    float *blocks;
+    int block_len;
+    SDL_AtomicInt head;
+    SDL_AtomicInt tail;
+} NonesAudioQueue;
+
+typedef struct
+{
+    uint32_t *pixels;
+    // The cpu registers when the frame was finished, shown with the debug info
+    char cpu_msg[128];
+    char debug_msg[128];
+} NonesFrame;
+
+// The emulation thread fills back while the render thread shows front, finished frames are
+// swapped through middle so neither thread ever waits for the other. Only the newest frame
+// is kept, one the render thread didn't get to in time is dropped
+typedef struct
+{
+    NonesFrame frames[3];
+    SDL_AtomicInt middle;
+    int back;
+    int front;
+} NonesTripleBuffer;
+
+// Emulation runs on its own thread so a slow present can't hold up emulation or audio. The
+// render thread (the main one, SDL wants events and rendering there) polls input and presents,
+// the audio thread owns the resampler and everything else belongs to the emulation thread
+typedef struct {
     Arena *arena;
+    // The rewind history gets its own arena, it's much bigger than everything else
+    Arena *rewind_arena;
     System *system;
+    Rewind *rewind;
+    // Run ahead state, ahead is only set when the frames are run on a second instance
+    Arena *ahead_arena;
+    System *ahead;
+    void *ahead_state;
+    size_t ahead_state_size;
+    int run_ahead;
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
@@ -35,12 +116,41 @@ typedef struct {
     SDL_JoystickID *gamepads;
     SDL_Joystick *joystick1;
     SDL_Joystick *joystick2;
+    SDL_AudioStream *stream;
+    soxr_t soxr;
+    // Input over output rate at the console's frame rate, before it's nudged
+    double audio_ratio;
+    int16_t *audio_buffer;
+    int audio_buffer_size;
+    // Samples of silence to queue up front when the stream runs dry
+    int16_t *audio_silence;
+    // How much audio the stream is kept at, in samples
+    int audio_target;
     int num_gamepads;
+    SDL_Thread *emu_thread;
+    SDL_Thread *audio_thread;
+    SDL_Semaphore *audio_ready;
+    NonesAudioQueue audio_queue;
+    SDL_AtomicInt running;
+    // Frames run since the render thread last looked, for the debug info
+    SDL_AtomicInt updates;
+    NonesInputQueue input_queue;
+    NonesTripleBuffer frames;
+    // Render thread side, the input as of the last poll
+    NonesInput input;
+    // Emulation thread side, taken from the newest input
     bool debug_info;
+    bool rewinding;
+    // Fast forward is on while the key is held or all the time with --fast-forward,
+    // at fast_forward_speed times real time or as fast as possible if that's 0
+    bool fast_forward;
+    bool fast_forward_locked;
+    float fast_forward_speed;
     bool quit;
 } Nones;
 
-void NonesRun(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sample_rate, const char *path, const char *audio_driver);
-void NonesPutSoundData(int16_t *buffer, const int buffer_size);
+void NonesRun(Nones *nones, bool ppu_warmup, bool swap_duty_cycles, const int sample_rate, const char *path, const char *audio_driver,
+              const int run_ahead, const bool run_ahead_instance, const bool fast_forward, const float fast_forward_speed,
+              const char *palette_path, const int audio_latency);
 
 #endif
@@ -0,0 +1,25 @@
+#include <stdatomic.h>
+
+#include "once.h"
+
+enum
+{
+    ONCE_NOT_RUN,
+    ONCE_RUNNING,
+    ONCE_DONE
+};
+
+// Systems can be created on several threads at once, the first call runs fn and any other
+// waits for it to finish, so nothing reads what fn sets up before it's complete
+void OnceRun(Once *once, void (*fn)(void))
+{
+    int expected = ONCE_NOT_RUN;
+    if (atomic_compare_exchange_strong(once, &expected, ONCE_RUNNING))
+    {
+        fn();
+        atomic_store(once, ONCE_DONE);
+    }
+
+    while (atomic_load(once) != ONCE_DONE)
+        ;
+}
@@ -0,0 +1,11 @@
+#ifndef ONCE_H
+#define ONCE_H
+
+#include <stdatomic.h>
+
+// Guards setup shared by every system, like tables that only depend on constants
+typedef atomic_int Once;
+
+void OnceRun(Once *once, void (*fn)(void));
+
+#endif
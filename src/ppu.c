@@ -6,7 +6,10 @@
 #include <string.h>
 #include <sys/types.h>
 
-#include <SDL3/SDL.h>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PPU_CONVERT_AVX2
+#endif
 
 #include "arena.h"
 #include "apu.h"
@@ -16,14 +19,9 @@
 #include "arena.h"
 #include "cart.h"
 #include "system.h"
-#include "nones.h"
 #include "utils.h"
 
-static uint8_t vram[0x800];
-// Pointers to handle mirroring
-static uint8_t *nametables[4];
-
-static Color sys_palette[64] =
+static const Color sys_palette[64] =
 {
     {0x66, 0x66, 0x66},
     {0x00, 0x2A, 0x88}, 
@@ -91,77 +89,212 @@ static Color sys_palette[64] =
     {0x00, 0x00, 0x00}
 };
 
-static void PpuApplyColorEmphasis(Ppu *ppu, Color *color, uint8_t color_index)
+// emphasis is the red, green and blue bits of the mask
+static void PpuApplyColorEmphasis(const uint8_t emphasis, Color *color, uint8_t color_index)
 {
     if (color_index == 0xE || color_index == 0xF)
         return;
 
-    if (ppu->mask.emphasize_red)
+    if (emphasis & 1)
     {
         color->b *= COLOR_ATTENUATION;
         color->g *= COLOR_ATTENUATION;
     }
 
-    if (ppu->mask.emphasize_green)
+    if (emphasis & 2)
     {
         color->b *= COLOR_ATTENUATION;
         color->r *= COLOR_ATTENUATION;
     }
 
-    if (ppu->mask.emphasize_blue)
+    if (emphasis & 4)
     {
         color->g *= COLOR_ATTENUATION;
         color->r *= COLOR_ATTENUATION;
     }
 }
 
-static Color GetBGColor(Ppu *ppu, const uint8_t palette_index, const uint8_t pixel)
+static uint32_t PpuPackColor(const Color color)
 {
-    // Compute palette memory address
-    const uint16_t palette_addr = 0x3F00 | (palette_index << 2) | pixel;
+    return (uint32_t)((color.r << 24) | (color.g << 16) | (color.b << 8) | 255);
+}
 
-    // When rendering is off and V points to palette memory;
-    // The backdrop color is replaced by the value from the low 5 bits of V
-    const bool backdrop_override = !ppu->rendering && (((ppu->v.raw & 0x3FFF) >= 0x3F00));
+// The other formats are worked out from the rgba table
+static void PpuBuildFormatLuts(uint32_t *lut)
+{
+    uint32_t *xrgb = &lut[PPU_PIXEL_XRGB8888 * PPU_PALETTE_LUT_SIZE];
+    uint32_t *rgb565 = &lut[PPU_PIXEL_RGB565 * PPU_PALETTE_LUT_SIZE];
 
-    // Read the color index from PPU palette memory
-    uint16_t color_index = ppu->palettes[palette_addr & 0x1F];
+    for (int i = 0; i < PPU_PALETTE_LUT_SIZE; i++)
+    {
+        const uint32_t r = lut[i] >> 24;
+        const uint32_t g = (lut[i] >> 16) & 0xFF;
+        const uint32_t b = (lut[i] >> 8) & 0xFF;
 
-    if (backdrop_override)
+        xrgb[i] = 0xFF000000 | lut[i] >> 8;
+        rgb565[i] = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+    }
+}
+
+// Fills in the emphasised colours from the 64 base ones
+static void PpuBuildPaletteLut(uint32_t *lut, const Color *colors)
+{
+    for (uint8_t emphasis = 0; emphasis < 8; emphasis++)
+    {
+        for (uint8_t i = 0; i < 64; i++)
+        {
+            Color color = colors[i];
+            PpuApplyColorEmphasis(emphasis, &color, i);
+            lut[emphasis << 6 | i] = PpuPackColor(color);
+        }
+    }
+
+    PpuBuildFormatLuts(lut);
+}
+
+static uint16_t PpuResolveColor(const Ppu *ppu, const uint8_t color_index)
+{
+    const uint8_t grey_mask = ppu->mask.grey_scale ? 0x30 : 0x3F;
+    return (uint16_t)((ppu->mask.raw >> 5) << 6 | (color_index & grey_mask));
+}
+
+void PPU_UpdatePaletteCache(Ppu *ppu)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        ppu->palette_cache[i] = PpuResolveColor(ppu, ppu->palettes[i]);
+    }
+}
+
+// Loads a .pal file, either the 64 colours (emphasis is worked out the same way as for the
+// built in palette) or all 512 with emphasis already applied
+int PPU_LoadPalette(Ppu *ppu, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        printf("Failed to open palette %s\n", path);
+        return -1;
+    }
+
+    uint8_t rgb[PPU_PALETTE_LUT_SIZE * 3];
+    const size_t size = fread(rgb, 1, sizeof(rgb), fp);
+    fclose(fp);
+
+    if (size == 64 * 3)
+    {
+        Color colors[64];
+        for (int i = 0; i < 64; i++)
+        {
+            colors[i] = (Color){ rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2] };
+        }
+
+        PpuBuildPaletteLut(ppu->palette_lut, colors);
+    }
+    else if (size == sizeof(rgb))
     {
-        color_index = ppu->palettes[ppu->v.palette.addr];
+        for (int i = 0; i < PPU_PALETTE_LUT_SIZE; i++)
+        {
+            ppu->palette_lut[i] = PpuPackColor((Color){ rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2] });
+        }
+
+        PpuBuildFormatLuts(ppu->palette_lut);
     }
-    else if (!pixel)
+    else
     {
-        // Use backdrop color
-        color_index = ppu->palettes[0];
+        printf("Invalid palette %s, expected 192 or 1536 bytes\n", path);
+        return -1;
     }
 
-    if (ppu->mask.grey_scale)
+    return 0;
+}
+
+static void PpuConvertLine(const uint16_t *line, void *pixels, const uint32_t *lut, const bool narrow)
+{
+    if (narrow)
     {
-        color_index &= 0x30;
+        uint16_t *out = pixels;
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            out[x] = (uint16_t)lut[line[x] & (PPU_PALETTE_LUT_SIZE - 1)];
+        }
     }
+    else
+    {
+        uint32_t *out = pixels;
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            out[x] = lut[line[x] & (PPU_PALETTE_LUT_SIZE - 1)];
+        }
+    }
+}
 
-    Color color = sys_palette[color_index & 0x3F];
-    PpuApplyColorEmphasis(ppu, &color, color_index);
+#ifdef PPU_CONVERT_AVX2
+// 16 pixels at a time, the indices are widened and the colours gathered from the table.
+// SSE2 has no gather so anything without AVX2 takes the scalar loop
+__attribute__((target("avx2")))
+static void PpuConvertLineAVX2(const uint16_t *line, void *pixels, const uint32_t *lut, const bool narrow)
+{
+    const __m256i index_mask = _mm256_set1_epi32(PPU_PALETTE_LUT_SIZE - 1);
+
+    for (int x = 0; x < SCREEN_WIDTH; x += 16)
+    {
+        const __m256i indices = _mm256_loadu_si256((const __m256i *)&line[x]);
+        const __m256i low = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(indices)), index_mask);
+        const __m256i high = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(indices, 1)), index_mask);
+        const __m256i colors_low = _mm256_i32gather_epi32((const int *)lut, low, 4);
+        const __m256i colors_high = _mm256_i32gather_epi32((const int *)lut, high, 4);
 
-    return color;
+        if (narrow)
+        {
+            // packus works within each 128-bit lane, the permute puts the pixels back in order
+            const __m256i packed = _mm256_packus_epi32(colors_low, colors_high);
+            _mm256_storeu_si256((__m256i *)&((uint16_t *)pixels)[x], _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+        else
+        {
+            _mm256_storeu_si256((__m256i *)&((uint32_t *)pixels)[x], colors_low);
+            _mm256_storeu_si256((__m256i *)&((uint32_t *)pixels)[x + 8], colors_high);
+        }
+    }
 }
+#endif
 
-static Color GetSpriteColor(Ppu *ppu, const uint8_t palette_index, const uint8_t pixel)
+// Turns a frame of colour indices into pixels through the palette, pitch is the distance
+// between lines in bytes
+void PPU_ConvertFrame(const Ppu *ppu, const uint16_t *frame, void *pixels, const int pitch, const PpuPixelFormat format)
 {
-    const uint16_t palette_addr = 0x10 | (palette_index << 2) | pixel;
-    uint16_t color_index = ppu->palettes[palette_addr];
+    const uint32_t *lut = &ppu->palette_lut[format * PPU_PALETTE_LUT_SIZE];
+    const bool narrow = format == PPU_PIXEL_RGB565;
+    void (*ConvertLine)(const uint16_t *, void *, const uint32_t *, const bool) = PpuConvertLine;
 
-    if (ppu->mask.grey_scale)
+#ifdef PPU_CONVERT_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        ConvertLine = PpuConvertLineAVX2;
+#endif
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
     {
-        color_index &= 0x30;
+        ConvertLine(&frame[y * SCREEN_WIDTH], (uint8_t *)pixels + (size_t)y * pitch, lut, narrow);
     }
+}
+
+static uint16_t GetBGColor(Ppu *ppu, const uint8_t palette_index, const uint8_t pixel)
+{
+    // When rendering is off and V points to palette memory;
+    // The backdrop color is replaced by the value from the low 5 bits of V
+    const bool backdrop_override = !ppu->rendering && (((ppu->v.raw & 0x3FFF) >= 0x3F00));
+
+    if (backdrop_override)
+        return ppu->palette_cache[ppu->v.palette.addr];
 
-    Color color = sys_palette[color_index & 0x3F];
-    PpuApplyColorEmphasis(ppu, &color, color_index);
+    // Use backdrop color for transparent pixels
+    return ppu->palette_cache[pixel ? (palette_index << 2) | pixel : 0];
+}
 
-    return color;
+static uint16_t GetSpriteColor(Ppu *ppu, const uint8_t palette_index, const uint8_t pixel)
+{
+    return ppu->palette_cache[0x10 | (palette_index << 2) | pixel];
 }
 
 static void PpuUpdateBus(Ppu *ppu, const uint16_t addr)
@@ -174,7 +307,7 @@ static void PpuUpdateBus(Ppu *ppu, const uint16_t addr)
         if (ppu->a12_low_count > 3)
         {
             //printf("Bus Addr: 0x%X -> 0x%X PPU A12: %d scanline:%d cycle: %d\n", ppu->bus_addr, addr, new_a12, ppu->scanline, ppu->cycle_counter);
-            PpuClockMMC3();
+            PpuClockMMC3(ppu->system);
         }
         ppu->a12_low_count = 0;
     }
@@ -189,7 +322,7 @@ static void PpuUpdateBus(Ppu *ppu, const uint16_t addr)
 static uint8_t PpuReadChr(Ppu *ppu, const uint16_t addr)
 {
     PpuUpdateBus(ppu, addr);
-    return PpuBusReadChrRom(addr);
+    return PpuBusReadChrRom(ppu->system, addr);
 }
 
 static void PpuCopyTtoV(Ppu *ppu)
@@ -198,7 +331,7 @@ static void PpuCopyTtoV(Ppu *ppu)
     // Transfer t to v
     ppu->v.raw = ppu->t.raw;
     if (~prev_a12 & ppu->v.raw_bits.bit12)
-        PpuClockMMC3();
+        PpuClockMMC3(ppu->system);
 
     ppu->copy_t_delay = 2;
     ppu->copy_t = false;
@@ -233,12 +366,12 @@ static uint16_t PpuGetNTAddr(Ppu *ppu)
 
 static void PpuNametableWrite(Ppu *ppu, uint16_t addr, uint8_t data)
 {
-    nametables[ppu->v.scrolling.name_table_sel][addr & 0x3FF] = data;
+    ppu->nametables[ppu->v.scrolling.name_table_sel][addr & 0x3FF] = data;
 }
 
 uint8_t PpuNametableRead(Ppu *ppu, uint16_t addr)
 {
-    return nametables[ppu->v.scrolling.name_table_sel][addr & 0x3FF];
+    return ppu->nametables[ppu->v.scrolling.name_table_sel][addr & 0x3FF];
 }
 
 // Horizontal scrolling
@@ -286,9 +419,13 @@ static void PpuIncrementScrollY(Ppu *ppu)
 static void PpuPaletteWrite(Ppu *ppu, const uint8_t palette_addr, const uint8_t data)
 {
     ppu->palettes[palette_addr] = data;
+    ppu->palette_cache[palette_addr] = PpuResolveColor(ppu, data);
 
     if (!(palette_addr & 3))
+    {
         ppu->palettes[palette_addr ^ 0x10] = data;
+        ppu->palette_cache[palette_addr ^ 0x10] = ppu->palette_cache[palette_addr];
+    }
 }
 
 static void PPU_WriteCtrl(Ppu *ppu, const uint8_t data)
@@ -309,7 +446,7 @@ void PPU_WriteData(Ppu *ppu, const uint8_t data)
         case 0x1:
         {
             // chr rom is actually chr ram
-            PpuBusWriteChrRam(addr, data);
+            PpuBusWriteChrRam(ppu->system, addr, data);
             break;
         }
         case 0x2:
@@ -359,7 +496,7 @@ uint8_t PPU_ReadStatus(Ppu *ppu)
     PpuStatus ret_status = ppu->status;
     ret_status.open_bus = ppu->io_bus & 0x1F;
 
-    //if (SystemGetCpu()->pc != 0xF073)
+    //if (ppu->system->cpu->pc != 0xF073)
     //    printf("PPU_ReadStatus : %d scanline:%d cycle: %d\n", ppu->status.vblank, ppu->scanline, ppu->cycle_counter);
 
     // Clear vblank flag here and on the next ppu cycle
@@ -420,7 +557,7 @@ uint8_t PPU_ReadData(Ppu *ppu)
         // Auto-increment address
         ppu->v.raw += ppu->ctrl.vram_addr_inc ? 32 : 1;
         if (~prev_a12 & ppu->v.raw_bits.bit12)
-            PpuClockMMC3();
+            PpuClockMMC3(ppu->system);
     }
 
     return data;
@@ -472,7 +609,8 @@ void WritePPURegister(Ppu *ppu, const uint16_t addr, const uint8_t data)
             break;
         case PPU_MASK:
             ppu->mask.raw = data;
-            //printf("PPU Mask set at scanline: %d cycle: %d frame: %lu cpu cycles: %ld\n", ppu->scanline, ppu->cycle_counter, ppu->frames, SystemGetCpu()->cycles);
+            PPU_UpdatePaletteCache(ppu);
+            //printf("PPU Mask set at scanline: %d cycle: %d frame: %lu cpu cycles: %ld\n", ppu->scanline, ppu->cycle_counter, ppu->frames, ppu->system->cpu->cycles);
             break;
         case OAM_ADDR:
             ppu->oam1_addr = data;
@@ -506,16 +644,16 @@ void WritePPURegister(Ppu *ppu, const uint16_t addr, const uint8_t data)
     ppu->io_bus = data;
 }
 
-void PpuSetNameTable(int nt, int mode)
+void PpuSetNameTable(Ppu *ppu, int nt, int mode, uint8_t *ext_ram)
 {
     switch (mode)
     {
         case 0:
         case 1:
-            nametables[nt] = &vram[mode * 0x400];
+            ppu->nametables[nt] = &ppu->vram[mode * 0x400];
             break;
         case 2:
-            nametables[nt] = &mmc5.ext_ram[0];
+            ppu->nametables[nt] = &ext_ram[0];
             break;
         default:
             DEBUG_LOG("Unsupported NT mode! %d\n", mode);
@@ -525,33 +663,33 @@ void PpuSetNameTable(int nt, int mode)
 
 // Set the arrangement mode for the nametables
 // Note that arrangement is the inverse of mirroring
-void PpuSetArrangement(NameTableArrangement mode, int page)
+void PpuSetArrangement(Ppu *ppu, NameTableArrangement mode, int page)
 {
     switch (mode)
     {
         case NAMETABLE_VERTICAL:
-            nametables[0] = &vram[0x000];  // NT0 (0x2000)
-            nametables[1] = &vram[0x000];  // NT0 (Mirrored at 0x2400)
-            nametables[2] = &vram[0x400];  // NT1 (0x2800)
-            nametables[3] = &vram[0x400];  // NT1 (Mirrored at 0x2C00)
+            ppu->nametables[0] = &ppu->vram[0x000];  // NT0 (0x2000)
+            ppu->nametables[1] = &ppu->vram[0x000];  // NT0 (Mirrored at 0x2400)
+            ppu->nametables[2] = &ppu->vram[0x400];  // NT1 (0x2800)
+            ppu->nametables[3] = &ppu->vram[0x400];  // NT1 (Mirrored at 0x2C00)
             break;
         case NAMETABLE_HORIZONTAL:
-            nametables[0] = &vram[0x000];  // NT0 (0x2000)
-            nametables[1] = &vram[0x400];  // NT1 (0x2400)
-            nametables[2] = &vram[0x000];  // NT0 (Mirrored at 0x2800)
-            nametables[3] = &vram[0x400];  // NT1 (Mirrored at 0x2C00)
+            ppu->nametables[0] = &ppu->vram[0x000];  // NT0 (0x2000)
+            ppu->nametables[1] = &ppu->vram[0x400];  // NT1 (0x2400)
+            ppu->nametables[2] = &ppu->vram[0x000];  // NT0 (Mirrored at 0x2800)
+            ppu->nametables[3] = &ppu->vram[0x400];  // NT1 (Mirrored at 0x2C00)
             break;
         case NAMETABLE_SINGLE_SCREEN:
-            nametables[0] = &vram[0x400 * page];
-            nametables[1] = &vram[0x400 * page];
-            nametables[2] = &vram[0x400 * page];
-            nametables[3] = &vram[0x400 * page];
+            ppu->nametables[0] = &ppu->vram[0x400 * page];
+            ppu->nametables[1] = &ppu->vram[0x400 * page];
+            ppu->nametables[2] = &ppu->vram[0x400 * page];
+            ppu->nametables[3] = &ppu->vram[0x400 * page];
             break;
         case NAMETABLE_FOUR_SCREEN:
-            nametables[0] = &vram[0x000];  // NT0 (0x2000)
-            nametables[1] = &vram[0x400];  // NT1 (0x2400)
-            nametables[2] = &mmc5.ext_ram[0x000];  // NT0 (0x2800)
-            nametables[3] = &mmc5.ext_ram[0x400];  // NT1 (0x2C00)
+            ppu->nametables[0] = &ppu->vram[0x000];  // NT0 (0x2000)
+            ppu->nametables[1] = &ppu->vram[0x400];  // NT1 (0x2400)
+            ppu->nametables[2] = &ppu->vram[0x800];  // NT2 (0x2800)
+            ppu->nametables[3] = &ppu->vram[0xC00];  // NT3 (0x2C00)
             break;
         default:
             printf("Unimplemented Nametable arrangement mode %d detected!\n", mode);
@@ -559,11 +697,15 @@ void PpuSetArrangement(NameTableArrangement mode, int page)
     }
 }
 
-void PPU_Init(Ppu *ppu, int arrangement, bool warmup, uint32_t **buffers, const uint32_t buffer_size)
+void PPU_Init(Ppu *ppu, struct System *system, Arena *arena, int arrangement, bool warmup, uint16_t **buffers, const uint32_t buffer_size)
 {
     memset(ppu, 0, sizeof(*ppu));
+    ppu->system = system;
+    ppu->palette_lut = ArenaPush(arena, PPU_PIXEL_FORMAT_COUNT * PPU_PALETTE_LUT_SIZE * sizeof(uint32_t));
+    PpuBuildPaletteLut(ppu->palette_lut, sys_palette);
+    PPU_UpdatePaletteCache(ppu);
     ppu->arrangement = arrangement;
-    PpuSetArrangement(ppu->arrangement, 0);
+    PpuSetArrangement(ppu, ppu->arrangement, 0);
     ppu->rendering = false;
     ppu->buffers[0] = buffers[0];
     ppu->buffers[1] = buffers[1];
@@ -574,12 +716,12 @@ void PPU_Init(Ppu *ppu, int arrangement, bool warmup, uint32_t **buffers, const
     //ppu->status.open_bus = 0x1C;
 }
 
-static void DrawPixel(uint32_t *buffer, int x, int y, Color color)
+static void DrawPixel(uint16_t *buffer, int x, int y, uint16_t color)
 {
     if (x < 0 || y < 0 || x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT)
         return;
 
-    buffer[y * SCREEN_WIDTH + x] = (uint32_t)((color.r << 24) | (color.g << 16) | (color.b << 8) | 255);
+    buffer[y * SCREEN_WIDTH + x] = color;
 }
 
 static void PpuResetOAM2(Ppu *ppu)
@@ -721,9 +863,9 @@ static void PpuRenderSpritePixel(Ppu *ppu, const int xpos, const int scanline, c
 
                 PpuHandleSprite0Hit(ppu, xpos, i, bg_pixel, sprite_pixel);
 
-                if (sprite_pixel && (!fifo_lane->attribs.priority || !bg_pixel))
+                if (sprite_pixel && (!fifo_lane->attribs.priority || !bg_pixel) && !ppu->skip_output)
                 {
-                    Color color = GetSpriteColor(ppu, fifo_lane->attribs.palette, sprite_pixel);
+                    const uint16_t color = GetSpriteColor(ppu, fifo_lane->attribs.palette, sprite_pixel);
                     DrawPixel(ppu->buffers[0], xpos, scanline, color);
                 }
             }
@@ -833,8 +975,11 @@ static void PpuRender(Ppu *ppu, int scanline)
         const uint8_t bg_pixel = ((bg_pixel_high << 1) | bg_pixel_low) * draw_bg;
         const uint8_t bg_palette = (bg_palette_high << 1) | bg_palette_low;
 
-        Color color = GetBGColor(ppu, bg_palette, bg_pixel);
-        DrawPixel(ppu->buffers[0], xpos, scanline, color);
+        if (!ppu->skip_output)
+        {
+            const uint16_t color = GetBGColor(ppu, bg_palette, bg_pixel);
+            DrawPixel(ppu->buffers[0], xpos, scanline, color);
+        }
 
         PpuRenderSpritePixel(ppu, xpos, scanline, bg_pixel);
     }
@@ -904,6 +1049,7 @@ static void PpuCycleUpdate(Ppu *ppu)
     if (!ppu->cycle_counter && !ppu->scanline)
     {
         ppu->frame_finished = true;
+        ppu->skip_output = ppu->skip_next_output;
         // Clear io bus at the end of each frame
         // (Actually random on real hardware and can be up to a 30 frame delay)
         ppu->io_bus = 0;
@@ -991,8 +1137,15 @@ void PPU_Tick(Ppu *ppu)
         ppu->bus_addr = ppu->v.raw & 0x3FFF;
         // Vblank starts at scanline 241
         ppu->status.vblank = 1;
-        // Copy the finished image in the back buffer to the front buffer
-        memcpy(ppu->buffers[1], ppu->buffers[0], ppu->buffer_size);
+        // The finished image in the back buffer becomes the front buffer, every pixel of the
+        // old front buffer is drawn over during the next frame so nothing needs copying
+        if (!ppu->skip_output)
+        {
+            uint16_t *front = ppu->buffers[0];
+            ppu->buffers[0] = ppu->buffers[1];
+            ppu->buffers[1] = front;
+            ++ppu->frames_output;
+        }
     }
 
     // Clear VBlank flag at scanline 261, dot 1
@@ -1017,7 +1170,7 @@ void PPU_Tick(Ppu *ppu)
         ppu->v.raw += ppu->delayed_vram_inc;
         ppu->delayed_vram_inc = 0;
         if (~prev_a12 & ppu->v.raw_bits.bit12)
-            PpuClockMMC3();
+            PpuClockMMC3(ppu->system);
     }
 
     if (ppu->copy_t)
@@ -1032,6 +1185,39 @@ void PPU_Tick(Ppu *ppu)
     PpuCycleUpdate(ppu);
 }
 
+// Number of dots until the next one that can be seen from outside without going through the regs,
+// vblank starting (nmi) or the frame finishing. It's a lower bound, the frame ends on dot 339
+// of the pre-render line when the odd frame dot gets skipped
+int PpuDotsUntilEvent(const Ppu *ppu)
+{
+    const int dot = ppu->scanline * 341 + ppu->cycle_counter;
+    const int vblank_dot = 241 * 341 + 1;
+    const int frame_end_dot = 261 * 341 + 339;
+
+    if (dot <= vblank_dot)
+        return vblank_dot - dot;
+
+    return MAX(frame_end_dot - dot, 0);
+}
+
+// Number of dots until the start of the nth line from here that fetches tiles (the visible lines
+// and the pre-render one), 0 for the current line. A lower bound as well, it leaves room for
+// a skipped odd frame dot on every pre-render line it passes
+int PpuDotsUntilFetchLine(const Ppu *ppu, const int lines)
+{
+    if (!lines)
+        return 0;
+
+    // Lines numbered from the pre-render one so the fetching ones are 0-240 in every frame
+    const int fetch_lines = 241;
+    const int line = ppu->scanline == 261 ? 0 : ppu->scanline + 1;
+    const int target = MIN(line, fetch_lines - 1) + lines;
+    const int frames = target / fetch_lines;
+    const int target_line = frames * 262 + target % fetch_lines;
+
+    return MAX((target_line - line) * 341 - ppu->cycle_counter - frames - 1, 0);
+}
+
 void PPU_Reset(Ppu *ppu)
 {
     ppu->cycle_counter = 0;
@@ -1041,4 +1227,5 @@ void PPU_Reset(Ppu *ppu)
     ppu->ctrl.raw = 0;
     ppu->mask.raw = 0;
     ppu->buffered_data = 0;
+    PPU_UpdatePaletteCache(ppu);
 }
@@ -10,6 +10,10 @@
 #define PPU_RAM_SIZE 0x1000
 #define MISC_START_ADDR 0x3000
 #define MISC_SIZE 0xF00
+
+// Visible output size
+#define SCREEN_WIDTH 256
+#define SCREEN_HEIGHT 240
 #define PALETTE_START_ADDR 0x3F00
 
 // PPU regs
@@ -25,6 +29,17 @@
 
 // For color emphasis
 #define COLOR_ATTENUATION 0.816328f
+// The 64 colours under each of the 8 emphasis combinations
+#define PPU_PALETTE_LUT_SIZE (64 * 8)
+
+// What PPU_ConvertFrame can turn a frame of colour indices into
+typedef enum
+{
+    PPU_PIXEL_RGBA8888,
+    PPU_PIXEL_XRGB8888,
+    PPU_PIXEL_RGB565,
+    PPU_PIXEL_FORMAT_COUNT
+} PpuPixelFormat;
 
 typedef enum
 {
@@ -255,21 +270,34 @@ typedef struct
 
 typedef struct
 {
+    struct System *system;
+    // 2 KiB on the console, the upper half is only used by four-screen carts
+    uint8_t vram[0x1000];
+    // Pointers to handle mirroring
+    uint8_t *nametables[4];
     Sprite oam1[64];
     Sprite oam2[8];
     SpriteFifo fifo[8];
     uint8_t palettes[32];
+    // palettes as colour indices (emphasis bits << 6 | colour) with the current greyscale and
+    // emphasis bits, updated when palette ram or the mask is written so drawing a pixel is a single load
+    uint16_t palette_cache[32];
+    // Every colour index in each of the pixel formats, one table of PPU_PALETTE_LUT_SIZE per format
+    uint32_t *palette_lut;
     uint64_t frames;
     int32_t cycle_counter;
     int scanline;
     int a12_low_count;
     uint32_t bus_addr;
 
-    // Double buffer for SDL
+    // Double buffer of colour indices for the frontend, PPU_ConvertFrame turns them into pixels
     // buffer 0 is the backbuffer
     // buffer 1 is the frontbuffer
-    uint32_t *buffers[2];
+    uint16_t *buffers[2];
     uint32_t buffer_size;
+    // Bumped every time a new frame is swapped into the front buffer, the frontend only has
+    // to upload the front buffer when it changed
+    uint64_t frames_output;
 
     // PPU internel regs
     struct {
@@ -314,6 +342,11 @@ typedef struct
     bool rendering;
     bool clear_vblank;
     bool frame_finished;
+    // Frames nobody sees skip the colour lookups and buffer writes, everything that
+    // affects timing is still run. skip_next_output is latched into skip_output as each
+    // frame starts, so a frame is either drawn whole or not at all
+    bool skip_output;
+    bool skip_next_output;
     bool skipped_cycle;
     bool copy_t;
 
@@ -337,14 +370,19 @@ typedef struct
     uint8_t io_bus;
 } Ppu;
 
-void PPU_Init(Ppu *ppu, int arrangement, bool warmup, uint32_t **buffers, uint32_t buffer_size);
+void PPU_Init(Ppu *ppu, struct System *system, Arena *arena, int arrangement, bool warmup, uint16_t **buffers, uint32_t buffer_size);
 void PPU_Tick(Ppu *ppu);
 void PPU_Reset(Ppu *ppu);
 void PpuUpdateRenderingState(Ppu *ppu);
 uint8_t ReadPPURegister(Ppu *ppu, const uint16_t addr);
 void WritePPURegister(Ppu *ppu, const uint16_t addr, const uint8_t data);
-void PpuSetArrangement(NameTableArrangement mode, int page);
-void PpuSetNameTable(int nt, int mode);
+void PpuSetArrangement(Ppu *ppu, NameTableArrangement mode, int page);
+void PpuSetNameTable(Ppu *ppu, int nt, int mode, uint8_t *ext_ram);
 uint8_t PpuNametableRead(Ppu *ppu, uint16_t addr);
+int PpuDotsUntilEvent(const Ppu *ppu);
+int PpuDotsUntilFetchLine(const Ppu *ppu, const int lines);
+void PPU_UpdatePaletteCache(Ppu *ppu);
+int PPU_LoadPalette(Ppu *ppu, const char *path);
+void PPU_ConvertFrame(const Ppu *ppu, const uint16_t *frame, void *pixels, const int pitch, const PpuPixelFormat format);
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef enum
+{
+    // Everything done inside SystemRun, ppu and apu ticks included
+    PROFILE_CPU,
+    PROFILE_PPU,
+    PROFILE_APU,
+    PROFILE_ZONES
+} ProfileZone;
+
+typedef struct
+{
+    uint64_t ticks[PROFILE_ZONES];
+    bool enabled;
+} Profile;
+
+// Raw timestamp, the tsc on x86 since it's cheap enough to take a few times per cpu cycle.
+// Only meant to be compared against other timestamps from the same run
+static inline uint64_t ProfileNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// The zones are only compiled in with NONES_PROFILE (make bench),
+// and even then they do nothing until the profile is enabled
+#ifdef NONES_PROFILE
+#define PROFILE_BEGIN(profile, start) \
+    const uint64_t start = (profile)->enabled ? ProfileNow() : 0
+#define PROFILE_END(profile, zone, start) \
+do { if ((profile)->enabled) (profile)->ticks[zone] += ProfileNow() - (start); } while (0)
+#else
+#define PROFILE_BEGIN(profile, start) ((void)0)
+#define PROFILE_END(profile, zone, start) ((void)0)
+#endif
+
+#endif
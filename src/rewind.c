@@ -0,0 +1,220 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "rewind.h"
+#include "system.h"
+#include "utils.h"
+
+// Every delta in the ring is framed by its length on both sides, the one in front is
+// read when the oldest delta is dropped and the one behind when stepping back
+#define REWIND_FRAME_SIZE (2 * sizeof(uint32_t))
+
+static uint8_t *WriteVarint(uint8_t *out, size_t val)
+{
+    while (val >= 0x80)
+    {
+        *out++ = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    *out++ = (uint8_t)val;
+    return out;
+}
+
+static const uint8_t *ReadVarint(const uint8_t *in, size_t *val)
+{
+    size_t result = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do
+    {
+        byte = *in++;
+        result |= (size_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *val = result;
+    return in;
+}
+
+// xor of the two states as pairs of (bytes unchanged, bytes changed) runs followed by the
+// changed bytes. The worst case of every other byte changing is 1.5x the state size
+static size_t RewindPack(uint8_t *out, const uint8_t *from, const uint8_t *to, const size_t size)
+{
+    uint8_t *start = out;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        const size_t same_start = i;
+        while (i < size && from[i] == to[i])
+            i++;
+
+        const size_t diff_start = i;
+        while (i < size && from[i] != to[i])
+            i++;
+
+        out = WriteVarint(out, diff_start - same_start);
+        out = WriteVarint(out, i - diff_start);
+        for (size_t j = diff_start; j < i; j++)
+        {
+            *out++ = from[j] ^ to[j];
+        }
+    }
+
+    return out - start;
+}
+
+static void RewindUnpack(uint8_t *out, const uint8_t *from, const uint8_t *packed, const size_t size)
+{
+    size_t i = 0;
+
+    while (i < size)
+    {
+        size_t same, diff;
+        packed = ReadVarint(packed, &same);
+        packed = ReadVarint(packed, &diff);
+
+        memcpy(&out[i], &from[i], same);
+        i += same;
+
+        for (size_t j = 0; j < diff; j++, i++)
+        {
+            out[i] = from[i] ^ *packed++;
+        }
+    }
+}
+
+static void RingWrite(Rewind *rewind, size_t pos, const void *data, const size_t size)
+{
+    pos %= rewind->ring_size;
+    const size_t first = MIN(size, rewind->ring_size - pos);
+
+    memcpy(&rewind->ring[pos], data, first);
+    memcpy(rewind->ring, (const uint8_t *)data + first, size - first);
+}
+
+static void RingRead(const Rewind *rewind, size_t pos, void *data, const size_t size)
+{
+    pos %= rewind->ring_size;
+    const size_t first = MIN(size, rewind->ring_size - pos);
+
+    memcpy(data, &rewind->ring[pos], first);
+    memcpy((uint8_t *)data + first, rewind->ring, size - first);
+}
+
+static void RewindDropOldest(Rewind *rewind)
+{
+    uint32_t len;
+    RingRead(rewind, rewind->head + rewind->ring_size - rewind->used, &len, sizeof(len));
+
+    rewind->used -= len + REWIND_FRAME_SIZE;
+    rewind->num_deltas--;
+}
+
+// ring_size is fixed here, everything comes out of the arena up front so capturing
+// never allocates
+Rewind *RewindCreate(Arena *arena, System *system, const size_t ring_size, const int interval)
+{
+    Rewind *rewind = ArenaPush(arena, sizeof(Rewind));
+    memset(rewind, 0, sizeof(*rewind));
+
+    rewind->state_size = SystemStateSize(system);
+    rewind->state = ArenaPush(arena, rewind->state_size);
+    rewind->scratch = ArenaPush(arena, rewind->state_size);
+    rewind->packed = ArenaPush(arena, rewind->state_size * 2 + 16);
+    rewind->ring = ArenaPush(arena, ring_size);
+    rewind->ring_size = ring_size;
+    rewind->interval = MAX(interval, 1);
+
+    return rewind;
+}
+
+// Called once a frame, every interval frames the system is snapshotted and the delta back
+// to the previous snapshot is added to the ring. The cost is a save state and one pass over
+// it no matter how much changed
+void RewindCapture(Rewind *rewind, System *system)
+{
+    if (++rewind->frame_counter < rewind->interval)
+        return;
+
+    rewind->frame_counter = 0;
+
+    if (!rewind->has_state)
+    {
+        SystemSaveState(system, rewind->state, rewind->state_size);
+        rewind->has_state = true;
+        return;
+    }
+
+    SystemSaveState(system, rewind->scratch, rewind->state_size);
+
+    const size_t packed_size = RewindPack(rewind->packed, rewind->state, rewind->scratch, rewind->state_size);
+    const size_t frame_size = packed_size + REWIND_FRAME_SIZE;
+
+    if (frame_size <= rewind->ring_size)
+    {
+        while (rewind->used + frame_size > rewind->ring_size)
+            RewindDropOldest(rewind);
+
+        const uint32_t len = (uint32_t)packed_size;
+        RingWrite(rewind, rewind->head, &len, sizeof(len));
+        RingWrite(rewind, rewind->head + sizeof(len), rewind->packed, packed_size);
+        RingWrite(rewind, rewind->head + sizeof(len) + packed_size, &len, sizeof(len));
+
+        rewind->head = (rewind->head + frame_size) % rewind->ring_size;
+        rewind->used += frame_size;
+        rewind->num_deltas++;
+    }
+    else
+    {
+        // Can't link this snapshot to the older ones, history starts over from here
+        rewind->head = 0;
+        rewind->used = 0;
+        rewind->num_deltas = 0;
+    }
+
+    uint8_t *tmp = rewind->state;
+    rewind->state = rewind->scratch;
+    rewind->scratch = tmp;
+}
+
+// Loads the snapshot before the newest one and makes it the newest, returns false once the
+// history runs out (the oldest snapshot is loaded again so the rewind holds on it)
+bool RewindStep(Rewind *rewind, System *system)
+{
+    if (!rewind->has_state)
+        return false;
+
+    // Capturing starts counting again from the loaded snapshot
+    rewind->frame_counter = 0;
+
+    if (!rewind->num_deltas)
+    {
+        SystemLoadState(system, rewind->state, rewind->state_size);
+        return false;
+    }
+
+    const size_t end = rewind->head + rewind->ring_size;
+    uint32_t len;
+    RingRead(rewind, end - sizeof(len), &len, sizeof(len));
+    RingRead(rewind, end - sizeof(len) - len, rewind->packed, len);
+
+    RewindUnpack(rewind->scratch, rewind->state, rewind->packed, rewind->state_size);
+
+    rewind->head = (end - len - REWIND_FRAME_SIZE) % rewind->ring_size;
+    rewind->used -= len + REWIND_FRAME_SIZE;
+    rewind->num_deltas--;
+
+    uint8_t *tmp = rewind->state;
+    rewind->state = rewind->scratch;
+    rewind->scratch = tmp;
+
+    SystemLoadState(system, rewind->state, rewind->state_size);
+    return true;
+}
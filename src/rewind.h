@@ -0,0 +1,46 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "system.h"
+
+// 32 MiB lasts from several minutes to around an hour, depending on how much memory the game changes
+#define REWIND_DEFAULT_SIZE (32 * 1024 * 1024)
+// Frames between snapshots
+#define REWIND_DEFAULT_INTERVAL 2
+
+// History of save states, newest last. Only the newest state is kept whole, every older one is
+// stored as the xor against the one after it, compressed by dropping the runs of zeros
+// (most of ram, vram and oam doesn't change between snapshots).
+// Stepping back undoes one delta at a time, when the ring is full the oldest deltas are dropped
+typedef struct
+{
+    uint8_t *ring;
+    size_t ring_size;
+    // Where the next delta goes and how many bytes of deltas are in the ring behind it
+    size_t head;
+    size_t used;
+    int num_deltas;
+
+    // Newest snapshot, the one the deltas in the ring lead back from
+    uint8_t *state;
+    // New snapshot being taken or an old one being rebuilt
+    uint8_t *scratch;
+    // Compressed delta before it's copied into the ring
+    uint8_t *packed;
+    size_t state_size;
+    bool has_state;
+
+    int interval;
+    int frame_counter;
+} Rewind;
+
+Rewind *RewindCreate(Arena *arena, System *system, const size_t ring_size, const int interval);
+void RewindCapture(Rewind *rewind, System *system);
+bool RewindStep(Rewind *rewind, System *system);
+
+#endif
@@ -10,12 +10,11 @@
 #include "apu.h"
 #include "cart.h"
 #include "system.h"
+#include "jit.h"
 #include "mapper.h"
 #include "ppu.h"
 #include "utils.h"
 
-static System *system_ptr = NULL;
-
 System *SystemCreate(Arena *arena)
 {
     System *system = ArenaPush(arena, sizeof(System));
@@ -26,8 +25,21 @@ System *SystemCreate(Arena *arena)
     system->joy_pad1 = ArenaPush(arena, sizeof(JoyPad));
     system->joy_pad2 = ArenaPush(arena, sizeof(JoyPad));
     system->sys_ram = ArenaPush(arena, CPU_RAM_SIZE);
+    system->cart->system = system;
 
-    system_ptr = system;
+    for (int i = 0; i < SYSTEM_EVENT_COUNT; i++)
+    {
+        system->events[i] = UINT64_MAX;
+    }
+    system->next_event = UINT64_MAX;
+    system->skip_idle_loops = true;
+
+    // Console side of the memory map, cart mappings get added on top by the mapper
+    SystemAddMemMapRead(system, 0x0000, 0x1FFF, MEM_RAM_READ);
+    SystemAddMemMapRead(system, 0x2000, 0x3FFF, MEM_PPU_READ);
+    SystemAddMemMapWrite(system, 0x0000, 0x1FFF, MEM_RAM_WRITE);
+    SystemAddMemMapWrite(system, 0x2000, 0x3FFF, MEM_PPU_WRITE);
+    SystemAddMemMapWrite(system, 0x4000, 0x4017, MEM_IO_WRITE);
     return system;
 }
 
@@ -36,17 +48,48 @@ int SystemLoadCart(Arena *arena, System *system, const char *path)
     return CartLoad(arena, system->cart, path);
 }
 
+// Banked prg rom pages point at the currently selected banks,
+// so they're remapped whenever the mapper could have switched one
+static void SystemUpdatePrgPages(System *system)
+{
+    if (!system->cart->PrgAddrFn)
+        return;
+
+    for (uint32_t i = 0; i < MEM_PAGE_COUNT; i++)
+    {
+        MemPage *page = &system->read_pages[i];
+
+        if (page->num_maps == 1 && system->mem_map_r[page->maps[0]].op == MEM_PRG_READ)
+            page->data = MapperGetPrgRomPage(system->cart, i << MEM_PAGE_SHIFT);
+    }
+}
+
 void SystemInit(System *system, Arena *arena, bool ppu_warmup, bool swap_duty_cycles,
-                int sample_rate, uint32_t **buffers, const uint32_t buffer_size)
+                int sample_rate, const ApuSynth synth, uint16_t **buffers, const uint32_t buffer_size)
+{
+    // The mapper's bank count isn't known until after its pages were added
+    SystemUpdatePrgPages(system);
+    PPU_Init(system->ppu, system, arena, system->cart->arrangement, ppu_warmup, buffers, buffer_size);
+    APU_Init(system->apu, system, arena, swap_duty_cycles, sample_rate, synth);
+    CPU_Init(system->cpu, system);
+    SystemSyncPpu(system);
+}
+
+// Must be called after SystemInit, the apu state is reset on init
+void SystemSetAudioCallback(System *system, ApuSampleFn SampleFn, void *userdata)
 {
-    PPU_Init(system->ppu, system->cart->arrangement, ppu_warmup, buffers, buffer_size);
-    APU_Init(system->apu, arena, swap_duty_cycles, sample_rate);
-    CPU_Init(system->cpu);
+    system->apu->mixer.SampleFn = SampleFn;
+    system->apu->mixer.userdata = userdata;
 }
 
-uint8_t SystemReadOpenBus(void)
+void SystemSetAudioMix(System *system, const ApuMix mix)
 {
-    return system_ptr->bus_data;
+    APU_SetMix(system->apu, mix);
+}
+
+uint8_t SystemReadOpenBus(System *system)
+{
+    return system->bus_data;
 }
 
 static void SystemRamWrite(System *system, const uint16_t addr, const uint8_t data)
@@ -74,8 +117,8 @@ static void SystemStartOamDma(System *system, const uint8_t page_num)
     system->oam_dma_triggered = false;
     uint16_t base_addr = (page_num * 0x100);
     // Add cpu halt cycle
-    SystemTick();
-    BusRead(system->cpu_addr);
+    SystemTick(system);
+    BusRead(system, system->cpu_addr);
 
     bool single_dma_cycle = false;
     system->oam_dma_bytes_remaining = 256;
@@ -84,20 +127,20 @@ static void SystemStartOamDma(System *system, const uint8_t page_num)
         // OAM Alignment cycle if needed
         if (system->cpu->cycles & 1)
         {
-            SystemTick();
-            BusRead(system->cpu_addr);
+            SystemTick(system);
+            BusRead(system, system->cpu_addr);
         }
 
-        SystemTick();
+        SystemTick(system);
         // OAM DMA uses Ppu reg $2004 (OAM_DATA) internally
         // Get
-        const uint8_t data = BusRead(base_addr++);
-        SystemTick();
+        const uint8_t data = BusRead(system, base_addr++);
+        SystemTick(system);
         // Put
-        BusWrite(OAM_DATA_REG, data);
+        BusWrite(system, OAM_DATA_REG, data);
         if (system->dmc_dma_triggered && system->oam_dma_bytes_remaining > 2)
         {
-            SystemTick();
+            SystemTick(system);
             ApuDmcDmaUpdate(system->apu);
             system->dmc_dma_triggered = false;
         }
@@ -111,23 +154,23 @@ static void SystemStartOamDma(System *system, const uint8_t page_num)
     if (system->dmc_dma_triggered && !single_dma_cycle)
     {
         // DMC DMA dummy cycle
-        SystemTick();
-        BusRead(system->cpu_addr);
+        SystemTick(system);
+        BusRead(system, system->cpu_addr);
 
         // DMC Dma Alignment cycle if needed
         if (system->cpu->cycles & 1)
         {
-            SystemTick();
-            BusRead(system->cpu_addr);
+            SystemTick(system);
+            BusRead(system, system->cpu_addr);
         }
 
-        SystemTick();
+        SystemTick(system);
         ApuDmcDmaUpdate(system->apu);
         system->dmc_dma_triggered = false;
     }
     else if (system->dmc_dma_triggered && single_dma_cycle)
     {
-        SystemTick();
+        SystemTick(system);
         ApuDmcDmaUpdate(system->apu);
         system->dmc_dma_triggered = false;
     }
@@ -136,8 +179,8 @@ static void SystemStartOamDma(System *system, const uint8_t page_num)
 static void SystemStartDmcDma(System *system)
 {
     // Add cpu halt cycle
-    SystemTick();
-    BusRead(system->cpu_addr);
+    SystemTick(system);
+    BusRead(system, system->cpu_addr);
 
     if (ExplicitAbortDmcDma(system))
     {
@@ -146,34 +189,211 @@ static void SystemStartDmcDma(System *system)
     }
 
     // Add cpu dummy cycle
-    SystemTick();
-    BusRead(system->cpu_addr);
+    SystemTick(system);
+    BusRead(system, system->cpu_addr);
 
     // Alignment cycle if needed
     if (system->cpu->cycles & 1)
     {
-        SystemTick();
-        BusRead(system->cpu_addr);
+        SystemTick(system);
+        BusRead(system, system->cpu_addr);
     }
 
-    SystemTick();
+    SystemTick(system);
     ApuDmcDmaUpdate(system->apu);
     system->dmc_dma_triggered = false;
 }
 
-void SystemSignalDmcDma(void)
+void SystemSignalDmcDma(System *system)
 {
-    system_ptr->dma_pending = true;
-    system_ptr->dmc_dma_triggered = true;
+    system->dma_pending = true;
+    system->dmc_dma_triggered = true;
+}
+
+// The PPU pulls /NMI low if and only if both vblank_flag and NMI_output are true.
+static uint8_t SystemReadNmiPin(System *system)
+{
+    return ~(system->ppu->ctrl.vblank_nmi & system->ppu->status.vblank);
+}
+
+static void SystemPollNmi(System *system)
+{
+    uint8_t current_nmi_pin = SystemReadNmiPin(system);
+    if (~current_nmi_pin & system->cpu->nmi_pin)
+    {
+        system->cpu->nmi_pending = true;
+        //printf("NMI falling edge at frame: %ld ppu cycle: %d scanline:%d\n",
+        //        system->ppu->frames, system->ppu->cycle_counter, system->ppu->scanline);
+    }
+    system->cpu->nmi_pin = current_nmi_pin;
+}
+
+static void SystemUpdateNextEvent(System *system)
+{
+    system->next_event = UINT64_MAX;
+    for (int i = 0; i < SYSTEM_EVENT_COUNT; i++)
+    {
+        system->next_event = MIN(system->next_event, system->events[i]);
+    }
+}
+
+void SystemScheduleEvent(System *system, SystemEvent event, const uint64_t cycle)
+{
+    system->events[event] = cycle;
+    SystemUpdateNextEvent(system);
+}
+
+void SystemCancelEvent(System *system, SystemEvent event)
+{
+    SystemScheduleEvent(system, event, UINT64_MAX);
+}
+
+static bool SystemPpuClocksIrqs(System *system)
+{
+    return system->cart->mapper_num == MAPPER_MMC3 || system->cart->mapper_num == MAPPER_MMC5;
+}
+
+// The mmc3 and mmc5 irqs are clocked by the ppu, so instead of syncing it on every irq poll it's
+// synced by the first cycle their counter could run out on
+static void SystemScheduleMapperIrq(System *system)
+{
+    if (!SystemPpuClocksIrqs(system))
+        return;
+
+    const int clocks = MapperIrqClocksLeft(system->cart);
+    if (!clocks)
+    {
+        SystemCancelEvent(system, SYSTEM_EVENT_MAPPER_IRQ);
+        return;
+    }
+
+    // A $2006 or $2007 change to v waiting on the next dots can clock the mmc3 on its own
+    const Ppu *ppu = system->ppu;
+    if (ppu->copy_t || ppu->delayed_vram_inc)
+    {
+        SystemScheduleEvent(system, SYSTEM_EVENT_MAPPER_IRQ, system->cycles);
+        return;
+    }
+
+    // Each run of pattern fetches from one table clocks the mmc3 once at most (the a12 rises
+    // inside it are too close together), that's the bg, the sprites and the next line's first
+    // tiles, with 8x16 sprites switching tables up to 4 times. The mmc5 needs 3 identical
+    // nametable reads in a row, the sprite fetches have them and so does the start of a line
+    int clocks_per_line = ppu->ctrl.sprite_size ? 6 : 3;
+    if (system->cart->mapper_num == MAPPER_MMC5)
+        clocks_per_line = 2;
+
+    const int lines = (clocks - 1) / clocks_per_line;
+    SystemScheduleEvent(system, SYSTEM_EVENT_MAPPER_IRQ, system->cycles + PpuDotsUntilFetchLine(ppu, lines) / 3);
+}
+
+// Work out how far the ppu can fall behind before it has to be synced
+static void SystemSchedulePpu(System *system)
+{
+    SystemScheduleMapperIrq(system);
+
+    // A falling nmi edge is waiting for the next poll, so run in step until it's seen
+    if (~SystemReadNmiPin(system) & system->cpu->nmi_pin)
+    {
+        SystemScheduleEvent(system, SYSTEM_EVENT_PPU, system->cycles);
+        return;
+    }
+
+    // The cpu cycle that holds the event dot has to be run on time
+    SystemScheduleEvent(system, SYSTEM_EVENT_PPU, system->cycles + PpuDotsUntilEvent(system->ppu) / 3);
+}
+
+// Run the ppu up to the current cpu cycle
+void SystemSyncPpu(System *system)
+{
+    PROFILE_BEGIN(&system->profile, ppu_start);
+    for (; system->ppu_cycles < system->cycles; system->ppu_cycles++)
+    {
+        PPU_Tick(system->ppu);
+        SystemPollNmi(system);
+        PPU_Tick(system->ppu);
+        PPU_Tick(system->ppu);
+    }
+    PROFILE_END(&system->profile, PROFILE_PPU, ppu_start);
+
+    SystemSchedulePpu(system);
+}
+
+// Run everything due on the current cycle, the ppu used to be ticked after the apu
+// but neither of them touch each other so the order doesn't matter
+static void SystemRunEvents(System *system)
+{
+    const uint64_t cycle = system->cycles - 1;
+
+    while (system->next_event <= cycle)
+    {
+        for (int i = 0; i < SYSTEM_EVENT_COUNT; i++)
+        {
+            if (system->events[i] > cycle)
+                continue;
+
+            system->events[i] = UINT64_MAX;
+            system->last_event_cycle = cycle;
+            SystemUpdateNextEvent(system);
+
+            switch (i)
+            {
+                case SYSTEM_EVENT_PPU:
+                case SYSTEM_EVENT_MAPPER_IRQ:
+                    SystemSyncPpu(system);
+                    break;
+                case SYSTEM_EVENT_FRAME_COUNTER:
+                    ApuClockFrameCounter(system->apu);
+                    break;
+                case SYSTEM_EVENT_DMC_DMA:
+                    ApuPollDmcDma(system->apu);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+static void SystemIoWrite(System *system, const uint16_t addr, const uint8_t data)
+{
+    if (addr == 0x4014)
+    {
+        DEBUG_LOG("Requested OAM DMA 0x%04X\n", addr);
+        system->oam_dma_triggered = true;
+        system->dma_pending = true;
+    }
+    else if (addr == 0x4016)
+    {
+        WriteJoyPadReg(system->joy_pad1, data);
+        WriteJoyPadReg(system->joy_pad2, data);
+    }
+    else
+    {
+        WriteAPURegister(system->apu, addr, data);
+    }
 }
 
 static uint8_t SystemMemMappedRead(System *system, MemOperation op, const uint16_t addr)
 {
     switch (op)
     {
+        case MEM_RAM_READ:
+            return SystemRamRead(system, addr);
+        case MEM_PPU_READ:
+        {
+            SystemSyncPpu(system);
+            const uint8_t data = ReadPPURegister(system->ppu, addr);
+            SystemSchedulePpu(system);
+            return data;
+        }
         case MEM_PRG_READ:
             return MapperReadPrgRom(system->cart, addr);
+        case MEM_PRG_DIRECT_READ:
+            return CartReadPrgRom(system->cart, addr);
         case MEM_REG_READ:
+            // Mapper regs can expose ppu state (mmc5 scanline irq)
+            SystemSyncPpu(system);
             return MapperReadReg(system->cart, addr);
         case MEM_SWRAM_READ:
             return CartReadPrgRam(system->cart, addr);
@@ -186,36 +406,100 @@ static void SystemMemMappedWrite(System *system, MemOperation op, const uint16_t
 {
     switch (op)
     {
+        case MEM_RAM_WRITE:
+            SystemRamWrite(system, addr, data);
+            break;
+        case MEM_PPU_WRITE:
+            SystemSyncPpu(system);
+            WritePPURegister(system->ppu, addr, data);
+            SystemSchedulePpu(system);
+            break;
+        case MEM_IO_WRITE:
+            SystemIoWrite(system, addr, data);
+            break;
         case MEM_REG_WRITE:
+            // Banking, mirroring and irq changes have to land on the right ppu dot
+            SystemSyncPpu(system);
             MapperWriteReg(system->cart, addr, data);
+            SystemUpdatePrgPages(system);
+            SystemScheduleMapperIrq(system);
             break;
         case MEM_SWRAM_WRITE:
             CartWritePrgRam(system->cart, addr, data);
             break;
         case MEM_PRG_WRITE:
+            SystemSyncPpu(system);
             MapperWritePrgRam(system->cart, addr, data);
+            SystemUpdatePrgPages(system);
             break;
         default:
             break;
     }
 }
 
-void SystemAddMemMapRead(const uint16_t start_addr, const uint16_t end_addr, MemOperation op)
+// Returns the memory backing a page if the mapping doesn't need a handler to access it
+static uint8_t *SystemGetDirectPage(System *system, MemOperation op, const uint32_t page_addr)
+{
+    Cart *cart = system->cart;
+
+    switch (op)
+    {
+        case MEM_RAM_READ:
+        case MEM_RAM_WRITE:
+            return &system->sys_ram[page_addr & (CPU_RAM_SIZE - 1)];
+        case MEM_SWRAM_READ:
+        case MEM_SWRAM_WRITE:
+            return &cart->prg_ram.data[page_addr & cart->prg_ram.mask];
+        case MEM_PRG_DIRECT_READ:
+            return &cart->prg_rom.data[page_addr & cart->prg_rom.mask];
+        case MEM_PRG_READ:
+            return MapperGetPrgRomPage(cart, page_addr);
+        default:
+            return NULL;
+    }
+}
+
+static void SystemMapPages(System *system, MemPage *pages, const MemMap *mem_maps, const int index)
+{
+    const MemMap *mem_map = &mem_maps[index];
+    const uint32_t first_page = mem_map->start_addr >> MEM_PAGE_SHIFT;
+    const uint32_t last_page = mem_map->end_addr >> MEM_PAGE_SHIFT;
+
+    for (uint32_t i = first_page; i <= last_page; i++)
+    {
+        MemPage *page = &pages[i];
+        assert(page->num_maps < MEM_PAGE_MAPS_MAX);
+        page->maps[page->num_maps++] = index;
+
+        const uint32_t page_start = i << MEM_PAGE_SHIFT;
+        const uint32_t page_end = page_start | 0xFF;
+        const bool whole_page = mem_map->start_addr <= page_start && mem_map->end_addr >= page_end;
+
+        // Only a page owned entirely by a single mapping can skip the handlers
+        page->data = page->num_maps == 1 && whole_page ? SystemGetDirectPage(system, mem_map->op, page_start) : NULL;
+    }
+}
+
+void SystemAddMemMapRead(System *system, const uint16_t start_addr, const uint16_t end_addr, MemOperation op)
 {
-    System *system = system_ptr;
-    MemMap *mem_map = &system->mem_map_r[system->mem_maps_r++];
+    assert(system->mem_maps_r < MEM_MAPS_MAX);
+    MemMap *mem_map = &system->mem_map_r[system->mem_maps_r];
     mem_map->start_addr = start_addr;
     mem_map->end_addr = end_addr;
     mem_map->op = op;
+
+    SystemMapPages(system, system->read_pages, system->mem_map_r, system->mem_maps_r++);
 }
 
-void SystemAddMemMapWrite(const uint16_t start_addr, const uint16_t end_addr, MemOperation op)
+void SystemAddMemMapWrite(System *system, const uint16_t start_addr, const uint16_t end_addr, MemOperation op)
 {
-    System *system = system_ptr;
-    MemMap *mem_map = &system->mem_map_w[system->mem_maps_w++];
+    assert(system->mem_maps_w < MEM_MAPS_MAX);
+    MemMap *mem_map = &system->mem_map_w[system->mem_maps_w];
     mem_map->start_addr = start_addr;
     mem_map->end_addr = end_addr;
     mem_map->op = op;
+
+    SystemMapPages(system, system->write_pages, system->mem_map_w, system->mem_maps_w++);
 }
 
 static void SystemHandleDMA(System *system)
@@ -235,20 +519,44 @@ static void SystemHandleDMA(System *system)
     system->dma_pending = false;
 }
 
-uint8_t SystemRead(const uint16_t addr)
+uint8_t SystemRead(System *system, const uint16_t addr)
 {
-    system_ptr->cpu_addr = addr;
-    SystemHandleDMA(system_ptr);
-    SystemTick();
-    return BusRead(addr);
+    system->cpu_addr = addr;
+    SystemHandleDMA(system);
+    SystemTick(system);
+    return BusRead(system, addr);
+}
+
+// Reads memory without ticking anything, only for addresses where reading has no side effects.
+// Banked prg rom is read through the mapper, which doesn't change anything a later access can see
+bool SystemPeek(System *system, const uint16_t addr, uint8_t *data)
+{
+    const MemPage *page = &system->read_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (page->data)
+    {
+        *data = page->data[addr & 0xFF];
+        return true;
+    }
+
+    if (page->num_maps == 1 && system->mem_map_r[page->maps[0]].op == MEM_PRG_READ)
+    {
+        *data = MapperReadPrgRom(system->cart, addr);
+        return true;
+    }
+
+    return false;
 }
 
-uint8_t BusRead(const uint16_t addr)
+// True if addr is plain memory, which only the cpu (or nothing) can change
+bool SystemReadIsPure(System *system, const uint16_t addr)
+{
+    return system->read_pages[addr >> MEM_PAGE_SHIFT].data != NULL;
+}
+
+uint8_t BusRead(System *system, const uint16_t addr)
 {
-    System *system = system_ptr;
     ++system->cpu->cycles;
-    // Extract A15, A14, and A13
-    uint8_t region = (addr >> 13) & 0x7;
 
     if (ApuRegsActivated(system))
     {
@@ -277,29 +585,23 @@ uint8_t BusRead(const uint16_t addr)
         }
     }
 
-    switch (region)
-    {
-        // $0000 - $1FFF
-        case 0x0:
-            system->bus_data = SystemRamRead(system, addr);
-            break;
+    const MemPage *page = &system->read_pages[addr >> MEM_PAGE_SHIFT];
 
-        // $2000 - $3FFF
-        case 0x1:
-            system->bus_data = ReadPPURegister(system->ppu, addr);
-            break;
-        default:
+    if (page->data)
+    {
+        system->bus_data = page->data[addr & 0xFF];
+    }
+    else
+    {
+        // Unmapped addresses leave the last value on the bus (open bus)
+        for (int i = 0; i < page->num_maps; i++)
         {
-            for (int i = 0; i < system->mem_maps_r; i++)
+            const MemMap *mem_map = &system->mem_map_r[page->maps[i]];
+
+            if (addr >= mem_map->start_addr && addr <= mem_map->end_addr)
             {
-                MemMap *mem_map = &system->mem_map_r[i];
-            
-                if (addr >= mem_map->start_addr && addr <= mem_map->end_addr)
-                {
-                    system->bus_data = SystemMemMappedRead(system, mem_map->op, addr);
-                }
+                system->bus_data = SystemMemMappedRead(system, mem_map->op, addr);
             }
-            break;
         }
     }
 
@@ -307,147 +609,100 @@ uint8_t BusRead(const uint16_t addr)
     return system->bus_data;
 }
 
-void SystemWrite(const uint16_t addr, const uint8_t data)
+void SystemWrite(System *system, const uint16_t addr, const uint8_t data)
 {
-    system_ptr->cpu_addr = addr;
-    SystemTick();
-    BusWrite(addr, data);
+    system->cpu_addr = addr;
+    SystemTick(system);
+    BusWrite(system, addr, data);
 }
 
-void BusWrite(const uint16_t addr, const uint8_t data)
+void BusWrite(System *system, const uint16_t addr, const uint8_t data)
 {
-    System *system = system_ptr;
     ++system->cpu->cycles;
-    // Extract A15, A14, and A13
-    uint8_t region = (addr >> 13) & 0x7;
-
-    switch (region)
-    {
-        // $0000 - $1FFF
-        case 0x0:
-            // Internal RAM (mirrored)
-            SystemRamWrite(system, addr, data);
-            break;
 
-        // $2000 - $3FFF
-        case 0x1:
-            WritePPURegister(system->ppu, addr, data);
-            break;
+    const MemPage *page = &system->write_pages[addr >> MEM_PAGE_SHIFT];
 
-        // $4000 - $5FFF
-        case 0x2:
-        {
-            if (addr == 0x4014)
-            {
-                DEBUG_LOG("Requested OAM DMA 0x%04X\n", addr);
-                system->oam_dma_triggered = true;
-                system->dma_pending = true;
-            }
-            else if (addr == 0x4016)
-            {
-                WriteJoyPadReg(system->joy_pad1, data);
-                WriteJoyPadReg(system->joy_pad2, data);
-            }
-            else if (addr < 0x4018)
-            {
-                WriteAPURegister(system->apu, addr, data);
-            }
-            break;
-        }
+    if (page->data)
+    {
+        page->data[addr & 0xFF] = data;
     }
-
-    for (int i = 0; i < system->mem_maps_w; i++)
+    else
     {
-        MemMap *mem_map = &system->mem_map_w[i];
-
-        if (addr >= mem_map->start_addr && addr <= mem_map->end_addr)
+        // Every overlapping mapping sees the write, e.g. MMC5 snooping the PPU regs
+        for (int i = 0; i < page->num_maps; i++)
         {
-            SystemMemMappedWrite(system, mem_map->op, addr, data);
+            const MemMap *mem_map = &system->mem_map_w[page->maps[i]];
+
+            if (addr >= mem_map->start_addr && addr <= mem_map->end_addr)
+            {
+                SystemMemMappedWrite(system, mem_map->op, addr, data);
+            }
         }
     }
 
     system->bus_data = data;
 }
 
-Cart *SystemGetCart(void)
+uint8_t SystemGetPpuA9(System *system)
 {
-    return system_ptr->cart;
-}
-
-Apu *SystemGetApu(void)
-{
-    return system_ptr->apu;
-}
-
-Ppu *SystemGetPpu(void)
-{
-    return system_ptr->ppu;
-}
-
-Cpu *SystemGetCpu(void)
-{
-    return system_ptr->cpu;
-}
-
-uint8_t SystemGetPpuA9(void)
-{
-    return system_ptr->ppu->v.raw_bits.bit9;
+    return system->ppu->v.raw_bits.bit9;
 }
 
 // TODO: The Ppu struct should have a ptr to the chr rom / chr ram
 // The PPU only exposes the io regs on the main bus, it has its own bus
-uint8_t PpuBusReadChrRom(const uint16_t addr)
+uint8_t PpuBusReadChrRom(System *system, const uint16_t addr)
 {
-    return MapperReadChrRom(system_ptr->cart, addr);
+    return MapperReadChrRom(system->cart, addr);
 }
 
-void PpuBusWriteChrRam(const uint16_t addr, const uint8_t data)
+void PpuBusWriteChrRam(System *system, const uint16_t addr, const uint8_t data)
 {
-    Cart *cart = system_ptr->cart;
+    Cart *cart = system->cart;
     if (!cart->chr_rom.ram)
         return;
 
     MapperWriteChrRam(cart, addr, data);
 }
 
-void MapperClockAudioTimers(void)
+void MapperClockAudioTimers(System *system)
 {
-    if (system_ptr->cart->mapper_num == MAPPER_MMC5)
+    if (system->cart->mapper_num == MAPPER_MMC5)
     {
-        Mmc5ClockAudioTimers();
+        Mmc5ClockAudioTimers(system->cart);
     }
 }
 
-void MapperClockAudio(void)
+void MapperClockAudio(System *system)
 {
-    if (system_ptr->cart->mapper_num == MAPPER_MMC5)
+    if (system->cart->mapper_num == MAPPER_MMC5)
     {
-        Mmc5ClockAudio();
+        Mmc5ClockAudio(system->cart);
     }
 }
 
-float MapperGetMixedAudio(void)
+float MapperGetMixedAudio(System *system)
 {
-    if (system_ptr->cart->mapper_num != MAPPER_MMC5)
+    if (system->cart->mapper_num != MAPPER_MMC5)
         return 0;
 
-    return Mmc5GetMixedAudio();
+    return Mmc5GetMixedAudio(system->cart);
 }
 
-void PpuClockMMC3(void)
+void PpuClockMMC3(System *system)
 {
-    if (system_ptr->cart->mapper_num != MAPPER_MMC3)
+    if (system->cart->mapper_num != MAPPER_MMC3)
         return;
 
-    Mmc3ClockIrqCounter(system_ptr->cart);
+    Mmc3ClockIrqCounter(system->cart);
 }
 
 uint8_t ExtNameTableRead(Ppu *ppu, const uint16_t addr)
 {
-    if (system_ptr->cart->mapper_num != MAPPER_MMC5)
+    Cart *cart = ppu->system->cart;
+    if (cart->mapper_num != MAPPER_MMC5)
         return PpuNametableRead(ppu, addr);
 
-    return Mmc5ReadNameTable(ppu, addr);
+    return Mmc5ReadNameTable(cart, ppu, addr);
 }
 
 void SystemUpdateState(System *system, SystemState state)
@@ -467,9 +722,21 @@ void SystemRun(System *system, bool debug_info)
 
     system->ppu->frame_finished = false;
 
-    do {
-        CPU_ExecuteInstr(system->cpu, debug_info);
-    } while (!system->ppu->frame_finished && system->state != STEP_INSTR);
+    PROFILE_BEGIN(&system->profile, cpu_start);
+    if (debug_info || system->state == STEP_INSTR)
+    {
+        // The single instruction path keeps the debug message up to date
+        do {
+            CPU_ExecuteInstr(system->cpu, debug_info);
+        } while (!system->ppu->frame_finished && system->state != STEP_INSTR);
+    }
+    else
+    {
+        CPU_Run(system->cpu);
+    }
+
+    SystemSyncPpu(system);
+    PROFILE_END(&system->profile, PROFILE_CPU, cpu_start);
 
     if ((system->state == STEP_FRAME && system->ppu->frame_finished) || system->state == STEP_INSTR)
     {
@@ -477,42 +744,46 @@ void SystemRun(System *system, bool debug_info)
     }
 }
 
-bool SystemPollAllIrqs(void)
+// The ppu is always caught up far enough for the mmc3 and mmc5 irqs by their event
+bool SystemPollAllIrqs(System *system)
 {
-    return PollApuIrqs(system_ptr->apu) || PollMapperIrq();
+    return PollApuIrqs(system->apu) || PollMapperIrq(system->cart);
 }
 
-// The PPU pulls /NMI low if and only if both vblank_flag and NMI_output are true.
-static uint8_t SystemReadNmiPin(System *system)
+// How many cycles a cpu stuck in an idle loop can skip before anything it reads or an interrupt
+// could change, which is the next event. Returns 0 if something can happen before that anyway,
+// a dma or a dmc that might ask for one on any apu tick (including a looping sample about to restart)
+uint64_t SystemIdleCycles(System *system)
 {
-    return ~(system->ppu->ctrl.vblank_nmi & system->ppu->status.vblank);
+    if (system->dma_pending || system->apu->dmc.bytes_remaining || system->apu->dmc.restart)
+        return 0;
+
+    return system->next_event > system->cycles ? system->next_event - system->cycles : 0;
 }
 
-static void SystemPollNmi(System *system)
+// Cycles the cpu spends idle, the ppu catches up on its own later so only the apu needs ticking
+void SystemRunIdleCycles(System *system, const uint64_t cycles)
 {
-    uint8_t current_nmi_pin = SystemReadNmiPin(system);
-    if (~current_nmi_pin & system->cpu->nmi_pin)
+    for (uint64_t i = 0; i < cycles; i++)
     {
-        system->cpu->nmi_pending = true;
-        //printf("NMI falling edge at frame: %ld ppu cycle: %d scanline:%d\n",
-        //        system_ptr->ppu->frames, system_ptr->ppu->cycle_counter, system_ptr->ppu->scanline);
+        SystemTick(system);
+        ++system->cpu->cycles;
     }
-    system->cpu->nmi_pin = current_nmi_pin;
 }
 
-void SystemTick(void)
+void SystemTick(System *system)
 {
-    APU_Tick(system_ptr->apu, system_ptr->cpu->cycles & 1);
+    if (system->cycles++ >= system->next_event)
+        SystemRunEvents(system);
 
-    PPU_Tick(system_ptr->ppu);
-    SystemPollNmi(system_ptr);
-    PPU_Tick(system_ptr->ppu);
-    PPU_Tick(system_ptr->ppu);
+    PROFILE_BEGIN(&system->profile, apu_start);
+    APU_Tick(system->apu, system->cpu->cycles & 1);
+    PROFILE_END(&system->profile, PROFILE_APU, apu_start);
 }
 
-void SystemAddCpuCycles(uint32_t cycles)
+void SystemAddCpuCycles(System *system, uint32_t cycles)
 {
-    system_ptr->cpu->cycles += cycles;
+    system->cpu->cycles += cycles;
 }
 
 void SystemUpdateJPButtons(System *system, const bool *buttons)
@@ -538,14 +809,295 @@ void SystemUpdateJPButtons(System *system, const bool *buttons)
 
 void SystemReset(System *system)
 {
+    SystemSyncPpu(system);
     MapperReset(system->cart);
+    SystemUpdatePrgPages(system);
     APU_Reset(system->apu);
     PPU_Reset(system->ppu);
+    SystemSchedulePpu(system);
     CPU_Reset(system->cpu);
+    SystemSyncPpu(system);
+}
+
+// Everything in a save state that's copied as is, a state only loads into a build with the same
+// layout and the same cart. Bump the version when the contents change without the sizes changing
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    int32_t mapper_num;
+    uint32_t cpu_size;
+    uint32_t ppu_size;
+    uint32_t apu_size;
+    uint32_t mapper_size;
+    uint32_t audio_size;
+    uint32_t prg_ram_size;
+    uint32_t chr_ram_size;
+} SystemStateHeader;
+
+typedef struct
+{
+    // Exactly one of these is set when saving or loading, neither when only counting the size
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t pos;
+} SystemStateStream;
+
+static void SystemStateCopy(SystemStateStream *stream, void *data, const size_t size)
+{
+    if (stream->src)
+        memcpy(data, stream->src + stream->pos, size);
+    else if (stream->dst)
+        memcpy(stream->dst + stream->pos, data, size);
+
+    stream->pos += size;
+}
+
+// Only the first used bytes of data mean anything, the rest is saved as zeros so stale
+// contents don't differ from one state to the next
+static void SystemStateCopyUsed(SystemStateStream *stream, void *data, const size_t used, const size_t size)
+{
+    SystemStateCopy(stream, data, used);
+
+    if (stream->dst)
+        memset(stream->dst + stream->pos, 0, size - used);
+
+    stream->pos += size - used;
+}
+
+// The ppu is synced a little past the start of the next frame when SystemRun returns, the
+// pixels it already drew are kept so the first frame after a load comes out the same
+#define SYSTEM_STATE_DRAWN_LINES 8
+
+// Saving and loading walk the same list so they can't get out of step. The structs are copied
+// whole, with the pointers into this instance put back afterwards
+static void SystemStateTransfer(System *system, SystemStateStream *stream)
+{
+    Cpu *cpu = system->cpu;
+    Ppu *ppu = system->ppu;
+    Apu *apu = system->apu;
+    Cart *cart = system->cart;
+
+    struct Jit *jit = cpu->jit;
+    uint16_t *buffers[2] = { ppu->buffers[0], ppu->buffers[1] };
+    const uint64_t frames_output = ppu->frames_output;
+    uint32_t *palette_lut = ppu->palette_lut;
+    const bool skip_output = ppu->skip_next_output;
+    ApuSampleFn SampleFn = apu->mixer.SampleFn;
+    void *userdata = apu->mixer.userdata;
+    float *input_buffer = apu->mixer.input_buffer;
+    const ApuMix mix = apu->mixer.mix;
+
+    // Nametables are kept as offsets into vram, or 0xFFFF for the mmc5's exram
+    uint16_t nametables[4];
+    for (int i = 0; i < 4; i++)
+    {
+        const bool ext_ram = ppu->nametables[i] == cart->mapper->mmc5.ext_ram;
+        nametables[i] = ext_ram ? 0xFFFF : (uint16_t)(ppu->nametables[i] - ppu->vram);
+    }
+
+    SystemStateCopy(stream, &system->cycles, sizeof(system->cycles));
+    SystemStateCopy(stream, system->events, sizeof(system->events));
+    SystemStateCopy(stream, &system->next_event, sizeof(system->next_event));
+    SystemStateCopy(stream, &system->last_event_cycle, sizeof(system->last_event_cycle));
+    SystemStateCopy(stream, &system->ppu_cycles, sizeof(system->ppu_cycles));
+    SystemStateCopy(stream, &system->oam_dma_bytes_remaining, sizeof(system->oam_dma_bytes_remaining));
+    SystemStateCopy(stream, &system->cpu_addr, sizeof(system->cpu_addr));
+    SystemStateCopy(stream, &system->oam_dma_triggered, sizeof(system->oam_dma_triggered));
+    SystemStateCopy(stream, &system->dmc_dma_triggered, sizeof(system->dmc_dma_triggered));
+    SystemStateCopy(stream, &system->dma_pending, sizeof(system->dma_pending));
+    SystemStateCopy(stream, &system->bus_data, sizeof(system->bus_data));
+    SystemStateCopy(stream, system->sys_ram, CPU_RAM_SIZE);
+
+    SystemStateCopy(stream, cpu, sizeof(*cpu));
+    // The buffers swap every frame, leaving them and the output count out keeps states of
+    // the same point identical. Loading doesn't touch the front buffer so both stay this instance's
+    ppu->buffers[0] = ppu->buffers[1] = NULL;
+    ppu->frames_output = 0;
+    SystemStateCopy(stream, ppu, sizeof(*ppu));
+    ppu->buffers[0] = buffers[0];
+    ppu->buffers[1] = buffers[1];
+    ppu->frames_output = frames_output;
+    SystemStateCopy(stream, nametables, sizeof(nametables));
+    SystemStateCopy(stream, apu, sizeof(*apu));
+    // The mixed samples not handed to the callback yet, input_index is already loaded by now
+    SystemStateCopyUsed(stream, input_buffer, apu->mixer.input_index * sizeof(float), apu->mixer.input_size);
+
+    const size_t drawn_size = SCREEN_WIDTH * SYSTEM_STATE_DRAWN_LINES * sizeof(uint16_t);
+    const size_t drawn = (size_t)ppu->scanline * SCREEN_WIDTH + MIN(ppu->cycle_counter, SCREEN_WIDTH);
+    SystemStateCopyUsed(stream, buffers[0], MIN(drawn * sizeof(uint16_t), drawn_size), drawn_size);
+    SystemStateCopy(stream, system->joy_pad1, sizeof(*system->joy_pad1));
+    SystemStateCopy(stream, system->joy_pad2, sizeof(*system->joy_pad2));
+
+    SystemStateCopy(stream, cart->mapper, sizeof(*cart->mapper));
+    SystemStateCopy(stream, cart->prg_ram.data, cart->prg_ram.size);
+    if (cart->chr_rom.ram)
+        SystemStateCopy(stream, cart->chr_rom.data, cart->chr_rom.size);
+
+    if (stream->src)
+    {
+        cpu->system = system;
+        cpu->jit = jit;
+        ppu->system = system;
+        // The saving instance could have had another palette loaded
+        ppu->palette_lut = palette_lut;
+        // Whether frames are drawn is up to this instance, not the one that saved the state
+        ppu->skip_output = skip_output;
+        ppu->skip_next_output = skip_output;
+        apu->system = system;
+        apu->mixer.SampleFn = SampleFn;
+        apu->mixer.userdata = userdata;
+        apu->mixer.input_buffer = input_buffer;
+        // Like the palette, the mixer is this instance's setting
+        apu->mixer.mix = mix;
+
+        for (int i = 0; i < 4; i++)
+        {
+            ppu->nametables[i] = nametables[i] == 0xFFFF ? cart->mapper->mmc5.ext_ram : &ppu->vram[nametables[i]];
+        }
+
+        SystemUpdatePrgPages(system);
+    }
+}
+
+static SystemStateHeader SystemStateMakeHeader(System *system)
+{
+    SystemStateStream counter = { 0 };
+    SystemStateTransfer(system, &counter);
+
+    const Cart *cart = system->cart;
+    const SystemStateHeader header =
+    {
+        .magic = SYSTEM_STATE_MAGIC,
+        .version = SYSTEM_STATE_VERSION,
+        .size = sizeof(SystemStateHeader) + counter.pos,
+        .mapper_num = cart->mapper_num,
+        .cpu_size = sizeof(Cpu),
+        .ppu_size = sizeof(Ppu),
+        .apu_size = sizeof(Apu),
+        .mapper_size = sizeof(Mapper),
+        .audio_size = system->apu->mixer.input_size,
+        .prg_ram_size = cart->prg_ram.size,
+        .chr_ram_size = cart->chr_rom.ram ? cart->chr_rom.size : 0,
+    };
+
+    return header;
+}
+
+// Size of the blob SystemSaveState writes, it doesn't change once the cart is loaded
+size_t SystemStateSize(System *system)
+{
+    return SystemStateMakeHeader(system).size;
+}
+
+// Snapshots the whole console into buffer, returns the bytes written or 0 if buffer is too small.
+// Only valid between calls to SystemRun
+size_t SystemSaveState(System *system, void *buffer, const size_t size)
+{
+    const SystemStateHeader header = SystemStateMakeHeader(system);
+    if (size < header.size)
+        return 0;
+
+    memcpy(buffer, &header, sizeof(header));
+
+    SystemStateStream stream = { .dst = (uint8_t *)buffer + sizeof(header) };
+    SystemStateTransfer(system, &stream);
+    return header.size;
+}
+
+// Restores a state from SystemSaveState, returns -1 if it came from another build or cart
+int SystemLoadState(System *system, const void *buffer, const size_t size)
+{
+    const SystemStateHeader header = SystemStateMakeHeader(system);
+    if (size < header.size || memcmp(buffer, &header, sizeof(header)))
+        return -1;
+
+    SystemStateStream stream = { .src = (const uint8_t *)buffer + sizeof(header) };
+    SystemStateTransfer(system, &stream);
+    return 0;
+}
+
+// Runs the frames after the current one with the input it has now and returns the last of
+// them to present, which takes the game's own reaction time off the input latency.
+// With an ahead instance (a second System on the same cart) the state is copied over and
+// the frames are run there, otherwise they're run on system with the audio muted and the
+// state is put back afterwards. state must hold SystemStateSize bytes
+const uint16_t *SystemRunAhead(System *system, System *ahead, void *state, const size_t state_size, const int frames)
+{
+    if (frames <= 0 || system->state != RUNNING || !SystemSaveState(system, state, state_size))
+        return system->ppu->buffers[1];
+
+    System *target = ahead ? ahead : system;
+    const ApuSampleFn SampleFn = target->apu->mixer.SampleFn;
+    const bool skip_next_output = target->ppu->skip_next_output;
+
+    if (ahead)
+    {
+        // The ahead instance draws the frame it starts on only if system would have
+        ahead->ppu->skip_next_output = system->ppu->skip_output;
+        if (SystemLoadState(ahead, state, state_size))
+        {
+            ahead->ppu->skip_next_output = skip_next_output;
+            return system->ppu->buffers[1];
+        }
+    }
+
+    // Only the last frame is drawn
+    target->apu->mixer.SampleFn = NULL;
+    for (int i = 1; i <= frames; i++)
+    {
+        SystemSetFrameOutput(target, i + 1 == frames);
+        SystemRun(target, false);
+    }
+    target->apu->mixer.SampleFn = SampleFn;
+    target->ppu->skip_next_output = skip_next_output;
+
+    // Loading leaves the front buffer alone, it still has the last frame run ahead
+    if (!ahead)
+        SystemLoadState(system, state, state_size);
+
+    return target->ppu->buffers[1];
+}
+
+// Replaces the built in palette with a .pal file, returns -1 if it couldn't be loaded
+int SystemLoadPalette(System *system, const char *path)
+{
+    return PPU_LoadPalette(system->ppu, path);
+}
+
+// Frames are kept as colour indices, this turns one (the front buffer or the frame
+// SystemRunAhead returned) into pixels in the given format with system's palette
+void SystemConvertFrame(System *system, const uint16_t *frame, void *pixels, const int pitch, const PpuPixelFormat format)
+{
+    PPU_ConvertFrame(system->ppu, frame, pixels, pitch, format);
+}
+
+// Frames are drawn by default, the ppu has always started the next frame by the time SystemRun
+// returns so turning drawing on or off applies to the frame after the one the next SystemRun runs
+void SystemSetFrameOutput(System *system, const bool output)
+{
+    system->ppu->skip_next_output = !output;
+}
+
+// The jit is off until this turns it on, returns false if it isn't supported here
+bool SystemSetCpuJit(System *system, const bool enable)
+{
+    Cpu *cpu = system->cpu;
+
+    if (enable && cpu->jit == NULL)
+        cpu->jit = JIT_Create();
+    else if (!enable)
+    {
+        JIT_Destroy(cpu->jit);
+        cpu->jit = NULL;
+    }
+
+    return cpu->jit != NULL || !enable;
 }
 
 void SystemShutdown(System *system)
 {
-    APU_Shutdown(system->apu);
+    SystemSetCpuJit(system, false);
     CartSaveSram(system->cart);
 }
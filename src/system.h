@@ -12,6 +12,7 @@
 #include "joypad.h"
 #include "cart.h"
 #include "mapper.h"
+#include "profile.h"
 
 typedef enum
 {
@@ -21,10 +22,43 @@ typedef enum
     STEP_FRAME
 } SystemState;
 
+// Things that happen at a known cycle, checked once per cycle against the earliest one
+// instead of every part of the system polling for them
+typedef enum
+{
+    // Catch the ppu up for vblank (nmi) or the end of a frame
+    SYSTEM_EVENT_PPU,
+    // Apu frame sequencer step
+    SYSTEM_EVENT_FRAME_COUNTER,
+    // Dmc sample buffer ran empty and needs a dma fetch
+    SYSTEM_EVENT_DMC_DMA,
+    // Catch the ppu up for the earliest cycle the mmc3 or mmc5 irq could fire on
+    SYSTEM_EVENT_MAPPER_IRQ,
+    SYSTEM_EVENT_COUNT
+} SystemEvent;
+
+#define MEM_MAPS_MAX 8
+#define MEM_PAGE_MAPS_MAX 4
+#define MEM_PAGE_COUNT 0x100
+#define MEM_PAGE_SHIFT 8
+
+// One 256 byte page of the cpu address space.
+// Pages that are backed by a single plain block of memory (ram, unbanked rom)
+// are accessed through the data pointer, everything else goes through the mem maps
+// that overlap the page, in the order they were added.
+typedef struct
+{
+    uint8_t *data;
+    uint8_t maps[MEM_PAGE_MAPS_MAX];
+    uint8_t num_maps;
+} MemPage;
+
 typedef struct System
 {
-    MemMap mem_map_r[5];
-    MemMap mem_map_w[5];
+    MemPage read_pages[MEM_PAGE_COUNT];
+    MemPage write_pages[MEM_PAGE_COUNT];
+    MemMap mem_map_r[MEM_MAPS_MAX];
+    MemMap mem_map_w[MEM_MAPS_MAX];
     Cpu *cpu;
     Apu *apu;
     Ppu *ppu;
@@ -38,6 +72,17 @@ typedef struct System
     int mem_maps_w;
     int oam_dma_bytes_remaining;
 
+    // Master clock, counts every cpu cycle ticked and is never reset
+    uint64_t cycles;
+    // Cycle each event is due on, UINT64_MAX when it isn't scheduled
+    uint64_t events[SYSTEM_EVENT_COUNT];
+    uint64_t next_event;
+    // Cycle the last event was run on
+    uint64_t last_event_cycle;
+    // The ppu runs behind the cpu and only catches up when something can see it,
+    // this is the cycle it has been run up to
+    uint64_t ppu_cycles;
+
     uint16_t cpu_addr;
     //uint16_t oam_addr;
     //uint16_t dmc_addr;
@@ -46,48 +91,71 @@ typedef struct System
     bool oam_dma_triggered;
     bool dmc_dma_triggered;
     bool dma_pending;
+    // Fast forward the cpu through loops that only poll memory, on by default
+    bool skip_idle_loops;
 
     uint8_t bus_data;
+
+    Profile profile;
 } System;
 
 #define CPU_RAM_SIZE 0x800
 
+// "NONS"
+#define SYSTEM_STATE_MAGIC 0x534E4F4E
+#define SYSTEM_STATE_VERSION 4
+
+// Most games react to input within a few frames, running further ahead only skips frames
+#define SYSTEM_MAX_RUN_AHEAD 4
+
 System *SystemCreate(Arena *arena);
 void SystemInit(System *system, Arena *arena, bool ppu_warmup, bool swap_duty_cycles,
-                int sample_rate, uint32_t **buffers, const uint32_t buffer_size);
+                int sample_rate, const ApuSynth synth, uint16_t **buffers, const uint32_t buffer_size);
+void SystemSetAudioCallback(System *system, ApuSampleFn SampleFn, void *userdata);
+void SystemSetAudioMix(System *system, const ApuMix mix);
 void SystemRun(System *system, bool debug_info);
 void SystemUpdateState(System *system, SystemState state);
-void SystemAddMemMap(const uint16_t start_addr, const uint16_t end_addr, MemOperation op, MemPermissions perms);
-void SystemAddMemMapRead(const uint16_t start_addr, const uint16_t end_addr, MemOperation op);
-void SystemAddMemMapWrite(const uint16_t start_addr, const uint16_t end_addr, MemOperation op);
-void SystemTick(void);
-bool SystemPollAllIrqs(void);
+void SystemAddMemMap(System *system, const uint16_t start_addr, const uint16_t end_addr, MemOperation op, MemPermissions perms);
+void SystemAddMemMapRead(System *system, const uint16_t start_addr, const uint16_t end_addr, MemOperation op);
+void SystemAddMemMapWrite(System *system, const uint16_t start_addr, const uint16_t end_addr, MemOperation op);
+void SystemTick(System *system);
+void SystemSyncPpu(System *system);
+void SystemScheduleEvent(System *system, SystemEvent event, const uint64_t cycle);
+void SystemCancelEvent(System *system, SystemEvent event);
+bool SystemPollAllIrqs(System *system);
+uint64_t SystemIdleCycles(System *system);
+void SystemRunIdleCycles(System *system, const uint64_t cycles);
 void SystemReset(System *system);
+size_t SystemStateSize(System *system);
+size_t SystemSaveState(System *system, void *buffer, const size_t size);
+int SystemLoadState(System *system, const void *buffer, const size_t size);
+const uint16_t *SystemRunAhead(System *system, System *ahead, void *state, const size_t state_size, const int frames);
+int SystemLoadPalette(System *system, const char *path);
+void SystemConvertFrame(System *system, const uint16_t *frame, void *pixels, const int pitch, const PpuPixelFormat format);
+void SystemSetFrameOutput(System *system, const bool output);
+bool SystemSetCpuJit(System *system, const bool enable);
 void SystemShutdown(System *system);
 
-uint8_t SystemReadOpenBus(void);
-uint8_t SystemGetPpuA9(void);
-void SystemSignalDmcDma(void);
-uint8_t SystemRead(const uint16_t addr);
-uint8_t BusRead(const uint16_t addr);
-void SystemWrite(const uint16_t addr, const uint8_t data);
-void BusWrite(const uint16_t addr, const uint8_t data);
+uint8_t SystemReadOpenBus(System *system);
+uint8_t SystemGetPpuA9(System *system);
+void SystemSignalDmcDma(System *system);
+uint8_t SystemRead(System *system, const uint16_t addr);
+bool SystemPeek(System *system, const uint16_t addr, uint8_t *data);
+bool SystemReadIsPure(System *system, const uint16_t addr);
+uint8_t BusRead(System *system, const uint16_t addr);
+void SystemWrite(System *system, const uint16_t addr, const uint8_t data);
+void BusWrite(System *system, const uint16_t addr, const uint8_t data);
 int SystemLoadCart(Arena *arena, System *System, const char *path);
 
-uint8_t PpuBusReadChrRom(const uint16_t addr);
-void PpuBusWriteChrRam(const uint16_t addr, const uint8_t data);
-void PpuClockMMC3(void);
-void MapperClockAudio(void);
-void MapperClockAudioTimers(void);
-float MapperGetMixedAudio(void);
+uint8_t PpuBusReadChrRom(System *system, const uint16_t addr);
+void PpuBusWriteChrRam(System *system, const uint16_t addr, const uint8_t data);
+void PpuClockMMC3(System *system);
+void MapperClockAudio(System *system);
+void MapperClockAudioTimers(System *system);
+float MapperGetMixedAudio(System *system);
 uint8_t ExtNameTableRead(Ppu *ppu, const uint16_t addr);
 
-void SystemAddCpuCycles(uint32_t cycles);
+void SystemAddCpuCycles(System *system, uint32_t cycles);
 void SystemUpdateJPButtons(System *system, const bool *buttons);
 
-Cart *SystemGetCart(void);
-Apu *SystemGetApu(void);
-Ppu *SystemGetPpu(void);
-Cpu *SystemGetCpu(void);
-
 #endif